@@ -0,0 +1,268 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Loopback server for the OpenOCD jtag_vpi driver.
+ *
+ * It speaks protocol version 1 (fixed size struct vpi_cmd, a reply for
+ * every scan) or version 2 (variable length commands, replies only for
+ * captured scans), as described in src/jtag/drivers/jtag_vpi.c.  Scanned
+ * TDI bits are returned unchanged as TDO, so there is no simulator in the
+ * way and the numbers printed are the cost of the protocol itself.
+ *
+ * Build:  cc -O2 -o jtag_vpi_loopback jtag_vpi_loopback.c
+ * Run:    ./jtag_vpi_loopback [-p port] [-2]
+ * then:   openocd -c "interface jtag_vpi; jtag_vpi_set_protocol 2" \
+ *                 -c "jtag newtap loop tap -irlen 8" ...
+ *
+ * The chain checks done by "init" fail on a loopback, so use "noinit"
+ * style scripts driving irscan/drscan/runtest loops.  Commands and scans
+ * per second are printed every second while the client is connected, and
+ * totals once it disconnects.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#define XFERT_MAX_SIZE		512
+
+#define CMD_RESET		0
+#define CMD_TMS_SEQ		1
+#define CMD_SCAN_CHAIN		2
+#define CMD_SCAN_CHAIN_FLIP_TMS	3
+#define CMD_STOP_SIMU		4
+
+#define VPI_FLAG_CAPTURE	0x01
+
+/* Must match the layout used by the driver (native integers) */
+struct vpi_cmd {
+	int cmd;
+	unsigned char buffer_out[XFERT_MAX_SIZE];
+	unsigned char buffer_in[XFERT_MAX_SIZE];
+	int length;
+	int nb_bits;
+};
+
+struct stats {
+	unsigned long long commands;
+	unsigned long long scans;
+	unsigned long long replies;
+	unsigned long long bits;
+};
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int read_full(FILE *in, void *buf, size_t len)
+{
+	return len == 0 || fread(buf, len, 1, in) == 1;
+}
+
+/* Replies are flushed right away, the client may be waiting for them */
+static int write_full(FILE *out, const void *buf, size_t len)
+{
+	return fwrite(buf, len, 1, out) == 1 && fflush(out) == 0;
+}
+
+/* Handle one version 1 command; returns 0 when the client is gone */
+static int serve_v1(FILE *in, FILE *out, struct stats *st)
+{
+	struct vpi_cmd vpi;
+
+	if (!read_full(in, &vpi, sizeof(vpi)))
+		return 0;
+
+	switch (vpi.cmd) {
+	case CMD_SCAN_CHAIN:
+	case CMD_SCAN_CHAIN_FLIP_TMS:
+		if (vpi.length < 0 || vpi.length > XFERT_MAX_SIZE)
+			return 0;
+		memcpy(vpi.buffer_in, vpi.buffer_out, vpi.length);
+		st->scans++;
+		st->replies++;
+		st->bits += vpi.nb_bits;
+		if (!write_full(out, &vpi, sizeof(vpi)))
+			return 0;
+		break;
+	case CMD_TMS_SEQ:
+		st->bits += vpi.nb_bits;
+		break;
+	case CMD_STOP_SIMU:
+		return 0;
+	default:
+		break;
+	}
+
+	return 1;
+}
+
+/* Handle one version 2 command; returns 0 when the client is gone */
+static int serve_v2(FILE *in, FILE *out, struct stats *st, uint8_t **buf, size_t *buf_size)
+{
+	uint8_t header[8];
+
+	if (!read_full(in, header, sizeof(header)))
+		return 0;
+
+	uint32_t nb_bits = header[4] | header[5] << 8 | header[6] << 16
+		| (uint32_t)header[7] << 24;
+	size_t nb_bytes = (nb_bits + 7) / 8;
+
+	if (nb_bytes > *buf_size) {
+		uint8_t *p = realloc(*buf, nb_bytes);
+		if (!p) {
+			fprintf(stderr, "out of memory\n");
+			exit(1);
+		}
+		*buf = p;
+		*buf_size = nb_bytes;
+	}
+	if (!read_full(in, *buf, nb_bytes))
+		return 0;
+
+	st->bits += nb_bits;
+
+	switch (header[0]) {
+	case CMD_SCAN_CHAIN:
+	case CMD_SCAN_CHAIN_FLIP_TMS:
+		st->scans++;
+		if (header[1] & VPI_FLAG_CAPTURE) {
+			st->replies++;
+			if (!write_full(out, *buf, nb_bytes))
+				return 0;
+		}
+		break;
+	case CMD_STOP_SIMU:
+		return 0;
+	default:
+		break;
+	}
+
+	return 1;
+}
+
+static void print_rate(const char *what, const struct stats *st,
+		const struct stats *last, double seconds)
+{
+	fprintf(stderr, "%s: %.0f commands/s, %.0f scans/s, %.0f replies/s, %.0f kbit/s\n",
+			what,
+			(st->commands - last->commands) / seconds,
+			(st->scans - last->scans) / seconds,
+			(st->replies - last->replies) / seconds,
+			(st->bits - last->bits) / seconds / 1000);
+}
+
+static void serve(int fd, int version)
+{
+	struct stats st = { 0 }, last = { 0 };
+	uint8_t *buf = NULL;
+	size_t buf_size = 0;
+	double start = now(), tick = start;
+	FILE *in = fdopen(fd, "r");
+	FILE *out = fdopen(dup(fd), "w");
+
+	if (!in || !out) {
+		perror("fdopen");
+		exit(1);
+	}
+
+	for (;;) {
+		int ok = version == 1 ? serve_v1(in, out, &st) : serve_v2(in, out, &st, &buf, &buf_size);
+		if (!ok)
+			break;
+		st.commands++;
+
+		/* only look at the clock every so often, it is not free */
+		if ((st.commands & 0x3ff) == 0) {
+			double t = now();
+			if (t - tick >= 1.0) {
+				print_rate("rate", &st, &last, t - tick);
+				last = st;
+				tick = t;
+			}
+		}
+	}
+
+	double elapsed = now() - start;
+	struct stats zero = { 0 };
+
+	fprintf(stderr, "%llu commands, %llu scans, %llu replies, %llu bits in %.3f s\n",
+			st.commands, st.scans, st.replies, st.bits, elapsed);
+	if (elapsed > 0)
+		print_rate("average", &st, &zero, elapsed);
+
+	free(buf);
+	fclose(in);
+	fclose(out);
+}
+
+int main(int argc, char **argv)
+{
+	int port = 5555;
+	int version = 1;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "p:2")) != -1) {
+		switch (opt) {
+		case 'p':
+			port = atoi(optarg);
+			break;
+		case '2':
+			version = 2;
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-p port] [-2]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	int sock = socket(AF_INET, SOCK_STREAM, 0);
+	int one = 1;
+	struct sockaddr_in addr = {
+		.sin_family = AF_INET,
+		.sin_port = htons(port),
+		.sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+	};
+
+	setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(sock, 1) < 0) {
+		perror("bind");
+		return 1;
+	}
+
+	fprintf(stderr, "listening on port %d, protocol version %d\n", port, version);
+
+	for (;;) {
+		int fd = accept(sock, NULL, NULL);
+		if (fd < 0) {
+			perror("accept");
+			return 1;
+		}
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+		serve(fd, version);
+	}
+}
@@ -0,0 +1,294 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Reference server for the OpenOCD remote_bitbang driver.
+ *
+ * It models a single JTAG TAP with a configurable IR length and IDCODE,
+ * implementing IDCODE and BYPASS (every other instruction selects BYPASS),
+ * and speaks both the character protocol and the binary vector extension
+ * ('X' / 'V') described in doc/manual/jtag/drivers/remote_bitbang.txt.
+ *
+ * Build:  cc -O2 -o remote_bitbang_server remote_bitbang_server.c
+ * Run:    ./remote_bitbang_server [-p port] [-i idcode] [-l irlen]
+ * then:   openocd -c "interface remote_bitbang; remote_bitbang_port 3335" \
+ *                 -c "jtag newtap sim tap -irlen 4 -expected-id 0x12345677"
+ *
+ * The binary extension is only used when the client is configured with
+ * "remote_bitbang_binary on".  When the client disconnects, the number of
+ * TCK cycles and commands is printed, so the character and binary
+ * protocols can be compared by running with and without that setting.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+enum tap_state {
+	TLR, RTI, SELECT_DR, CAPTURE_DR, SHIFT_DR, EXIT1_DR, PAUSE_DR, EXIT2_DR, UPDATE_DR,
+	SELECT_IR, CAPTURE_IR, SHIFT_IR, EXIT1_IR, PAUSE_IR, EXIT2_IR, UPDATE_IR,
+};
+
+/* next state for TMS = 0 and TMS = 1 */
+static const enum tap_state next_state[16][2] = {
+	[TLR]        = { RTI, TLR },
+	[RTI]        = { RTI, SELECT_DR },
+	[SELECT_DR]  = { CAPTURE_DR, SELECT_IR },
+	[CAPTURE_DR] = { SHIFT_DR, EXIT1_DR },
+	[SHIFT_DR]   = { SHIFT_DR, EXIT1_DR },
+	[EXIT1_DR]   = { PAUSE_DR, UPDATE_DR },
+	[PAUSE_DR]   = { PAUSE_DR, EXIT2_DR },
+	[EXIT2_DR]   = { SHIFT_DR, UPDATE_DR },
+	[UPDATE_DR]  = { RTI, SELECT_DR },
+	[SELECT_IR]  = { CAPTURE_IR, TLR },
+	[CAPTURE_IR] = { SHIFT_IR, EXIT1_IR },
+	[SHIFT_IR]   = { SHIFT_IR, EXIT1_IR },
+	[EXIT1_IR]   = { PAUSE_IR, UPDATE_IR },
+	[PAUSE_IR]   = { PAUSE_IR, EXIT2_IR },
+	[EXIT2_IR]   = { SHIFT_IR, UPDATE_IR },
+	[UPDATE_IR]  = { RTI, SELECT_DR },
+};
+
+struct tap {
+	enum tap_state state;
+	unsigned ir_len;
+	uint32_t ir;
+	uint32_t idcode;
+	uint64_t shift;		/* IR or DR shift register, bit 0 is on TDO */
+	unsigned shift_len;
+	int tck;
+	unsigned long long cycles;
+};
+
+#define IR_IDCODE 0x1
+
+static int tap_tdo(const struct tap *tap)
+{
+	if (tap->state == SHIFT_DR || tap->state == SHIFT_IR)
+		return tap->shift & 1;
+	return 0;
+}
+
+static void tap_reset(struct tap *tap)
+{
+	tap->state = TLR;
+	tap->ir = IR_IDCODE;
+}
+
+/* One rising edge of TCK */
+static void tap_clock(struct tap *tap, int tms, int tdi)
+{
+	tap->cycles++;
+
+	switch (tap->state) {
+	case CAPTURE_IR:
+		/* IEEE 1149.1: the two least significant bits capture 01 */
+		tap->shift = 1;
+		tap->shift_len = tap->ir_len;
+		break;
+	case CAPTURE_DR:
+		if (tap->ir == IR_IDCODE) {
+			tap->shift = tap->idcode;
+			tap->shift_len = 32;
+		} else {
+			tap->shift = 0;
+			tap->shift_len = 1;
+		}
+		break;
+	case SHIFT_IR:
+	case SHIFT_DR:
+		tap->shift >>= 1;
+		if (tdi)
+			tap->shift |= 1ull << (tap->shift_len - 1);
+		break;
+	default:
+		break;
+	}
+
+	tap->state = next_state[tap->state][tms ? 1 : 0];
+
+	if (tap->state == UPDATE_IR)
+		tap->ir = tap->shift & ((1ull << tap->ir_len) - 1);
+	else if (tap->state == TLR)
+		tap->ir = IR_IDCODE;
+}
+
+static int read_full(FILE *in, void *buf, size_t len)
+{
+	return len == 0 || fread(buf, len, 1, in) == 1;
+}
+
+/* Serve one client; returns when it quits or disconnects */
+static void serve(int fd, struct tap *tap)
+{
+	FILE *in = fdopen(fd, "r");
+	FILE *out = fdopen(dup(fd), "w");
+	unsigned long long commands = 0, vectors = 0;
+	uint8_t *tms = NULL, *tdi = NULL, *tdo = NULL;
+	size_t buf_size = 0;
+	int tms_pin = 0, tdi_pin = 0;
+	int c;
+
+	if (!in || !out) {
+		perror("fdopen");
+		exit(1);
+	}
+
+	tap->cycles = 0;
+
+	while ((c = fgetc(in)) != EOF) {
+		commands++;
+
+		switch (c) {
+		case '0': case '1': case '2': case '3':
+		case '4': case '5': case '6': case '7': {
+			int tck = (c - '0') & 4;
+			tms_pin = (c - '0') & 2;
+			tdi_pin = (c - '0') & 1;
+			if (tck && !tap->tck)
+				tap_clock(tap, tms_pin, tdi_pin);
+			tap->tck = tck;
+			break;
+		}
+		case 'R':
+			fputc(tap_tdo(tap) ? '1' : '0', out);
+			fflush(out);
+			break;
+		case 'r': case 's': case 't': case 'u':
+			/* TRST asserted */
+			if ((c - 'r') & 2)
+				tap_reset(tap);
+			break;
+		case 'B': case 'b':
+			break;
+		case 'Q':
+			goto done;
+		case 'X':
+			fputc('X', out);
+			fputc('1', out);
+			break;
+		case 'V': {
+			uint8_t header[5];
+			if (!read_full(in, header, sizeof(header)))
+				goto done;
+
+			uint32_t num_bits = header[1] | header[2] << 8 | header[3] << 16
+				| (uint32_t)header[4] << 24;
+			size_t num_bytes = (num_bits + 7) / 8;
+			if (num_bytes > buf_size) {
+				buf_size = num_bytes;
+				tms = realloc(tms, buf_size);
+				tdi = realloc(tdi, buf_size);
+				tdo = realloc(tdo, buf_size);
+				if (!tms || !tdi || !tdo) {
+					fprintf(stderr, "out of memory\n");
+					exit(1);
+				}
+			}
+			if (!read_full(in, tms, num_bytes) || !read_full(in, tdi, num_bytes))
+				goto done;
+
+			memset(tdo, 0, num_bytes);
+			for (uint32_t i = 0; i < num_bits; i++) {
+				if (tap_tdo(tap))
+					tdo[i / 8] |= 1 << (i % 8);
+				tap_clock(tap, (tms[i / 8] >> (i % 8)) & 1, (tdi[i / 8] >> (i % 8)) & 1);
+			}
+			tap->tck = 0;
+			vectors++;
+
+			if (header[0] & 1) {
+				fwrite(tdo, num_bytes, 1, out);
+				fflush(out);
+			}
+			break;
+		}
+		default:
+			/* ignore anything else, e.g. whitespace */
+			break;
+		}
+	}
+
+done:
+	fprintf(stderr, "%llu TCK cycles, %llu commands, %llu vectors\n",
+			tap->cycles, commands, vectors);
+	free(tms);
+	free(tdi);
+	free(tdo);
+	fclose(in);
+	fclose(out);
+}
+
+int main(int argc, char **argv)
+{
+	struct tap tap = { .ir_len = 4, .idcode = 0x12345677 };
+	int port = 3335;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "p:i:l:")) != -1) {
+		switch (opt) {
+		case 'p':
+			port = atoi(optarg);
+			break;
+		case 'i':
+			tap.idcode = strtoul(optarg, NULL, 0);
+			break;
+		case 'l':
+			tap.ir_len = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-p port] [-i idcode] [-l irlen]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	if (tap.ir_len < 2 || tap.ir_len > 32) {
+		fprintf(stderr, "IR length must be 2..32\n");
+		return 1;
+	}
+
+	int sock = socket(AF_INET, SOCK_STREAM, 0);
+	int one = 1;
+	struct sockaddr_in addr = {
+		.sin_family = AF_INET,
+		.sin_port = htons(port),
+		.sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+	};
+
+	setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(sock, 1) < 0) {
+		perror("bind");
+		return 1;
+	}
+
+	fprintf(stderr, "listening on port %d, IDCODE 0x%08x, IR length %u\n",
+			port, tap.idcode, tap.ir_len);
+
+	for (;;) {
+		int fd = accept(sock, NULL, NULL);
+		if (fd < 0) {
+			perror("accept");
+			return 1;
+		}
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+		tap_reset(&tap);
+		serve(fd, &tap);
+	}
+}
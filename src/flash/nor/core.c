@@ -38,11 +38,27 @@
 
 static struct flash_bank *flash_banks;
 
+/* Drop the cached target memory of a sector range, or of the whole bank
+ * for a range the driver is left to reject. Called for failed operations
+ * as well, the flash may have been changed partially. */
+static void flash_invalidate_sectors(struct flash_bank *bank, int first, int last)
+{
+	if (first < 0 || first > last || last >= bank->num_sectors || !bank->sectors) {
+		target_mem_cache_invalidate(bank->target, bank->base, bank->size);
+		return;
+	}
+
+	uint32_t start = bank->sectors[first].offset;
+	uint32_t end = bank->sectors[last].offset + bank->sectors[last].size;
+	target_mem_cache_invalidate(bank->target, bank->base + start, end - start);
+}
+
 int flash_driver_erase(struct flash_bank *bank, int first, int last)
 {
 	int retval;
 
 	retval = bank->driver->erase(bank, first, last);
+	flash_invalidate_sectors(bank, first, last);
 	if (retval != ERROR_OK)
 		LOG_ERROR("failed erasing sectors %d to %d", first, last);
 
@@ -86,6 +102,7 @@ int flash_driver_write(struct flash_bank *bank,
 	int retval;
 
 	retval = bank->driver->write(bank, buffer, offset, count);
+	target_mem_cache_invalidate(bank->target, bank->base + offset, count);
 	if (retval != ERROR_OK) {
 		LOG_ERROR(
 			"error writing to flash at address 0x%08" PRIx32 " at offset 0x%8.8" PRIx32,
@@ -540,11 +557,399 @@ static int compare_section(const void *a, const void *b)
 		return -1;
 }
 
-int flash_write_unlock(struct target *target, struct image *image,
-	uint32_t *written, int erase, bool unlock)
+/* Programming steps of one contiguous run within a bank. The runs of
+ * different banks are processed interleaved by flash_write_jobs(). */
+enum flash_job_state {
+	FLASH_JOB_ERASE,		/* next sector erase not issued yet */
+	FLASH_JOB_ERASING,		/* sector erase issued, not complete */
+	FLASH_JOB_WRITE,
+	FLASH_JOB_DONE,
+};
+
+struct flash_write_job {
+	struct flash_bank *bank;
+	uint8_t *buffer;
+	uint32_t address;
+	uint32_t size;
+	uint32_t done;			/* bytes programmed so far */
+	bool erase_async;		/* erase through erase_start/erase_poll */
+	int sector;				/* next sector to erase */
+	int last_sector;
+	enum flash_job_state state;
+};
+
+struct flash_write_plan {
+	struct flash_write_job *jobs;
+	int num_jobs;
+	uint8_t **buffers;		/* run buffers the jobs point into */
+	int num_buffers;
+};
+
+/* while other banks are erasing, program in slices of about this size
+ * so their next sector erases are not held back for too long */
+#define FLASH_WRITE_SLICE	(16 * 1024)
+
+static int flash_plan_add_buffer(struct flash_write_plan *plan, uint8_t *buffer)
+{
+	uint8_t **buffers = realloc(plan->buffers,
+			(plan->num_buffers + 1) * sizeof(*buffers));
+	if (buffers == NULL) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	plan->buffers = buffers;
+	plan->buffers[plan->num_buffers++] = buffer;
+	return ERROR_OK;
+}
+
+static int flash_plan_add_job(struct flash_write_plan *plan, struct flash_bank *c,
+	uint8_t *buffer, uint32_t address, uint32_t size)
+{
+	struct flash_write_job *jobs = realloc(plan->jobs,
+			(plan->num_jobs + 1) * sizeof(*jobs));
+	if (jobs == NULL) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	plan->jobs = jobs;
+
+	struct flash_write_job *job = &plan->jobs[plan->num_jobs++];
+	memset(job, 0, sizeof(*job));
+	job->bank = c;
+	job->buffer = buffer;
+	job->address = address;
+	job->size = size;
+	return ERROR_OK;
+}
+
+static void flash_plan_free(struct flash_write_plan *plan)
+{
+	for (int i = 0; i < plan->num_buffers; i++)
+		free(plan->buffers[i]);
+	free(plan->buffers);
+	free(plan->jobs);
+}
+
+/* sector index of a bank offset, -1 if outside of the bank */
+static int flash_sector_of(struct flash_bank *c, uint32_t offset)
+{
+	for (int i = 0; i < c->num_sectors; i++) {
+		if (offset >= c->sectors[i].offset &&
+				offset - c->sectors[i].offset < c->sectors[i].size)
+			return i;
+	}
+	return -1;
+}
+
+static bool flash_bank_erase_async(struct flash_bank *c)
+{
+	return c->driver->erase_start && c->driver->erase_poll;
+}
+
+/* Set up the sector range erased through the driver's asynchronous
+ * erase, padding the job to whole sectors like flash_erase_address_range() */
+static int flash_job_erase_range(struct flash_write_job *job)
+{
+	struct flash_bank *c = job->bank;
+	uint32_t start = job->address - c->base;
+	uint32_t end = start + job->size;
+
+	job->sector = flash_sector_of(c, start);
+	job->last_sector = flash_sector_of(c, end - 1);
+	if (job->sector < 0 || job->last_sector < 0) {
+		LOG_ERROR("address range 0x%8.8" PRIx32 " .. 0x%8.8" PRIx32
+			" is not within the sectors of the bank",
+			job->address, job->address + job->size - 1);
+		return ERROR_FLASH_DST_BREAKS_ALIGNMENT;
+	}
+
+	/* whole banks are left to the driver, it may have a faster
+	 * mass erase */
+	job->erase_async = job->sector > 0 ||
+		job->last_sector < c->num_sectors - 1;
+	if (!job->erase_async)
+		return ERROR_OK;
+
+	struct flash_sector *first = &c->sectors[job->sector];
+	struct flash_sector *last = &c->sectors[job->last_sector];
+	if (first->offset != start)
+		LOG_WARNING("Adding extra erase range, %#8.8x to %#8.8x",
+			(unsigned) first->offset, (unsigned) start - 1);
+	if (last->offset + last->size != end)
+		LOG_WARNING("Adding extra erase range, %#8.8x to %#8.8x",
+			(unsigned) end, (unsigned) (last->offset + last->size - 1));
+
+	return ERROR_OK;
+}
+
+/* jobs of one bank run in order, only jobs of distinct banks overlap */
+static bool flash_job_blocked(struct flash_write_plan *plan, int index)
+{
+	for (int i = 0; i < index; i++) {
+		if (plan->jobs[i].bank == plan->jobs[index].bank &&
+				plan->jobs[i].state != FLASH_JOB_DONE)
+			return true;
+	}
+	return false;
+}
+
+static bool flash_jobs_erasing(struct flash_write_plan *plan)
 {
+	for (int i = 0; i < plan->num_jobs; i++) {
+		if (plan->jobs[i].state == FLASH_JOB_ERASING)
+			return true;
+	}
+	return false;
+}
+
+/* bytes to program in the next step of a job */
+static uint32_t flash_job_write_count(struct flash_write_plan *plan,
+	struct flash_write_job *job)
+{
+	struct flash_bank *c = job->bank;
+	uint32_t remaining = job->size - job->done;
+
+	if (remaining <= FLASH_WRITE_SLICE || !flash_jobs_erasing(plan))
+		return remaining;
+
+	/* end the slice on a sector boundary to keep the driver's
+	 * alignment requirements */
+	uint32_t offset = job->address - c->base + job->done;
+	int sector = flash_sector_of(c, offset + FLASH_WRITE_SLICE - 1);
+	if (sector < 0)
+		return remaining;
+	uint32_t end = c->sectors[sector].offset + c->sectors[sector].size;
+	return MIN(end - offset, remaining);
+}
+
+/* Advance a job by one step. Sets *progress unless the job only waited
+ * for its bank to finish an erase. */
+static int flash_job_step(struct target *target, struct flash_write_plan *plan,
+	struct flash_write_job *job, bool *progress)
+{
+	struct flash_bank *c = job->bank;
 	int retval = ERROR_OK;
 
+	switch (job->state) {
+	case FLASH_JOB_ERASE:
+		*progress = true;
+		if (!job->erase_async) {
+			retval = flash_erase_address_range(target,
+					true, job->address, job->size);
+			job->state = FLASH_JOB_WRITE;
+			break;
+		}
+		retval = c->driver->erase_start(c, job->sector);
+		flash_invalidate_sectors(c, job->sector, job->sector);
+		if (retval != ERROR_OK) {
+			LOG_ERROR("failed erasing sector %d", job->sector);
+			break;
+		}
+		job->state = FLASH_JOB_ERASING;
+		break;
+	case FLASH_JOB_ERASING: {
+		bool done = false;
+		retval = c->driver->erase_poll(c, &done);
+		if (retval != ERROR_OK) {
+			/* the erase is over, the driver relocked the bank */
+			LOG_ERROR("failed erasing sector %d", job->sector);
+			job->state = FLASH_JOB_DONE;
+			break;
+		}
+		if (!done)
+			break;
+		*progress = true;
+		if (++job->sector > job->last_sector)
+			job->state = FLASH_JOB_WRITE;
+		else
+			job->state = FLASH_JOB_ERASE;
+		break;
+	}
+	case FLASH_JOB_WRITE: {
+		*progress = true;
+		uint32_t count = flash_job_write_count(plan, job);
+		retval = flash_driver_write(c, job->buffer + job->done,
+				job->address - c->base + job->done, count);
+		job->done += count;
+		if (job->done == job->size)
+			job->state = FLASH_JOB_DONE;
+		break;
+	}
+	case FLASH_JOB_DONE:
+		break;
+	}
+
+	return retval;
+}
+
+/* After an error, wait for the sector erases still running on other
+ * banks. Their drivers lock the flash again when an erase completes
+ * or fails, so no bank is left unlocked with an erase in flight. */
+static void flash_jobs_abort(struct flash_write_plan *plan)
+{
+	while (flash_jobs_erasing(plan)) {
+		for (int i = 0; i < plan->num_jobs; i++) {
+			struct flash_write_job *job = &plan->jobs[i];
+			struct flash_bank *c = job->bank;
+			bool done = false;
+
+			if (job->state != FLASH_JOB_ERASING)
+				continue;
+			if (c->driver->erase_poll(c, &done) != ERROR_OK) {
+				LOG_ERROR("failed erasing sector %d", job->sector);
+				done = true;
+			}
+			if (done)
+				job->state = FLASH_JOB_DONE;
+		}
+
+		if (flash_jobs_erasing(plan))
+			alive_sleep(1);
+	}
+}
+
+/* Unlock, erase and program all planned runs. Runs of one bank are
+ * handled in address order; while a bank whose driver supports
+ * asynchronous erase waits for a sector erase, the other banks are
+ * erased or programmed instead of polling it. */
+static int flash_write_jobs(struct target *target, struct flash_write_plan *plan,
+	int erase, bool unlock, uint32_t *written)
+{
+	int retval = ERROR_OK;
+	int pending = plan->num_jobs;
+
+	for (int i = 0; i < plan->num_jobs; i++) {
+		struct flash_write_job *job = &plan->jobs[i];
+
+		if (unlock) {
+			retval = flash_unlock_address_range(target, job->address, job->size);
+			if (retval != ERROR_OK)
+				return retval;
+		}
+
+		job->state = FLASH_JOB_WRITE;
+		if (erase) {
+			job->state = FLASH_JOB_ERASE;
+			if (flash_bank_erase_async(job->bank)) {
+				retval = flash_job_erase_range(job);
+				if (retval != ERROR_OK)
+					return retval;
+			}
+		}
+	}
+
+	while (pending > 0) {
+		bool progress = false;
+
+		for (int i = 0; i < plan->num_jobs; i++) {
+			struct flash_write_job *job = &plan->jobs[i];
+			uint32_t done = job->done;
+
+			if (job->state == FLASH_JOB_DONE || flash_job_blocked(plan, i))
+				continue;
+
+			retval = flash_job_step(target, plan, job, &progress);
+			*written += job->done - done;
+			if (retval != ERROR_OK) {
+				flash_jobs_abort(plan);
+				return retval;
+			}
+			if (job->state == FLASH_JOB_DONE)
+				pending--;
+		}
+
+		/* all the remaining banks are busy erasing */
+		if (!progress)
+			alive_sleep(1);
+	}
+
+	return ERROR_OK;
+}
+
+/* compare part of a run with the flash contents, using the target's
+ * checksum algorithm when it has one */
+static bool flash_run_unchanged(struct target *target,
+	uint8_t *buffer, uint32_t address, uint32_t size)
+{
+	uint32_t flash_crc, image_crc;
+
+	if (target_checksum_memory(target, address, size, &flash_crc) != ERROR_OK)
+		return false;
+	if (image_calculate_checksum(buffer, size, &image_crc) != ERROR_OK)
+		return false;
+
+	return flash_crc == image_crc;
+}
+
+/* Plan only those sectors of a run whose contents differ from the
+ * image. Adjacent differing sectors are still written as one run. */
+static int flash_plan_run_delta(struct target *target, struct flash_write_plan *plan,
+	struct flash_bank *c, uint8_t *buffer, uint32_t run_address, uint32_t run_size,
+	uint32_t *skipped)
+{
+	uint32_t run_start = run_address - c->base;
+	uint32_t run_end = run_start + run_size;
+	uint32_t pending_start = 0, pending_end = 0;
+	int retval = ERROR_OK;
+
+	/* cheap path for a fully unchanged run */
+	if (flash_run_unchanged(target, buffer, run_address, run_size)) {
+		LOG_DEBUG("flash run at 0x%8.8" PRIx32 " unchanged", run_address);
+		*skipped += run_size;
+		return ERROR_OK;
+	}
+
+	for (int i = 0; i <= c->num_sectors; i++) {
+		uint32_t start = run_end, end = run_end;
+		bool changed = false;
+
+		if (i < c->num_sectors) {
+			struct flash_sector *f = c->sectors + i;
+			if (f->offset + f->size <= run_start)
+				continue;
+			if (f->offset >= run_end)
+				i = c->num_sectors;
+			else {
+				start = MAX(f->offset, run_start);
+				end = MIN(f->offset + f->size, run_end);
+				changed = !flash_run_unchanged(target,
+						buffer + (start - run_start),
+						c->base + start, end - start);
+			}
+		}
+
+		if (changed) {
+			if (pending_end == pending_start)
+				pending_start = start;
+			pending_end = end;
+			continue;
+		}
+
+		if (pending_end > pending_start) {
+			retval = flash_plan_add_job(plan, c,
+					buffer + (pending_start - run_start),
+					c->base + pending_start, pending_end - pending_start);
+			if (retval != ERROR_OK)
+				return retval;
+			pending_start = pending_end = 0;
+		}
+
+		if (end > start) {
+			LOG_DEBUG("flash sector %d unchanged, skipped", i);
+			*skipped += end - start;
+		}
+	}
+
+	return retval;
+}
+
+static int flash_write_image(struct target *target, struct image *image,
+	uint32_t *written, uint32_t *skipped, int erase, bool unlock, bool skip_unchanged)
+{
+	int retval = ERROR_OK;
+	uint32_t run_written = 0, run_skipped = 0;
+	struct flash_write_plan plan = { NULL, 0, NULL, 0 };
+
 	int section;
 	uint32_t section_offset;
 	struct flash_bank *c;
@@ -553,9 +958,6 @@ int flash_write_unlock(struct target *target, struct image *image,
 	section = 0;
 	section_offset = 0;
 
-	if (written)
-		*written = 0;
-
 	if (erase) {
 		/* assume all sectors need erasing - stops any problems
 		 * when flash_write is called multiple times */
@@ -724,41 +1126,49 @@ int flash_write_unlock(struct target *target, struct image *image,
 			}
 		}
 
-		retval = ERROR_OK;
-
-		if (unlock)
-			retval = flash_unlock_address_range(target, run_address, run_size);
-		if (retval == ERROR_OK) {
-			if (erase) {
-				/* calculate and erase sectors */
-				retval = flash_erase_address_range(target,
-						true, run_address, run_size);
-			}
-		}
-
-		if (retval == ERROR_OK) {
-			/* write flash sectors */
-			retval = flash_driver_write(c, buffer, run_address - c->base, run_size);
-		}
-
-		free(buffer);
-
+		retval = flash_plan_add_buffer(&plan, buffer);
 		if (retval != ERROR_OK) {
-			/* abort operation */
+			free(buffer);
 			goto done;
 		}
 
-		if (written != NULL)
-			*written += run_size;	/* add run size to total written counter */
+		if (skip_unchanged)
+			retval = flash_plan_run_delta(target, &plan, c, buffer,
+					run_address, run_size, &run_skipped);
+		else
+			retval = flash_plan_add_job(&plan, c, buffer, run_address, run_size);
+		if (retval != ERROR_OK)
+			goto done;
 	}
 
+	retval = flash_write_jobs(target, &plan, erase, unlock, &run_written);
+
 done:
+	flash_plan_free(&plan);
+
+	if (written != NULL)
+		*written = run_written;
+	if (skipped != NULL)
+		*skipped = run_skipped;
+
 	free(sections);
 	free(padding);
 
 	return retval;
 }
 
+int flash_write_unlock(struct target *target, struct image *image,
+	uint32_t *written, int erase, bool unlock)
+{
+	return flash_write_image(target, image, written, NULL, erase, unlock, false);
+}
+
+int flash_write_delta(struct target *target, struct image *image,
+	uint32_t *written, uint32_t *skipped, int erase, bool unlock)
+{
+	return flash_write_image(target, image, written, skipped, erase, unlock, true);
+}
+
 int flash_write(struct target *target, struct image *image,
 	uint32_t *written, int erase)
 {
@@ -211,6 +211,36 @@ struct flash_driver {
 	 * @returns ERROR_OK if successful; otherwise, an error code.
 	 */
 	int (*auto_probe)(struct flash_bank *bank);
+
+	/**
+	 * Optional asynchronous sector erase, used by the flash write
+	 * scheduler to program other banks while this one is erasing.
+	 * Starts erasing a single sector and returns without waiting
+	 * for the erase to complete.  Only one erase per bank is
+	 * started at a time, and no other operation is issued to the
+	 * bank until @c erase_poll reported completion.  Banks of
+	 * a driver providing these must be able to erase while other
+	 * banks of the same target are programmed.  On error the
+	 * driver locks the flash controller again before returning.
+	 *
+	 * @param bank The bank to erase a sector of.
+	 * @param sector The number of the sector to erase.
+	 * @returns ERROR_OK if successful; otherwise, an error code.
+	 */
+	int (*erase_start)(struct flash_bank *bank, int sector);
+
+	/**
+	 * Check for completion of the erase issued by @c erase_start,
+	 * without blocking.  The driver is responsible for the erase
+	 * timeout and for updating @c flash_sector_s::is_erased.  Once
+	 * the erase completed or failed (an error is returned) the
+	 * flash controller is locked again.
+	 *
+	 * @param bank The bank being erased.
+	 * @param done Set to true once the erase has completed.
+	 * @returns ERROR_OK if successful; otherwise, an error code.
+	 */
+	int (*erase_poll)(struct flash_bank *bank, bool *done);
 };
 
 #define FLASH_BANK_COMMAND_HANDLER(name) \
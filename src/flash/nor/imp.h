@@ -47,5 +47,8 @@ int flash_driver_read(struct flash_bank *bank,
 /* write (optional verify) an image to flash memory of the given target */
 int flash_write_unlock(struct target *target, struct image *image,
 		uint32_t *written, int erase, bool unlock);
+/* same, but skip the sectors whose contents already match the image */
+int flash_write_delta(struct target *target, struct image *image,
+		uint32_t *written, uint32_t *skipped, int erase, bool unlock);
 
 #endif /* FLASH_NOR_IMP_H */
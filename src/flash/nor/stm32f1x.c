@@ -30,6 +30,7 @@
 
 #include "imp.h"
 #include <helper/binarybuffer.h>
+#include <helper/time_support.h>
 #include <target/algorithm.h>
 #include <target/armv7m.h>
 
@@ -126,6 +127,10 @@ struct stm32x_flash_bank {
 	int user_data_offset;
 	int option_offset;
 	uint32_t user_bank_size;
+
+	/* sector erase started by stm32x_erase_start() */
+	int erase_sector;
+	int64_t erase_started;
 };
 
 static int stm32x_mass_erase(struct flash_bank *bank);
@@ -165,27 +170,11 @@ static inline int stm32x_get_flash_status(struct flash_bank *bank, uint32_t *sta
 	return target_read_u32(target, stm32x_get_flash_reg(bank, STM32_FLASH_SR), status);
 }
 
-static int stm32x_wait_status_busy(struct flash_bank *bank, int timeout)
+static int stm32x_check_status_errors(struct flash_bank *bank, uint32_t status)
 {
 	struct target *target = bank->target;
-	uint32_t status;
 	int retval = ERROR_OK;
 
-	/* wait for busy to clear */
-	for (;;) {
-		retval = stm32x_get_flash_status(bank, &status);
-		if (retval != ERROR_OK)
-			return retval;
-		LOG_DEBUG("status: 0x%" PRIx32 "", status);
-		if ((status & FLASH_BSY) == 0)
-			break;
-		if (timeout-- <= 0) {
-			LOG_ERROR("timed out waiting for flash");
-			return ERROR_FAIL;
-		}
-		alive_sleep(1);
-	}
-
 	if (status & FLASH_WRPRTERR) {
 		LOG_ERROR("stm32x device protected");
 		retval = ERROR_FAIL;
@@ -207,6 +196,29 @@ static int stm32x_wait_status_busy(struct flash_bank *bank, int timeout)
 	return retval;
 }
 
+static int stm32x_wait_status_busy(struct flash_bank *bank, int timeout)
+{
+	uint32_t status;
+	int retval = ERROR_OK;
+
+	/* wait for busy to clear */
+	for (;;) {
+		retval = stm32x_get_flash_status(bank, &status);
+		if (retval != ERROR_OK)
+			return retval;
+		LOG_DEBUG("status: 0x%" PRIx32 "", status);
+		if ((status & FLASH_BSY) == 0)
+			break;
+		if (timeout-- <= 0) {
+			LOG_ERROR("timed out waiting for flash");
+			return ERROR_FAIL;
+		}
+		alive_sleep(1);
+	}
+
+	return stm32x_check_status_errors(bank, status);
+}
+
 static int stm32x_check_operation_supported(struct flash_bank *bank)
 {
 	struct stm32x_flash_bank *stm32x_info = bank->driver_priv;
@@ -467,6 +479,80 @@ static int stm32x_erase(struct flash_bank *bank, int first, int last)
 	return ERROR_OK;
 }
 
+/* lock the flash registers again after a failed erase step, keeping
+ * the error of that step */
+static int stm32x_erase_abort(struct flash_bank *bank, int retval)
+{
+	target_write_u32(bank->target, stm32x_get_flash_reg(bank, STM32_FLASH_CR), FLASH_LOCK);
+	return retval;
+}
+
+static int stm32x_erase_start(struct flash_bank *bank, int sector)
+{
+	struct stm32x_flash_bank *stm32x_info = bank->driver_priv;
+	struct target *target = bank->target;
+
+	if (bank->target->state != TARGET_HALTED) {
+		LOG_ERROR("Target not halted");
+		return ERROR_TARGET_NOT_HALTED;
+	}
+
+	/* unlock flash registers */
+	int retval = target_write_u32(target, stm32x_get_flash_reg(bank, STM32_FLASH_KEYR), KEY1);
+	if (retval != ERROR_OK)
+		return stm32x_erase_abort(bank, retval);
+	retval = target_write_u32(target, stm32x_get_flash_reg(bank, STM32_FLASH_KEYR), KEY2);
+	if (retval != ERROR_OK)
+		return stm32x_erase_abort(bank, retval);
+
+	retval = target_write_u32(target, stm32x_get_flash_reg(bank, STM32_FLASH_CR), FLASH_PER);
+	if (retval != ERROR_OK)
+		return stm32x_erase_abort(bank, retval);
+	retval = target_write_u32(target, stm32x_get_flash_reg(bank, STM32_FLASH_AR),
+			bank->base + bank->sectors[sector].offset);
+	if (retval != ERROR_OK)
+		return stm32x_erase_abort(bank, retval);
+	retval = target_write_u32(target,
+			stm32x_get_flash_reg(bank, STM32_FLASH_CR), FLASH_PER | FLASH_STRT);
+	if (retval != ERROR_OK)
+		return stm32x_erase_abort(bank, retval);
+
+	stm32x_info->erase_sector = sector;
+	stm32x_info->erase_started = timeval_ms();
+
+	return ERROR_OK;
+}
+
+static int stm32x_erase_poll(struct flash_bank *bank, bool *done)
+{
+	struct stm32x_flash_bank *stm32x_info = bank->driver_priv;
+	struct target *target = bank->target;
+	uint32_t status;
+
+	*done = false;
+
+	int retval = stm32x_get_flash_status(bank, &status);
+	if (retval != ERROR_OK)
+		return stm32x_erase_abort(bank, retval);
+
+	if (status & FLASH_BSY) {
+		if (timeval_ms() - stm32x_info->erase_started > FLASH_ERASE_TIMEOUT) {
+			LOG_ERROR("timed out waiting for flash");
+			return stm32x_erase_abort(bank, ERROR_FAIL);
+		}
+		return ERROR_OK;
+	}
+
+	retval = stm32x_check_status_errors(bank, status);
+	if (retval != ERROR_OK)
+		return stm32x_erase_abort(bank, retval);
+
+	bank->sectors[stm32x_info->erase_sector].is_erased = 1;
+	*done = true;
+
+	return target_write_u32(target, stm32x_get_flash_reg(bank, STM32_FLASH_CR), FLASH_LOCK);
+}
+
 static int stm32x_protect(struct flash_bank *bank, int set, int first, int last)
 {
 	struct stm32x_flash_bank *stm32x_info = NULL;
@@ -1564,4 +1650,6 @@ struct flash_driver stm32f1x_flash = {
 	.erase_check = default_flash_blank_check,
 	.protect_check = stm32x_protect_check,
 	.info = get_stm32x_info,
+	.erase_start = stm32x_erase_start,
+	.erase_poll = stm32x_erase_poll,
 };
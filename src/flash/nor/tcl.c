@@ -346,6 +346,7 @@ COMMAND_HANDLER(handle_flash_write_image_command)
 
 	struct image image;
 	uint32_t written;
+	uint32_t skipped = 0;
 
 	int retval;
 
@@ -355,6 +356,7 @@ COMMAND_HANDLER(handle_flash_write_image_command)
 	/* flash auto-erase is disabled by default*/
 	int auto_erase = 0;
 	bool auto_unlock = false;
+	bool delta = false;
 
 	for (;; ) {
 		if (strcmp(CMD_ARGV[0], "erase") == 0) {
@@ -367,6 +369,11 @@ COMMAND_HANDLER(handle_flash_write_image_command)
 			CMD_ARGV++;
 			CMD_ARGC--;
 			command_print(CMD_CTX, "auto unlock enabled");
+		} else if (strcmp(CMD_ARGV[0], "delta") == 0) {
+			delta = true;
+			CMD_ARGV++;
+			CMD_ARGC--;
+			command_print(CMD_CTX, "unchanged sectors will be skipped");
 		} else
 			break;
 	}
@@ -396,7 +403,11 @@ COMMAND_HANDLER(handle_flash_write_image_command)
 	if (retval != ERROR_OK)
 		return retval;
 
-	retval = flash_write_unlock(target, &image, &written, auto_erase, auto_unlock);
+	if (delta)
+		retval = flash_write_delta(target, &image, &written, &skipped,
+				auto_erase, auto_unlock);
+	else
+		retval = flash_write_unlock(target, &image, &written, auto_erase, auto_unlock);
 	if (retval != ERROR_OK) {
 		image_close(&image);
 		return retval;
@@ -406,6 +417,9 @@ COMMAND_HANDLER(handle_flash_write_image_command)
 		command_print(CMD_CTX, "wrote %" PRIu32 " bytes from file %s "
 			"in %fs (%0.3f KiB/s)", written, CMD_ARGV[0],
 			duration_elapsed(&bench), duration_kbps(&bench, written));
+		if (delta)
+			command_print(CMD_CTX, "skipped %" PRIu32 " bytes already "
+				"matching the image", skipped);
 	}
 
 	image_close(&image);
@@ -704,9 +718,10 @@ static const struct command_registration flash_exec_command_handlers[] = {
 		.name = "write_image",
 		.handler = handle_flash_write_image_command,
 		.mode = COMMAND_EXEC,
-		.usage = "[erase] [unlock] filename [offset [file_type]]",
+		.usage = "[erase] [unlock] [delta] filename [offset [file_type]]",
 		.help = "Write an image to flash.  Optionally first unprotect "
-			"and/or erase the region to be used.  Allow optional "
+			"and/or erase the region to be used, and skip sectors "
+			"already holding the image data.  Allow optional "
 			"offset from beginning of bank (defaults to zero)",
 	},
 	{
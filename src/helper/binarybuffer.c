@@ -27,6 +27,18 @@
 
 #include "log.h"
 #include "binarybuffer.h"
+#include "time_support.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#define BUF_HAVE_SSE2
+/* the AVX2 routines are built with a function target attribute and
+ * only used when the CPU reports AVX2 at run time */
+#if defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)
+#include <immintrin.h>
+#define BUF_HAVE_AVX2
+#endif
+#endif
 
 static const unsigned char bit_reverse_table256[] = {
 	0x00, 0x80, 0x40, 0xC0, 0x20, 0xA0, 0x60, 0xE0, 0x10, 0x90, 0x50, 0xD0, 0x30, 0xB0, 0x70, 0xF0,
@@ -47,6 +59,182 @@ static const unsigned char bit_reverse_table256[] = {
 	0x0F, 0x8F, 0x4F, 0xCF, 0x2F, 0xAF, 0x6F, 0xEF, 0x1F, 0x9F, 0x5F, 0xDF, 0x3F, 0xBF, 0x7F, 0xFF
 };
 
+/*
+ * Inner loops of the unaligned bit copy, the masked compare and the
+ * shift. shift_bytes() stores n bytes, dst[i] = src[i..i+1] >> shift
+ * with 0 < shift < 8, and reads n + 1 source bytes. It may run in place
+ * as long as dst <= src. cmp_mask_bytes() returns true if any of the
+ * n bytes differ under the mask.
+ */
+struct buf_ops {
+	const char *name;
+	void (*shift_bytes)(uint8_t *dst, const uint8_t *src, unsigned n, unsigned shift);
+	bool (*cmp_mask_bytes)(const uint8_t *buf1, const uint8_t *buf2,
+			const uint8_t *mask, unsigned n);
+};
+
+static void buf_shift_bytes_generic(uint8_t *dst, const uint8_t *src, unsigned n, unsigned shift)
+{
+	unsigned i = 0;
+
+	for (; i + 8 <= n; i += 8) {
+		uint64_t w = (le_to_h_u64(src + i) >> shift) |
+			((uint64_t)src[i + 8] << (64 - shift));
+		h_u64_to_le(dst + i, w);
+	}
+	for (; i < n; i++)
+		dst[i] = (src[i] >> shift) | (src[i + 1] << (8 - shift));
+}
+
+static bool buf_cmp_mask_bytes_generic(const uint8_t *buf1, const uint8_t *buf2,
+		const uint8_t *mask, unsigned n)
+{
+	unsigned i = 0;
+
+	/* compare a word at a time, byte order doesn't matter here */
+	for (; i + 8 <= n; i += 8) {
+		if ((le_to_h_u64(buf1 + i) ^ le_to_h_u64(buf2 + i)) & le_to_h_u64(mask + i))
+			return true;
+	}
+	for (; i < n; i++) {
+		if ((buf1[i] ^ buf2[i]) & mask[i])
+			return true;
+	}
+	return false;
+}
+
+static const struct buf_ops buf_ops_generic = {
+	.name = "generic",
+	.shift_bytes = buf_shift_bytes_generic,
+	.cmp_mask_bytes = buf_cmp_mask_bytes_generic,
+};
+
+#ifdef BUF_HAVE_SSE2
+/* SSE2 has no byte shifts, shift 16 bit lanes and drop the bits that
+ * crossed into the neighbouring byte */
+static void buf_shift_bytes_sse2(uint8_t *dst, const uint8_t *src, unsigned n, unsigned shift)
+{
+	const __m128i cnt_lo = _mm_cvtsi32_si128(shift);
+	const __m128i cnt_hi = _mm_cvtsi32_si128(8 - shift);
+	const __m128i mask_lo = _mm_set1_epi8((char)(0xff >> shift));
+	const __m128i mask_hi = _mm_set1_epi8((char)(0xff << (8 - shift)));
+	unsigned i = 0;
+
+	for (; i + 16 <= n; i += 16) {
+		__m128i a = _mm_loadu_si128((const __m128i *)(src + i));
+		__m128i b = _mm_loadu_si128((const __m128i *)(src + i + 1));
+		a = _mm_and_si128(_mm_srl_epi16(a, cnt_lo), mask_lo);
+		b = _mm_and_si128(_mm_sll_epi16(b, cnt_hi), mask_hi);
+		_mm_storeu_si128((__m128i *)(dst + i), _mm_or_si128(a, b));
+	}
+	buf_shift_bytes_generic(dst + i, src + i, n - i, shift);
+}
+
+static bool buf_cmp_mask_bytes_sse2(const uint8_t *buf1, const uint8_t *buf2,
+		const uint8_t *mask, unsigned n)
+{
+	const __m128i zero = _mm_setzero_si128();
+	unsigned i = 0;
+
+	for (; i + 16 <= n; i += 16) {
+		__m128i d = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(buf1 + i)),
+				_mm_loadu_si128((const __m128i *)(buf2 + i)));
+		d = _mm_and_si128(d, _mm_loadu_si128((const __m128i *)(mask + i)));
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(d, zero)) != 0xffff)
+			return true;
+	}
+	return buf_cmp_mask_bytes_generic(buf1 + i, buf2 + i, mask + i, n - i);
+}
+
+static const struct buf_ops buf_ops_sse2 = {
+	.name = "sse2",
+	.shift_bytes = buf_shift_bytes_sse2,
+	.cmp_mask_bytes = buf_cmp_mask_bytes_sse2,
+};
+#endif
+
+#ifdef BUF_HAVE_AVX2
+/* short runs, e.g. scan fields, go to the word loop before any 256 bit
+ * register is touched to keep clear of AVX to SSE transition stalls */
+__attribute__((target("avx2")))
+static void buf_shift_bytes_avx2(uint8_t *dst, const uint8_t *src, unsigned n, unsigned shift)
+{
+	if (n < 32) {
+		buf_shift_bytes_generic(dst, src, n, shift);
+		return;
+	}
+
+	const __m128i cnt_lo = _mm_cvtsi32_si128(shift);
+	const __m128i cnt_hi = _mm_cvtsi32_si128(8 - shift);
+	const __m256i mask_lo = _mm256_set1_epi8((char)(0xff >> shift));
+	const __m256i mask_hi = _mm256_set1_epi8((char)(0xff << (8 - shift)));
+	unsigned i = 0;
+
+	for (; i + 32 <= n; i += 32) {
+		__m256i a = _mm256_loadu_si256((const __m256i *)(src + i));
+		__m256i b = _mm256_loadu_si256((const __m256i *)(src + i + 1));
+		a = _mm256_and_si256(_mm256_srl_epi16(a, cnt_lo), mask_lo);
+		b = _mm256_and_si256(_mm256_sll_epi16(b, cnt_hi), mask_hi);
+		_mm256_storeu_si256((__m256i *)(dst + i), _mm256_or_si256(a, b));
+	}
+	buf_shift_bytes_generic(dst + i, src + i, n - i, shift);
+}
+
+__attribute__((target("avx2")))
+static bool buf_cmp_mask_bytes_avx2(const uint8_t *buf1, const uint8_t *buf2,
+		const uint8_t *mask, unsigned n)
+{
+	if (n < 32)
+		return buf_cmp_mask_bytes_generic(buf1, buf2, mask, n);
+
+	const __m256i zero = _mm256_setzero_si256();
+	unsigned i = 0;
+
+	for (; i + 32 <= n; i += 32) {
+		__m256i d = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(buf1 + i)),
+				_mm256_loadu_si256((const __m256i *)(buf2 + i)));
+		d = _mm256_and_si256(d, _mm256_loadu_si256((const __m256i *)(mask + i)));
+		if ((uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(d, zero)) != 0xffffffff)
+			return true;
+	}
+	return buf_cmp_mask_bytes_generic(buf1 + i, buf2 + i, mask + i, n - i);
+}
+
+static const struct buf_ops buf_ops_avx2 = {
+	.name = "avx2",
+	.shift_bytes = buf_shift_bytes_avx2,
+	.cmp_mask_bytes = buf_cmp_mask_bytes_avx2,
+};
+#endif
+
+/* all variants this build and CPU can run, best first */
+static const struct buf_ops *buf_ops_available[4];
+static const struct buf_ops *buf_ops;
+
+static const struct buf_ops *buf_ops_select(void)
+{
+	unsigned n = 0;
+
+#ifdef BUF_HAVE_AVX2
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		buf_ops_available[n++] = &buf_ops_avx2;
+#endif
+#ifdef BUF_HAVE_SSE2
+	buf_ops_available[n++] = &buf_ops_sse2;
+#endif
+	buf_ops_available[n++] = &buf_ops_generic;
+
+	buf_ops = buf_ops_available[0];
+	LOG_DEBUG("binarybuffer: using %s bit copy and compare", buf_ops->name);
+	return buf_ops;
+}
+
+static inline const struct buf_ops *buf_get_ops(void)
+{
+	return buf_ops ? buf_ops : buf_ops_select();
+}
+
 void *buf_cpy(const void *from, void *_to, unsigned size)
 {
 	if (NULL == from || NULL == _to)
@@ -99,10 +287,9 @@ bool buf_cmp_mask(const void *_buf1, const void *_buf2,
 
 	const uint8_t *buf1 = _buf1, *buf2 = _buf2, *mask = _mask;
 	unsigned last = size / 8;
-	for (unsigned i = 0; i < last; i++) {
-		if (buf_cmp_masked(buf1[i], buf2[i], mask[i]))
-			return true;
-	}
+	if (buf_get_ops()->cmp_mask_bytes(buf1, buf2, mask, last))
+		return true;
+
 	unsigned trailing = size % 8;
 	if (!trailing)
 		return false;
@@ -125,46 +312,57 @@ void *buf_set_ones(void *_buf, unsigned size)
 	return buf;
 }
 
+/* get n <= 8 bits from src starting at bit offset start */
+static inline uint8_t buf_get_bits8(const uint8_t *src, unsigned start, unsigned n)
+{
+	unsigned sq = start % 8;
+	unsigned v = src[start / 8] >> sq;
+
+	if (sq + n > 8)
+		v |= src[start / 8 + 1] << (8 - sq);
+	return v;
+}
+
 void *buf_set_buf(const void *_src, unsigned src_start,
 	void *_dst, unsigned dst_start, unsigned len)
 {
 	const uint8_t *src = _src;
 	uint8_t *dst = _dst;
-	unsigned i, sb, db, sq, dq, lb, lq;
+	unsigned sq, dq, n;
+	uint8_t mask;
 
-	sb = src_start / 8;
-	db = dst_start / 8;
-	sq = src_start % 8;
+	/* bits up to the next destination byte boundary */
 	dq = dst_start % 8;
-	lb = len / 8;
-	lq = len % 8;
-
-	src += sb;
-	dst += db;
-
-	/* check if both buffers are on byte boundary and
-	 * len is a multiple of 8bit so we can simple copy
-	 * the buffer */
-	if ((sq == 0) && (dq == 0) &&  (lq == 0)) {
-		for (i = 0; i < lb; i++)
-			*dst++ = *src++;
-		return _dst;
+	if (dq && len) {
+		n = 8 - dq;
+		if (n > len)
+			n = len;
+		mask = ((1 << n) - 1) << dq;
+		dst[dst_start / 8] = (dst[dst_start / 8] & ~mask) |
+			((buf_get_bits8(src, src_start, n) << dq) & mask);
+		src_start += n;
+		dst_start += n;
+		len -= n;
 	}
 
-	/* fallback to slow bit copy */
-	for (i = 0; i < len; i++) {
-		if (((*src >> (sq&7)) & 1) == 1)
-			*dst |= 1 << (dq&7);
-		else
-			*dst &= ~(1 << (dq&7));
-		if (sq++ == 7) {
-			sq = 0;
-			src++;
-		}
-		if (dq++ == 7) {
-			dq = 0;
-			dst++;
-		}
+	/* destination is byte aligned now, copy whole bytes */
+	dst += dst_start / 8;
+	sq = src_start % 8;
+	if (sq == 0) {
+		memmove(dst, src + src_start / 8, len / 8);
+	} else {
+		/* the extra source byte read for the last whole byte is
+		 * always part of the range as the source isn't byte aligned */
+		buf_get_ops()->shift_bytes(dst, src + src_start / 8, len / 8, sq);
+	}
+	dst += len / 8;
+	src_start += len & ~7u;
+	len %= 8;
+
+	/* trailing bits */
+	if (len) {
+		mask = (1 << len) - 1;
+		*dst = (*dst & ~mask) | (buf_get_bits8(src, src_start, len) & mask);
 	}
 
 	return _dst;
@@ -371,50 +569,536 @@ void bit_copy_discard(struct bit_copy_queue *q)
 	}
 }
 
-int unhexify(char *bin, const char *hex, int count)
+/* value of a hex digit plus 0x10, 0 for anything else */
+static const uint8_t hex_digit_value[256] = {
+	['0'] = 0x10, ['1'] = 0x11, ['2'] = 0x12, ['3'] = 0x13, ['4'] = 0x14,
+	['5'] = 0x15, ['6'] = 0x16, ['7'] = 0x17, ['8'] = 0x18, ['9'] = 0x19,
+	['a'] = 0x1a, ['b'] = 0x1b, ['c'] = 0x1c, ['d'] = 0x1d, ['e'] = 0x1e, ['f'] = 0x1f,
+	['A'] = 0x1a, ['B'] = 0x1b, ['C'] = 0x1c, ['D'] = 0x1d, ['E'] = 0x1e, ['F'] = 0x1f,
+};
+
+static const char hex_digits[] = "0123456789abcdef";
+
+static int unhexify_table(uint8_t *bin, const uint8_t *h, int count)
 {
-	int i, tmp;
+	int i;
 
+	/* the table holds digit + 0x10 so that 0 marks an invalid character,
+	 * the terminating NUL included, the low digit isn't read past it */
 	for (i = 0; i < count; i++) {
-		if (sscanf(hex + (2 * i), "%02x", &tmp) != 1)
-			return i;
-		bin[i] = tmp;
+		uint8_t hi = hex_digit_value[h[2 * i]];
+		if (!hi)
+			break;
+		uint8_t lo = hex_digit_value[h[2 * i + 1]];
+		if (!lo)
+			break;
+		bin[i] = ((hi & 0xf) << 4) | (lo & 0xf);
+	}
+
+	return i;
+}
+
+static void hexify_table(char *hex, const uint8_t *bin, int count)
+{
+	for (int i = 0; i < count; i++) {
+		hex[2 * i] = hex_digits[bin[i] >> 4];
+		hex[2 * i + 1] = hex_digits[bin[i] & 0xf];
+	}
+}
+
+#ifdef BUF_HAVE_SSE2
+/* nibble value of 16 hex digits, sets *valid to all ones for the
+ * characters that are hex digits; signed compares reject 0x80-0xff */
+static inline __m128i unhexify_sse2_digits(__m128i c, __m128i *valid)
+{
+	__m128i l = _mm_or_si128(c, _mm_set1_epi8(0x20));
+	__m128i digit = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('0' - 1)),
+			_mm_cmpgt_epi8(_mm_set1_epi8('9' + 1), c));
+	__m128i alpha = _mm_and_si128(_mm_cmpgt_epi8(l, _mm_set1_epi8('a' - 1)),
+			_mm_cmpgt_epi8(_mm_set1_epi8('f' + 1), l));
+
+	*valid = _mm_or_si128(digit, alpha);
+	return _mm_or_si128(_mm_and_si128(digit, _mm_sub_epi8(c, _mm_set1_epi8('0'))),
+			_mm_and_si128(alpha, _mm_sub_epi8(l, _mm_set1_epi8('a' - 10))));
+}
+
+/* 16 bytes from 32 digits per step; stops in front of the first block
+ * holding anything but hex digits and leaves it to the table loop */
+static int unhexify_sse2(uint8_t *bin, const uint8_t *h, int count, size_t len)
+{
+	const __m128i low_byte = _mm_set1_epi16(0x00ff);
+	int i = 0;
+
+	for (; i + 16 <= count && 2 * (size_t)i + 32 <= len; i += 16) {
+		__m128i v0, v1;
+		__m128i d0 = unhexify_sse2_digits(_mm_loadu_si128((const __m128i *)(h + 2 * i)), &v0);
+		__m128i d1 = unhexify_sse2_digits(_mm_loadu_si128((const __m128i *)(h + 2 * i + 16)), &v1);
+		if (_mm_movemask_epi8(_mm_and_si128(v0, v1)) != 0xffff)
+			break;
+		/* high digit in the even, low digit in the odd byte */
+		d0 = _mm_or_si128(_mm_slli_epi16(_mm_and_si128(d0, low_byte), 4), _mm_srli_epi16(d0, 8));
+		d1 = _mm_or_si128(_mm_slli_epi16(_mm_and_si128(d1, low_byte), 4), _mm_srli_epi16(d1, 8));
+		_mm_storeu_si128((__m128i *)(bin + i), _mm_packus_epi16(d0, d1));
+	}
+
+	return i;
+}
+
+static int hexify_sse2(char *hex, const uint8_t *bin, int count)
+{
+	const __m128i nibble = _mm_set1_epi8(0x0f);
+	const __m128i nine = _mm_set1_epi8(9);
+	int i = 0;
+
+	for (; i + 16 <= count; i += 16) {
+		__m128i b = _mm_loadu_si128((const __m128i *)(bin + i));
+		__m128i hi = _mm_and_si128(_mm_srli_epi16(b, 4), nibble);
+		__m128i lo = _mm_and_si128(b, nibble);
+		/* '0' + n, plus 'a' - '0' - 10 for the letters */
+		hi = _mm_add_epi8(_mm_add_epi8(hi, _mm_set1_epi8('0')),
+				_mm_and_si128(_mm_cmpgt_epi8(hi, nine), _mm_set1_epi8('a' - '0' - 10)));
+		lo = _mm_add_epi8(_mm_add_epi8(lo, _mm_set1_epi8('0')),
+				_mm_and_si128(_mm_cmpgt_epi8(lo, nine), _mm_set1_epi8('a' - '0' - 10)));
+		_mm_storeu_si128((__m128i *)(hex + 2 * i), _mm_unpacklo_epi8(hi, lo));
+		_mm_storeu_si128((__m128i *)(hex + 2 * i + 16), _mm_unpackhi_epi8(hi, lo));
 	}
 
 	return i;
 }
+#endif
+
+int unhexify(char *bin, const char *hex, int count)
+{
+	const uint8_t *h = (const uint8_t *)hex;
+	int i = 0;
+
+#ifdef BUF_HAVE_SSE2
+	/* the vector loads must not run past the end of the string */
+	if (count >= 16)
+		i = unhexify_sse2((uint8_t *)bin, h, count, strnlen(hex, 2 * (size_t)count));
+#endif
+
+	return i + unhexify_table((uint8_t *)bin + i, h + 2 * i, count - i);
+}
 
 int hexify(char *hex, const char *bin, int count, int out_maxlen)
 {
-	int i, cmd_len = 0;
+	const uint8_t *b = (const uint8_t *)bin;
+	int i = 0;
 
 	/* May use a length, or a null-terminated string as input. */
 	if (count == 0)
 		count = strlen(bin);
 
-	for (i = 0; i < count; i++)
-		cmd_len += snprintf(hex + cmd_len, out_maxlen - cmd_len, "%02x", bin[i] & 0xff);
+	/* room for the digits and the terminating NUL */
+	if (out_maxlen < 3)
+		count = 0;
+	else if (count > (out_maxlen - 1) / 2)
+		count = (out_maxlen - 1) / 2;
 
-	return cmd_len;
+#ifdef BUF_HAVE_SSE2
+	i = hexify_sse2(hex, b, count);
+#endif
+	hexify_table(hex + 2 * i, b + i, count - i);
+	if (out_maxlen > 0)
+		hex[2 * count] = '\0';
+
+	return 2 * count;
 }
 
 void buffer_shr(void *_buf, unsigned buf_len, unsigned count)
 {
-	unsigned i;
 	unsigned char *buf = _buf;
+	const unsigned char *src;
 	unsigned bytes_to_remove;
 	unsigned shift;
+	unsigned len;
 
 	bytes_to_remove = count / 8;
 	shift = count - (bytes_to_remove * 8);
 
-	for (i = 0; i < (buf_len - 1); i++)
-		buf[i] = (buf[i] >> shift) | ((buf[i+1] << (8 - shift)) & 0xff);
+	if (bytes_to_remove >= buf_len) {
+		memset(buf, 0, buf_len);
+		return;
+	}
+
+	/* shift and move down in one pass, every source byte is read
+	 * before the destination catches up with it */
+	len = buf_len - bytes_to_remove;
+	src = buf + bytes_to_remove;
+	if (shift == 0)
+		memmove(buf, src, len);
+	else {
+		buf_get_ops()->shift_bytes(buf, src, len - 1, shift);
+		buf[len - 1] = src[len - 1] >> shift;
+	}
+
+	memset(&buf[len], 0, bytes_to_remove);
+}
+
+/*
+ * Benchmark of the bit copy, masked compare and shift routines. The
+ * byte and bit at a time versions they replaced are kept here as the
+ * reference every variant is checked against before it is timed.
+ */
+static void buf_set_buf_bitwise(const uint8_t *src, unsigned src_start,
+	uint8_t *dst, unsigned dst_start, unsigned len)
+{
+	unsigned sq = src_start % 8, dq = dst_start % 8;
+
+	src += src_start / 8;
+	dst += dst_start / 8;
+	for (unsigned i = 0; i < len; i++) {
+		if (((*src >> sq) & 1) == 1)
+			*dst |= 1 << dq;
+		else
+			*dst &= ~(1 << dq);
+		if (sq++ == 7) {
+			sq = 0;
+			src++;
+		}
+		if (dq++ == 7) {
+			dq = 0;
+			dst++;
+		}
+	}
+}
+
+static bool buf_cmp_mask_bytewise(const uint8_t *buf1, const uint8_t *buf2,
+	const uint8_t *mask, unsigned size)
+{
+	unsigned last = size / 8;
+	for (unsigned i = 0; i < last; i++) {
+		if (buf_cmp_masked(buf1[i], buf2[i], mask[i]))
+			return true;
+	}
+	unsigned trailing = size % 8;
+	if (!trailing)
+		return false;
+	return buf_cmp_trailing(buf1[last], buf2[last], mask[last], trailing);
+}
+
+static void buffer_shr_bytewise(uint8_t *buf, unsigned buf_len, unsigned count)
+{
+	unsigned bytes_to_remove = count / 8;
+	unsigned shift = count % 8;
 
-	buf[(buf_len - 1)] = buf[(buf_len - 1)] >> shift;
+	for (unsigned i = 0; i < buf_len - 1; i++)
+		buf[i] = (buf[i] >> shift) | ((buf[i + 1] << (8 - shift)) & 0xff);
+	buf[buf_len - 1] = buf[buf_len - 1] >> shift;
 
 	if (bytes_to_remove) {
 		memmove(buf, &buf[bytes_to_remove], buf_len - bytes_to_remove);
 		memset(&buf[buf_len - bytes_to_remove], 0, bytes_to_remove);
 	}
 }
+
+struct buf_bench {
+	unsigned bytes;
+	uint8_t *src;		/* random data */
+	uint8_t *src2;		/* src with the bits outside mask flipped */
+	uint8_t *mask;
+	uint8_t *init;		/* initial dst contents */
+	uint8_t *dst;
+	bool result;
+};
+
+/* field size of the bit_copy() run, a typical scan field */
+#define BUF_BENCH_FIELD 37
+
+static void buf_bench_set_buf_ref(struct buf_bench *b)
+{
+	buf_set_buf_bitwise(b->src, 3, b->dst, 5, b->bytes * 8 - 8);
+}
+
+static void buf_bench_set_buf(struct buf_bench *b)
+{
+	buf_set_buf(b->src, 3, b->dst, 5, b->bytes * 8 - 8);
+}
+
+static void buf_bench_bit_copy_ref(struct buf_bench *b)
+{
+	for (unsigned off = 0; off + BUF_BENCH_FIELD + 3 <= b->bytes * 8; off += BUF_BENCH_FIELD)
+		buf_set_buf_bitwise(b->src, off + 1, b->dst, off + 3, BUF_BENCH_FIELD);
+}
+
+static void buf_bench_bit_copy(struct buf_bench *b)
+{
+	for (unsigned off = 0; off + BUF_BENCH_FIELD + 3 <= b->bytes * 8; off += BUF_BENCH_FIELD)
+		bit_copy(b->dst, off + 3, b->src, off + 1, BUF_BENCH_FIELD);
+}
+
+static void buf_bench_cmp_mask_ref(struct buf_bench *b)
+{
+	b->result = buf_cmp_mask_bytewise(b->src, b->src2, b->mask, b->bytes * 8 - 3);
+}
+
+static void buf_bench_cmp_mask(struct buf_bench *b)
+{
+	b->result = buf_cmp_mask(b->src, b->src2, b->mask, b->bytes * 8 - 3);
+}
+
+static void buf_bench_shr_ref(struct buf_bench *b)
+{
+	buffer_shr_bytewise(b->dst, b->bytes, 13);
+}
+
+static void buf_bench_shr(struct buf_bench *b)
+{
+	buffer_shr(b->dst, b->bytes, 13);
+}
+
+static const struct {
+	const char *name;
+	void (*ref)(struct buf_bench *b);
+	void (*run)(struct buf_bench *b);
+} buf_bench_ops[] = {
+	{ "buf_set_buf", buf_bench_set_buf_ref, buf_bench_set_buf },
+	{ "bit_copy", buf_bench_bit_copy_ref, buf_bench_bit_copy },
+	{ "buf_cmp_mask", buf_bench_cmp_mask_ref, buf_bench_cmp_mask },
+	{ "buffer_shr", buf_bench_shr_ref, buf_bench_shr },
+};
+
+/* xorshift, the benchmark data only has to look random */
+static void buf_bench_fill(uint8_t *buf, unsigned len, uint32_t *seed)
+{
+	for (unsigned i = 0; i < len; i++) {
+		*seed ^= *seed << 13;
+		*seed ^= *seed >> 17;
+		*seed ^= *seed << 5;
+		buf[i] = *seed;
+	}
+}
+
+static void buf_bench_time(struct command_context *cmd_ctx, const char *op,
+	const char *variant, void (*run)(struct buf_bench *b), struct buf_bench *b)
+{
+	/* roughly 8 MiB per variant */
+	unsigned iterations = DIV_ROUND_UP(8 << 20, b->bytes);
+	struct duration bench;
+
+	memcpy(b->dst, b->init, b->bytes);
+	duration_start(&bench);
+	for (unsigned i = 0; i < iterations; i++)
+		run(b);
+	duration_measure(&bench);
+
+	command_print(cmd_ctx, "%-12s %-8s %12.3f KiB/s", op, variant,
+		duration_kbps(&bench, (size_t)iterations * b->bytes));
+}
+
+COMMAND_HANDLER(handle_buf_benchmark_command)
+{
+	struct buf_bench b = { .bytes = 4096 };
+	const struct buf_ops *saved = buf_get_ops();
+	int retval = ERROR_OK;
+	uint32_t seed = 0x12345678;
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+	if (CMD_ARGC == 1)
+		COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], b.bytes);
+	if (b.bytes < 16 || b.bytes > (64 << 20)) {
+		command_print(CMD_CTX, "buffer size must be between 16 bytes and 64 MiB");
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+
+	b.src = malloc(b.bytes);
+	b.src2 = malloc(b.bytes);
+	b.mask = malloc(b.bytes);
+	b.init = malloc(b.bytes);
+	b.dst = malloc(b.bytes);
+	uint8_t *expect = malloc(b.bytes);
+	if (!b.src || !b.src2 || !b.mask || !b.init || !b.dst || !expect) {
+		LOG_ERROR("Out of memory");
+		retval = ERROR_FAIL;
+		goto out;
+	}
+
+	buf_bench_fill(b.src, b.bytes, &seed);
+	buf_bench_fill(b.mask, b.bytes, &seed);
+	buf_bench_fill(b.init, b.bytes, &seed);
+	for (unsigned i = 0; i < b.bytes; i++)
+		b.src2[i] = b.src[i] ^ ~b.mask[i];
+
+	for (unsigned op = 0; op < ARRAY_SIZE(buf_bench_ops); op++) {
+		const char *name = buf_bench_ops[op].name;
+
+		memcpy(b.dst, b.init, b.bytes);
+		buf_bench_ops[op].ref(&b);
+		memcpy(expect, b.dst, b.bytes);
+		bool expect_result = b.result;
+		buf_bench_time(CMD_CTX, name, "bytewise", buf_bench_ops[op].ref, &b);
+
+		for (unsigned v = 0; v < ARRAY_SIZE(buf_ops_available) && buf_ops_available[v]; v++) {
+			buf_ops = buf_ops_available[v];
+
+			memcpy(b.dst, b.init, b.bytes);
+			buf_bench_ops[op].run(&b);
+			if (memcmp(expect, b.dst, b.bytes) || b.result != expect_result) {
+				command_print(CMD_CTX, "%s: %s result differs from the reference",
+					name, buf_ops->name);
+				retval = ERROR_FAIL;
+				goto out;
+			}
+			buf_bench_time(CMD_CTX, name, buf_ops->name, buf_bench_ops[op].run, &b);
+		}
+		buf_ops = saved;
+	}
+
+out:
+	buf_ops = saved;
+	free(expect);
+	free(b.dst);
+	free(b.init);
+	free(b.mask);
+	free(b.src2);
+	free(b.src);
+	return retval;
+}
+
+/* the snprintf()/sscanf() codec the table driven one replaced */
+static void hex_bench_encode_printf(char *hex, const uint8_t *bin, int count)
+{
+	for (int i = 0; i < count; i++)
+		snprintf(hex + 2 * i, 3, "%02x", bin[i]);
+}
+
+static int hex_bench_decode_scanf(uint8_t *bin, const char *hex, int count)
+{
+	unsigned tmp;
+	int i;
+
+	for (i = 0; i < count; i++) {
+		if (sscanf(hex + 2 * i, "%02x", &tmp) != 1)
+			break;
+		bin[i] = tmp;
+	}
+	return i;
+}
+
+static void hex_bench_encode_table(char *hex, const uint8_t *bin, int count)
+{
+	hexify_table(hex, bin, count);
+	hex[2 * count] = '\0';
+}
+
+static int hex_bench_decode_table(uint8_t *bin, const char *hex, int count)
+{
+	return unhexify_table(bin, (const uint8_t *)hex, count);
+}
+
+static void hex_bench_encode(char *hex, const uint8_t *bin, int count)
+{
+	hexify(hex, (const char *)bin, count, 2 * count + 1);
+}
+
+static int hex_bench_decode(uint8_t *bin, const char *hex, int count)
+{
+	return unhexify((char *)bin, hex, count);
+}
+
+static const struct {
+	const char *name;
+	void (*encode)(char *hex, const uint8_t *bin, int count);
+	int (*decode)(uint8_t *bin, const char *hex, int count);
+} hex_bench_codecs[] = {
+	{ "printf", hex_bench_encode_printf, hex_bench_decode_scanf },
+	{ "table", hex_bench_encode_table, hex_bench_decode_table },
+#ifdef BUF_HAVE_SSE2
+	{ "sse2", hex_bench_encode, hex_bench_decode },
+#endif
+};
+
+COMMAND_HANDLER(handle_hex_benchmark_command)
+{
+	const unsigned max_size = 64 << 10;
+	uint8_t *bin = malloc(max_size);
+	uint8_t *out = malloc(max_size);
+	char *hex = malloc(2 * max_size + 1);
+	char *expect = malloc(2 * max_size + 1);
+	uint32_t seed = 0x9e3779b9;
+	int retval = ERROR_OK;
+
+	if (CMD_ARGC != 0) {
+		retval = ERROR_COMMAND_SYNTAX_ERROR;
+		goto out;
+	}
+	if (!bin || !out || !hex || !expect) {
+		LOG_ERROR("Out of memory");
+		retval = ERROR_FAIL;
+		goto out;
+	}
+
+	buf_bench_fill(bin, max_size, &seed);
+	hex_bench_encode_table(expect, bin, max_size);
+
+	for (unsigned size = 1 << 10; size <= max_size; size *= 2) {
+		/* roughly 2 MiB of payload per codec and direction */
+		unsigned iterations = (2 << 20) / size;
+
+		for (unsigned c = 0; c < ARRAY_SIZE(hex_bench_codecs); c++) {
+			const char *name = hex_bench_codecs[c].name;
+			struct duration enc, dec;
+
+			hex_bench_codecs[c].encode(hex, bin, size);
+			if (memcmp(hex, expect, 2 * size) || hex[2 * size] != '\0'
+					|| hex_bench_codecs[c].decode(out, expect, size) != (int)size
+					|| memcmp(out, bin, size)) {
+				command_print(CMD_CTX, "%s: result differs from the reference", name);
+				retval = ERROR_FAIL;
+				goto out;
+			}
+
+			duration_start(&enc);
+			for (unsigned i = 0; i < iterations; i++)
+				hex_bench_codecs[c].encode(hex, bin, size);
+			duration_measure(&enc);
+
+			duration_start(&dec);
+			for (unsigned i = 0; i < iterations; i++)
+				hex_bench_codecs[c].decode(out, hex, size);
+			duration_measure(&dec);
+
+			command_print(CMD_CTX, "%5u KiB %-6s encode %12.3f KiB/s decode %12.3f KiB/s",
+				size >> 10, name,
+				duration_kbps(&enc, (size_t)iterations * size),
+				duration_kbps(&dec, (size_t)iterations * size));
+		}
+	}
+
+out:
+	free(expect);
+	free(hex);
+	free(out);
+	free(bin);
+	return retval;
+}
+
+static const struct command_registration binarybuffer_command_handlers[] = {
+	{
+		.name = "buf_benchmark",
+		.handler = handle_buf_benchmark_command,
+		.mode = COMMAND_ANY,
+		.help = "Check the bit copy, masked compare and shift variants "
+			"against the byte at a time reference and report their "
+			"throughput.",
+		.usage = "[buffer_size]",
+	},
+	{
+		.name = "hex_benchmark",
+		.handler = handle_hex_benchmark_command,
+		.mode = COMMAND_ANY,
+		.help = "Check the hex encoders and decoders used for GDB packets "
+			"and report their throughput for 1 to 64 KiB payloads.",
+		.usage = "",
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
+int binarybuffer_register_commands(struct command_context *cmd_ctx)
+{
+	/* pick the routines for this CPU at startup */
+	buf_get_ops();
+	return register_commands(cmd_ctx, NULL, binarybuffer_command_handlers);
+}
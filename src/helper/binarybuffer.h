@@ -240,4 +240,7 @@ int unhexify(char *bin, const char *hex, int count);
 int hexify(char *hex, const char *bin, int count, int out_maxlen);
 void buffer_shr(void *_buf, unsigned buf_len, unsigned count);
 
+struct command_context;
+int binarybuffer_register_commands(struct command_context *cmd_ctx);
+
 #endif /* BINARYBUFFER_H */
@@ -32,12 +32,18 @@
 #include "configuration.h"
 #include "fileio.h"
 
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+
 struct fileio_internal {
 	char *url;
 	ssize_t size;
 	enum fileio_type type;
 	enum fileio_access access;
 	FILE *file;
+	void *map;		/* read only mapping made by fileio_map() */
+	size_t map_size;
 };
 
 static inline int fileio_close_local(struct fileio_internal *fileio);
@@ -113,6 +119,8 @@ int fileio_open(struct fileio *fileio_p,
 	fileio->type = type;
 	fileio->access = access_type;
 	fileio->url = strdup(url);
+	fileio->map = NULL;
+	fileio->map_size = 0;
 
 	retval = fileio_open_local(fileio);
 
@@ -139,6 +147,11 @@ int fileio_close(struct fileio *fileio_p)
 	int retval;
 	struct fileio_internal *fileio = fileio_p->fp;
 
+#ifdef HAVE_SYS_MMAN_H
+	if (fileio->map)
+		munmap(fileio->map, fileio->map_size);
+#endif
+
 	retval = fileio_close_local(fileio);
 
 	free(fileio->url);
@@ -150,6 +163,42 @@ int fileio_close(struct fileio *fileio_p)
 	return retval;
 }
 
+int fileio_map(struct fileio *fileio_p, const uint8_t **data, size_t *size)
+{
+	struct fileio_internal *fileio = fileio_p->fp;
+
+	if (fileio->map) {
+		*data = fileio->map;
+		*size = fileio->map_size;
+		return ERROR_OK;
+	}
+
+	if (fileio->access != FILEIO_READ || fileio->type != FILEIO_BINARY ||
+			fileio->size <= 0)
+		return ERROR_FILEIO_OPERATION_NOT_SUPPORTED;
+
+#ifdef HAVE_SYS_MMAN_H
+	void *map = mmap(NULL, fileio->size, PROT_READ, MAP_PRIVATE,
+			fileno(fileio->file), 0);
+	if (map == MAP_FAILED) {
+		LOG_DEBUG("couldn't map %s: %s", fileio->url, strerror(errno));
+		return ERROR_FILEIO_OPERATION_NOT_SUPPORTED;
+	}
+#ifdef MADV_SEQUENTIAL
+	/* images are mostly read front to back */
+	madvise(map, fileio->size, MADV_SEQUENTIAL);
+#endif
+
+	fileio->map = map;
+	fileio->map_size = fileio->size;
+	*data = map;
+	*size = fileio->map_size;
+	return ERROR_OK;
+#else
+	return ERROR_FILEIO_OPERATION_NOT_SUPPORTED;
+#endif
+}
+
 int fileio_seek(struct fileio *fileio_p, size_t position)
 {
 	int retval;
@@ -52,6 +52,11 @@ int fileio_open(struct fileio *fileio,
 		const char *url, enum fileio_access access_type, enum fileio_type type);
 int fileio_close(struct fileio *fileio);
 
+/* Map a file opened for binary reading into memory. The mapping stays
+ * valid until the file is closed. Fails with
+ * ERROR_FILEIO_OPERATION_NOT_SUPPORTED where files can't be mapped. */
+int fileio_map(struct fileio *fileio, const uint8_t **data, size_t *size);
+
 int fileio_seek(struct fileio *fileio, size_t position);
 int fileio_fgets(struct fileio *fileio, size_t size, void *buffer);
 
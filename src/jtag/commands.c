@@ -37,12 +37,24 @@
 
 struct cmd_queue_page {
 	void *address;
+	size_t size;
 	size_t used;
 	struct cmd_queue_page *next;
 };
 
 #define CMD_QUEUE_PAGE_SIZE (1024 * 1024)
+/* pages kept for reuse after the queue has been flushed, anything
+ * above this is given back to the system */
+#define CMD_QUEUE_MAX_FREE_PAGES 16
+
+/* pages in use by the current queue, allocation happens in the tail */
 static struct cmd_queue_page *cmd_queue_pages;
+static struct cmd_queue_page *cmd_queue_tail;
+/* standard size pages recycled from previous queues */
+static struct cmd_queue_page *cmd_queue_free_pages;
+static unsigned cmd_queue_num_free_pages;
+
+static struct cmd_queue_stats cmd_queue_stats;
 
 struct jtag_command *jtag_command_queue;
 static struct jtag_command **next_command_pointer = &jtag_command_queue;
@@ -63,8 +75,8 @@ void jtag_queue_command(struct jtag_command *cmd)
 
 void *cmd_queue_alloc(size_t size)
 {
-	struct cmd_queue_page **p_page = &cmd_queue_pages;
-	int offset;
+	struct cmd_queue_page *page;
+	size_t offset;
 	uint8_t *t;
 
 	/*
@@ -99,26 +111,42 @@ void *cmd_queue_alloc(size_t size)
 	size = (size + ALIGN_SIZE - 1) & (~(ALIGN_SIZE - 1));
 	/* Done... */
 
-	if (*p_page) {
-		while ((*p_page)->next)
-			p_page = &((*p_page)->next);
-		if (CMD_QUEUE_PAGE_SIZE - (*p_page)->used < size)
-			p_page = &((*p_page)->next);
+	page = cmd_queue_tail;
+	if (!page || page->size - page->used < size) {
+		if (size <= CMD_QUEUE_PAGE_SIZE && cmd_queue_free_pages) {
+			page = cmd_queue_free_pages;
+			cmd_queue_free_pages = page->next;
+			cmd_queue_num_free_pages--;
+			cmd_queue_stats.pages_recycled++;
+		} else {
+			page = malloc(sizeof(struct cmd_queue_page));
+			page->size = (size < CMD_QUEUE_PAGE_SIZE) ?
+						CMD_QUEUE_PAGE_SIZE : size;
+			page->address = malloc(page->size);
+			cmd_queue_stats.pages_allocated++;
+		}
+		page->used = 0;
+		page->next = NULL;
+
+		if (cmd_queue_tail)
+			cmd_queue_tail->next = page;
+		else
+			cmd_queue_pages = page;
+		cmd_queue_tail = page;
+
+		cmd_queue_stats.pages++;
+		if (cmd_queue_stats.pages > cmd_queue_stats.max_pages)
+			cmd_queue_stats.max_pages = cmd_queue_stats.pages;
 	}
 
-	if (!*p_page) {
-		*p_page = malloc(sizeof(struct cmd_queue_page));
-		(*p_page)->used = 0;
-		size_t alloc_size = (size < CMD_QUEUE_PAGE_SIZE) ?
-					CMD_QUEUE_PAGE_SIZE : size;
-		(*p_page)->address = malloc(alloc_size);
-		(*p_page)->next = NULL;
-	}
+	offset = page->used;
+	page->used += size;
 
-	offset = (*p_page)->used;
-	(*p_page)->used += size;
+	cmd_queue_stats.bytes += size;
+	if (cmd_queue_stats.bytes > cmd_queue_stats.max_bytes)
+		cmd_queue_stats.max_bytes = cmd_queue_stats.bytes;
 
-	t = (*p_page)->address;
+	t = page->address;
 	return t + offset;
 }
 
@@ -128,12 +156,36 @@ static void cmd_queue_free(void)
 
 	while (page) {
 		struct cmd_queue_page *last = page;
-		free(page->address);
 		page = page->next;
-		free(last);
+		if (last->size == CMD_QUEUE_PAGE_SIZE &&
+				cmd_queue_num_free_pages < CMD_QUEUE_MAX_FREE_PAGES) {
+			last->next = cmd_queue_free_pages;
+			cmd_queue_free_pages = last;
+			cmd_queue_num_free_pages++;
+		} else {
+			free(last->address);
+			free(last);
+		}
 	}
 
 	cmd_queue_pages = NULL;
+	cmd_queue_tail = NULL;
+	cmd_queue_stats.pages = 0;
+	cmd_queue_stats.bytes = 0;
+}
+
+void cmd_queue_get_stats(struct cmd_queue_stats *stats)
+{
+	*stats = cmd_queue_stats;
+	stats->free_pages = cmd_queue_num_free_pages;
+}
+
+void cmd_queue_reset_stats(void)
+{
+	cmd_queue_stats.max_pages = cmd_queue_stats.pages;
+	cmd_queue_stats.max_bytes = cmd_queue_stats.bytes;
+	cmd_queue_stats.pages_allocated = 0;
+	cmd_queue_stats.pages_recycled = 0;
 }
 
 void jtag_command_queue_reset(void)
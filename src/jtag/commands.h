@@ -167,6 +167,20 @@ extern struct jtag_command *jtag_command_queue;
 
 void *cmd_queue_alloc(size_t size);
 
+/** Memory used by the command queue, see cmd_queue_alloc(). */
+struct cmd_queue_stats {
+	unsigned pages;			/**< pages used by the current queue */
+	unsigned max_pages;		/**< high-water mark of pages */
+	size_t bytes;			/**< bytes allocated in the current queue */
+	size_t max_bytes;		/**< high-water mark of bytes */
+	unsigned free_pages;		/**< pages kept for reuse */
+	unsigned pages_allocated;	/**< pages obtained from malloc() */
+	unsigned pages_recycled;	/**< pages reused from a previous queue */
+};
+
+void cmd_queue_get_stats(struct cmd_queue_stats *stats);
+void cmd_queue_reset_stats(void);
+
 void jtag_queue_command(struct jtag_command *cmd);
 void jtag_command_queue_reset(void);
 
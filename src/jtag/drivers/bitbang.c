@@ -41,6 +41,16 @@ static void bitbang_stableclocks(int num_cycles);
 
 struct bitbang_interface *bitbang_interface;
 
+/* Scans whose TDO is delivered by bitbang_interface->flush() */
+struct bitbang_pending_scan {
+	struct scan_command *cmd;
+	uint8_t *buffer;
+};
+
+static struct bitbang_pending_scan *pending_scans;
+static unsigned pending_scan_count;
+static unsigned pending_scan_size;
+
 /* DANGER!!!! clock absolutely *MUST* be 0 in idle or reset won't work!
  *
  * Set this to 1 and str912 reset halt will fail.
@@ -179,7 +189,30 @@ static void bitbang_stableclocks(int num_cycles)
 	}
 }
 
-static void bitbang_scan(bool ir_scan, enum scan_type type, uint8_t *buffer, int scan_size)
+static bool bitbang_bulk(void)
+{
+	return bitbang_interface->scan && bitbang_interface->flush;
+}
+
+/* Send a whole scan through the bulk callbacks */
+static int bitbang_scan_vector(enum scan_type type, uint8_t *buffer, int scan_size)
+{
+	/* TMS stays low until the last bit, which leaves the shift state */
+	uint8_t *tms = calloc(1, DIV_ROUND_UP(scan_size, 8));
+	if (tms == NULL) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	buf_set_u32(tms, scan_size - 1, 1, 1);
+
+	int retval = bitbang_interface->scan(tms, type == SCAN_IN ? NULL : buffer,
+			type == SCAN_OUT ? NULL : buffer, scan_size);
+	free(tms);
+
+	return retval;
+}
+
+static int bitbang_scan(bool ir_scan, enum scan_type type, uint8_t *buffer, int scan_size)
 {
 	tap_state_t saved_end_state = tap_get_end_state();
 	int bit_cnt;
@@ -196,33 +229,39 @@ static void bitbang_scan(bool ir_scan, enum scan_type type, uint8_t *buffer, int
 		bitbang_end_state(saved_end_state);
 	}
 
-	for (bit_cnt = 0; bit_cnt < scan_size; bit_cnt++) {
-		int val = 0;
-		int tms = (bit_cnt == scan_size-1) ? 1 : 0;
-		int tdi;
-		int bytec = bit_cnt/8;
-		int bcval = 1 << (bit_cnt % 8);
-
-		/* if we're just reading the scan, but don't care about the output
-		 * default to outputting 'low', this also makes valgrind traces more readable,
-		 * as it removes the dependency on an uninitialised value
-		 */
-		tdi = 0;
-		if ((type != SCAN_IN) && (buffer[bytec] & bcval))
-			tdi = 1;
-
-		bitbang_interface->write(0, tms, tdi);
-
-		if (type != SCAN_OUT)
-			val = bitbang_interface->read();
-
-		bitbang_interface->write(1, tms, tdi);
-
-		if (type != SCAN_OUT) {
-			if (val)
-				buffer[bytec] |= bcval;
-			else
-				buffer[bytec] &= ~bcval;
+	if (bitbang_bulk()) {
+		int retval = bitbang_scan_vector(type, buffer, scan_size);
+		if (retval != ERROR_OK)
+			return retval;
+	} else {
+		for (bit_cnt = 0; bit_cnt < scan_size; bit_cnt++) {
+			int val = 0;
+			int tms = (bit_cnt == scan_size-1) ? 1 : 0;
+			int tdi;
+			int bytec = bit_cnt/8;
+			int bcval = 1 << (bit_cnt % 8);
+
+			/* if we're just reading the scan, but don't care about the output
+			 * default to outputting 'low', this also makes valgrind traces more readable,
+			 * as it removes the dependency on an uninitialised value
+			 */
+			tdi = 0;
+			if ((type != SCAN_IN) && (buffer[bytec] & bcval))
+				tdi = 1;
+
+			bitbang_interface->write(0, tms, tdi);
+
+			if (type != SCAN_OUT)
+				val = bitbang_interface->read();
+
+			bitbang_interface->write(1, tms, tdi);
+
+			if (type != SCAN_OUT) {
+				if (val)
+					buffer[bytec] |= bcval;
+				else
+					buffer[bytec] &= ~bcval;
+			}
 		}
 	}
 
@@ -233,6 +272,51 @@ static void bitbang_scan(bool ir_scan, enum scan_type type, uint8_t *buffer, int
 		 */
 		bitbang_state_move(1);
 	}
+
+	return ERROR_OK;
+}
+
+/* Hand a scan buffer to jtag_read_buffer() once its TDO has arrived */
+static int bitbang_defer_scan(struct scan_command *cmd, uint8_t *buffer)
+{
+	if (pending_scan_count == pending_scan_size) {
+		unsigned size = pending_scan_size ? 2 * pending_scan_size : 64;
+		struct bitbang_pending_scan *p = realloc(pending_scans, size * sizeof(*p));
+		if (p == NULL) {
+			LOG_ERROR("Out of memory");
+			return ERROR_FAIL;
+		}
+		pending_scans = p;
+		pending_scan_size = size;
+	}
+
+	pending_scans[pending_scan_count].cmd = cmd;
+	pending_scans[pending_scan_count].buffer = buffer;
+	pending_scan_count++;
+
+	return ERROR_OK;
+}
+
+/* Collect the TDO of all deferred scans and process it */
+static int bitbang_flush(void)
+{
+	int retval = ERROR_OK;
+
+	if (!bitbang_bulk())
+		return ERROR_OK;
+
+	if (bitbang_interface->flush() != ERROR_OK)
+		retval = ERROR_JTAG_QUEUE_FAILED;
+
+	for (unsigned i = 0; i < pending_scan_count; i++) {
+		if (retval == ERROR_OK
+				&& jtag_read_buffer(pending_scans[i].buffer, pending_scans[i].cmd) != ERROR_OK)
+			retval = ERROR_JTAG_QUEUE_FAILED;
+		free(pending_scans[i].buffer);
+	}
+	pending_scan_count = 0;
+
+	return retval;
 }
 
 int bitbang_execute_queue(void)
@@ -311,16 +395,27 @@ int bitbang_execute_queue(void)
 				bitbang_end_state(cmd->cmd.scan->end_state);
 				scan_size = jtag_build_buffer(cmd->cmd.scan, &buffer);
 				type = jtag_scan_type(cmd->cmd.scan);
-				bitbang_scan(cmd->cmd.scan->ir_scan, type, buffer, scan_size);
-				if (jtag_read_buffer(buffer, cmd->cmd.scan) != ERROR_OK)
-					retval = ERROR_JTAG_QUEUE_FAILED;
-				if (buffer)
+				if (bitbang_scan(cmd->cmd.scan->ir_scan, type, buffer, scan_size) != ERROR_OK) {
 					free(buffer);
+					retval = ERROR_JTAG_QUEUE_FAILED;
+				} else if (bitbang_bulk()) {
+					if (bitbang_defer_scan(cmd->cmd.scan, buffer) != ERROR_OK) {
+						free(buffer);
+						retval = ERROR_JTAG_QUEUE_FAILED;
+					}
+				} else {
+					if (jtag_read_buffer(buffer, cmd->cmd.scan) != ERROR_OK)
+						retval = ERROR_JTAG_QUEUE_FAILED;
+					if (buffer)
+						free(buffer);
+				}
 				break;
 			case JTAG_SLEEP:
 #ifdef _DEBUG_JTAG_IO_
 				LOG_DEBUG("sleep %" PRIi32, cmd->cmd.sleep->us);
 #endif
+				if (bitbang_flush() != ERROR_OK)
+					retval = ERROR_JTAG_QUEUE_FAILED;
 				jtag_sleep(cmd->cmd.sleep->us);
 				break;
 			case JTAG_TMS:
@@ -335,5 +430,8 @@ int bitbang_execute_queue(void)
 	if (bitbang_interface->blink)
 		bitbang_interface->blink(0);
 
+	if (bitbang_flush() != ERROR_OK)
+		retval = ERROR_JTAG_QUEUE_FAILED;
+
 	return retval;
 }
@@ -31,6 +31,14 @@ struct bitbang_interface {
 	void (*write)(int tck, int tms, int tdi);
 	void (*reset)(int trst, int srst);
 	void (*blink)(int on);
+
+	/* optional bulk callbacks, used for scans when both are provided:
+	 * scan() clocks num_bits cycles with the given TMS and TDI vectors
+	 * (TDI all zero if NULL) and, if tdo is not NULL, stores the TDO
+	 * sampled before each rising edge there by the time flush() returns.
+	 */
+	int (*scan)(const uint8_t *tms, const uint8_t *tdi, uint8_t *tdo, unsigned num_bits);
+	int (*flush)(void);
 };
 
 int bitbang_execute_queue(void);
@@ -129,6 +129,13 @@ static uint16_t cmsis_dap_pid[MAX_USB_IDS + 1] = { 0xf001, 0xf002, 0x2722, 0x020
 #define CMD_DAP_TFER_BLOCK        0x06
 #define CMD_DAP_TFER_ABORT        0x07
 
+/* DAP_Transfer request bits */
+#define DAP_TFER_APnDP            (1 << 0)
+#define DAP_TFER_RnW              (1 << 1)
+
+/* DAP_Transfer response ACK */
+#define DAP_TFER_ACK_OK           0x01
+
 /* DAP Status Code */
 #define DAP_OK                    0
 #define DAP_ERROR                 0xFF
@@ -185,6 +192,7 @@ static int cmsis_dap_usb_open(void)
 	dap->dev_handle = dev;
 	dap->caps = 0;
 	dap->mode = 0;
+	dap->packet_count = 1;
 
 	cmsis_dap_handle = dap;
 
@@ -226,8 +234,8 @@ static void cmsis_dap_usb_close(struct cmsis_dap *dap)
 	return;
 }
 
-/* Send a message and receive the reply */
-static int cmsis_dap_usb_xfer(struct cmsis_dap *dap, int txlen)
+/* Send a message without waiting for the reply */
+static int cmsis_dap_usb_write(struct cmsis_dap *dap, int txlen)
 {
 	/* Pad the rest of the TX buffer with 0's */
 	memset(dap->packet_buffer + txlen, 0, dap->packet_size - 1 - txlen);
@@ -239,8 +247,13 @@ static int cmsis_dap_usb_xfer(struct cmsis_dap *dap, int txlen)
 		return ERROR_FAIL;
 	}
 
-	/* get reply */
-	retval = hid_read_timeout(dap->dev_handle, dap->packet_buffer, dap->packet_size, USB_TIMEOUT);
+	return ERROR_OK;
+}
+
+/* Receive the reply to the oldest outstanding message */
+static int cmsis_dap_usb_read(struct cmsis_dap *dap)
+{
+	int retval = hid_read_timeout(dap->dev_handle, dap->packet_buffer, dap->packet_size, USB_TIMEOUT);
 	if (retval == -1 || retval == 0) {
 		LOG_DEBUG("error reading data: %ls", hid_error(dap->dev_handle));
 		return ERROR_FAIL;
@@ -249,6 +262,17 @@ static int cmsis_dap_usb_xfer(struct cmsis_dap *dap, int txlen)
 	return ERROR_OK;
 }
 
+/* Send a message and receive the reply */
+static int cmsis_dap_usb_xfer(struct cmsis_dap *dap, int txlen)
+{
+	int retval = cmsis_dap_usb_write(dap, txlen);
+	if (retval != ERROR_OK)
+		return retval;
+
+	/* get reply */
+	return cmsis_dap_usb_read(dap);
+}
+
 static int cmsis_dap_cmd_DAP_SWJ_Pins(uint8_t pins, uint8_t mask, uint32_t wait, uint8_t *input)
 {
 	int retval;
@@ -438,101 +462,342 @@ static int cmsis_dap_cmd_DAP_Delay(uint16_t delay_us)
 }
 #endif
 
-static int cmsis_dap_swd_read_reg(uint8_t cmd, uint32_t *value)
+/*
+ * SWD transfers are queued and only sent to the adapter by
+ * cmsis_dap_swd_run().  The queue is packed into as few DAP_Transfer
+ * packets as fit, runs of accesses to the same AP register (as issued
+ * for auto-incrementing memory accesses) use DAP_TransferBlock, and up
+ * to packet_count packets are kept in flight so the USB round-trip is
+ * paid once per batch instead of once per register.
+ */
+struct pending_transfer {
+	uint8_t cmd;
+	uint32_t data;		/* value to write, or the value read */
+	uint32_t *value;	/* destination of a register read */
+	uint8_t *buffer;	/* destination of a block read, little endian */
+};
+
+struct pending_packet {
+	uint8_t cmd;		/* CMD_DAP_TFER or CMD_DAP_TFER_BLOCK */
+	int first;
+	int count;
+};
+
+/* queued transfers are executed early once this many are pending, their
+ * read results are kept until run() */
+#define MAX_PENDING_TRANSFERS     4096
+/* shortest run of same-register AP accesses sent as a TransferBlock */
+#define TFER_BLOCK_MIN            4
+#define MAX_PENDING_PACKETS       255
+
+static struct pending_transfer *pending_transfers;
+static int pending_transfer_count;
+/* transfers before this one were executed by an early flush */
+static int pending_transfer_done;
+static int pending_transfer_alloc;
+static int queued_retval = ERROR_OK;
+
+/* Number of transfers starting at first that repeat its command, at most max */
+static int cmsis_dap_swd_run_length(int first, int max)
+{
+	uint8_t cmd = pending_transfers[first].cmd;
+	int n = 1;
+
+	while (n < max && first + n < pending_transfer_count
+			&& pending_transfers[first + n].cmd == cmd)
+		n++;
+
+	return n;
+}
+
+/* Build the packet for the transfers starting at first and send it */
+static int cmsis_dap_swd_send_packet(int first, struct pending_packet *pkt)
 {
 	uint8_t *buffer = cmsis_dap_handle->packet_buffer;
-	int retval;
-	uint32_t val;
+	int room = cmsis_dap_handle->packet_size - 1;
+	struct pending_transfer *t = &pending_transfers[first];
+	bool read = t->cmd & DAP_TFER_RnW;
+	int txlen;
 
-	DEBUG_IO("CMSIS-DAP: Read  Reg 0x%02" PRIx8, cmd);
+	pkt->first = first;
 
-	buffer[0] = 0;	/* report number */
-	buffer[1] = CMD_DAP_TFER;
-	buffer[2] = 0x00;
-	buffer[3] = 0x01;
-	buffer[4] = cmd;
-	retval = cmsis_dap_usb_xfer(cmsis_dap_handle, 5);
+	if ((t->cmd & DAP_TFER_APnDP)
+			&& cmsis_dap_swd_run_length(first, TFER_BLOCK_MIN) == TFER_BLOCK_MIN) {
+		int count = cmsis_dap_swd_run_length(first, 0xffff);
+		count = MIN(count, (room - (read ? 4 : 5)) / 4);
 
-	/* TODO - need better response checking */
-	if (retval != ERROR_OK || buffer[1] != 0x01) {
-		LOG_ERROR("CMSIS-DAP: Read Error (0x%02" PRIx8 ")", buffer[2]);
-		return buffer[2];
-	}
+		buffer[0] = 0;	/* report number */
+		buffer[1] = CMD_DAP_TFER_BLOCK;
+		buffer[2] = 0x00;
+		h_u16_to_le(&buffer[3], count);
+		buffer[5] = t->cmd;
+		txlen = 6;
 
-	val = le_to_h_u32(&buffer[3]);
-	DEBUG_IO("0x%08" PRIx32, val);
+		if (!read) {
+			for (int i = 0; i < count; i++, txlen += 4)
+				h_u32_to_le(&buffer[txlen], t[i].data);
+		}
 
-	if (value)
-		*value = val;
+		pkt->cmd = CMD_DAP_TFER_BLOCK;
+		pkt->count = count;
+	} else {
+		/* request and response both start with three bytes */
+		int req = 3, resp = 3;
+		int count = 0;
 
-	return retval;
+		buffer[0] = 0;	/* report number */
+		buffer[1] = CMD_DAP_TFER;
+		buffer[2] = 0x00;
+		txlen = 4;
+
+		while (first + count < pending_transfer_count && count < 255) {
+			t = &pending_transfers[first + count];
+			read = t->cmd & DAP_TFER_RnW;
+
+			if (req + (read ? 1 : 5) > room || resp + (read ? 4 : 0) > room)
+				break;
+
+			/* leave block-sized runs to the next packet */
+			if (count && (t->cmd & DAP_TFER_APnDP)
+					&& cmsis_dap_swd_run_length(first + count, TFER_BLOCK_MIN) == TFER_BLOCK_MIN)
+				break;
+
+			buffer[txlen++] = t->cmd;
+			if (!read) {
+				h_u32_to_le(&buffer[txlen], t->data);
+				txlen += 4;
+			}
+
+			req += read ? 1 : 5;
+			resp += read ? 4 : 0;
+			count++;
+		}
+
+		buffer[3] = count;
+
+		pkt->cmd = CMD_DAP_TFER;
+		pkt->count = count;
+	}
+
+	return cmsis_dap_usb_write(cmsis_dap_handle, txlen);
 }
 
-static int cmsis_dap_swd_write_reg(uint8_t cmd, uint32_t value)
+/* Read the reply to pkt and keep the register values it carries with
+ * their transfers, see cmsis_dap_swd_commit() */
+static int cmsis_dap_swd_read_reply(struct pending_packet *pkt)
 {
 	uint8_t *buffer = cmsis_dap_handle->packet_buffer;
+	unsigned done;
+	uint8_t ack;
+	uint8_t *data;
 
-	DEBUG_IO("CMSIS-DAP: Write Reg 0x%02" PRIx8 " 0x%08" PRIx32, cmd, value);
+	int retval = cmsis_dap_usb_read(cmsis_dap_handle);
+	if (retval != ERROR_OK)
+		return ERROR_JTAG_DEVICE_ERROR;
 
-	buffer[0] = 0;	/* report number */
-	buffer[1] = CMD_DAP_TFER;
-	buffer[2] = 0x00;
-	buffer[3] = 0x01;
-	buffer[4] = cmd;
-	buffer[5] = (value) & 0xff;
-	buffer[6] = (value >> 8) & 0xff;
-	buffer[7] = (value >> 16) & 0xff;
-	buffer[8] = (value >> 24) & 0xff;
-	int retval = cmsis_dap_usb_xfer(cmsis_dap_handle, 9);
-
-	if (buffer[1] != 0x01) {
-		LOG_ERROR("CMSIS-DAP: Write Error (0x%02" PRIx8 ")", buffer[2]);
-		retval = buffer[2];
+	if (buffer[0] != pkt->cmd) {
+		LOG_ERROR("CMSIS-DAP: unexpected reply 0x%02" PRIx8, buffer[0]);
+		return ERROR_JTAG_DEVICE_ERROR;
 	}
 
-	return retval;
+	if (pkt->cmd == CMD_DAP_TFER) {
+		done = buffer[1];
+		ack = buffer[2];
+		data = &buffer[3];
+	} else {
+		done = le_to_h_u16(&buffer[1]);
+		ack = buffer[3];
+		data = &buffer[4];
+	}
+
+	if (ack != DAP_TFER_ACK_OK || done != (unsigned)pkt->count) {
+		LOG_ERROR("CMSIS-DAP: Transfer Error (0x%02" PRIx8 ") after %u of %d",
+				ack, done, pkt->count);
+		return ack != DAP_TFER_ACK_OK ? ack : ERROR_JTAG_DEVICE_ERROR;
+	}
+
+	for (int i = 0; i < pkt->count; i++) {
+		struct pending_transfer *t = &pending_transfers[pkt->first + i];
+
+		if (!(t->cmd & DAP_TFER_RnW))
+			continue;
+
+		t->data = le_to_h_u32(data);
+		data += 4;
+	}
+
+	return ERROR_OK;
 }
 
-static int cmsis_dap_swd_read_block(uint8_t cmd, uint32_t blocksize, uint8_t *dest_buf)
+/* Execute all pending transfers, keeping up to packet_count packets in flight */
+static int cmsis_dap_swd_flush(void)
 {
-	uint8_t *buffer;
-	int tfer_sz;
+	struct pending_packet inflight[MAX_PENDING_PACKETS];
+	int max_inflight = MIN(MAX(cmsis_dap_handle->packet_count, 1), MAX_PENDING_PACKETS);
+	int head = 0, tail = 0, busy = 0;
+	int next = pending_transfer_done;
 	int retval = ERROR_OK;
-	uint16_t read_count;
 
-	DEBUG_IO("CMSIS-DAP: Read Block 0x%02" PRIx8 " %" PRIu32, cmd, blocksize);
+	DEBUG_IO("CMSIS-DAP: %d queued transfers", pending_transfer_count - next);
 
-	while (blocksize) {
+	while (busy || (next < pending_transfer_count && retval == ERROR_OK)) {
+		if (next < pending_transfer_count && retval == ERROR_OK && busy < max_inflight) {
+			retval = cmsis_dap_swd_send_packet(next, &inflight[head]);
+			if (retval != ERROR_OK) {
+				retval = ERROR_JTAG_DEVICE_ERROR;
+				continue;
+			}
+			next += inflight[head].count;
+			head = (head + 1) % max_inflight;
+			busy++;
+			continue;
+		}
 
-		buffer = cmsis_dap_handle->packet_buffer;
-		tfer_sz = blocksize;
-		if (tfer_sz > 15)
-			tfer_sz = 8;
+		/* replies to packets sent after a failure are read and dropped */
+		int reply = cmsis_dap_swd_read_reply(&inflight[tail]);
+		if (retval == ERROR_OK)
+			retval = reply;
+		tail = (tail + 1) % max_inflight;
+		busy--;
+	}
 
-		buffer[0] = 0;	/* report number */
-		buffer[1] = CMD_DAP_TFER_BLOCK;
-		buffer[2] = 0x00;
-		buffer[3] = tfer_sz;
-		buffer[4] = 0x00;
-		buffer[5] = cmd;
-		retval = cmsis_dap_usb_xfer(cmsis_dap_handle, 6);
+	pending_transfer_done = pending_transfer_count;
 
-		read_count = le_to_h_u16(&buffer[1]);
-		if (read_count != tfer_sz) {
-			LOG_ERROR("CMSIS-DAP: Block Read Error (0x%02" PRIx8 ")", buffer[3]);
-			retval = buffer[3];
-		}
+	return retval;
+}
 
-		read_count *= 4;
-		memcpy(dest_buf, &buffer[4], read_count);
+/* Store the values read since the last run() at their destinations */
+static void cmsis_dap_swd_commit(void)
+{
+	for (int i = 0; i < pending_transfer_count; i++) {
+		struct pending_transfer *t = &pending_transfers[i];
 
-		dest_buf += read_count;
-		blocksize -= tfer_sz;
+		if (t->buffer)
+			h_u32_to_le(t->buffer, t->data);
+		else if (t->value)
+			*t->value = t->data;
 	}
+}
+
+/* Read results only reach the callers when every transfer queued since
+ * the last run() succeeded, as promised by struct swd_driver. Once a
+ * transfer failed the ones queued after it are dropped. */
+static int cmsis_dap_swd_run(void)
+{
+	int retval = queued_retval;
+
+	if (retval == ERROR_OK)
+		retval = cmsis_dap_swd_flush();
+	if (retval == ERROR_OK)
+		cmsis_dap_swd_commit();
+
+	pending_transfer_count = 0;
+	pending_transfer_done = 0;
+	queued_retval = ERROR_OK;
 
 	return retval;
 }
 
+static struct pending_transfer *cmsis_dap_swd_queue_transfer(uint8_t cmd)
+{
+	if (pending_transfer_count - pending_transfer_done == MAX_PENDING_TRANSFERS) {
+		if (queued_retval == ERROR_OK)
+			queued_retval = cmsis_dap_swd_flush();
+		else
+			pending_transfer_done = pending_transfer_count;
+	}
+
+	if (pending_transfer_count == pending_transfer_alloc) {
+		int alloc = pending_transfer_alloc ? 2 * pending_transfer_alloc : 64;
+		struct pending_transfer *p = realloc(pending_transfers, alloc * sizeof(*p));
+		if (p == NULL) {
+			LOG_ERROR("unable to allocate memory");
+			queued_retval = ERROR_FAIL;
+			return NULL;
+		}
+		pending_transfers = p;
+		pending_transfer_alloc = alloc;
+	}
+
+	struct pending_transfer *t = &pending_transfers[pending_transfer_count++];
+	t->cmd = cmd;
+	t->data = 0;
+	t->value = NULL;
+	t->buffer = NULL;
+
+	return t;
+}
+
+static int cmsis_dap_swd_queue_read_reg(uint8_t cmd, uint32_t *value)
+{
+	DEBUG_IO("CMSIS-DAP: Queue Read  Reg 0x%02" PRIx8, cmd);
+
+	struct pending_transfer *t = cmsis_dap_swd_queue_transfer(cmd);
+	if (t == NULL)
+		return ERROR_FAIL;
+
+	t->value = value;
+
+	return ERROR_OK;
+}
+
+static int cmsis_dap_swd_queue_write_reg(uint8_t cmd, uint32_t value)
+{
+	DEBUG_IO("CMSIS-DAP: Queue Write Reg 0x%02" PRIx8 " 0x%08" PRIx32, cmd, value);
+
+	struct pending_transfer *t = cmsis_dap_swd_queue_transfer(cmd);
+	if (t == NULL)
+		return ERROR_FAIL;
+
+	t->data = value;
+
+	return ERROR_OK;
+}
+
+static int cmsis_dap_swd_queue_read_block(uint8_t cmd, uint32_t blocksize, uint8_t *dest_buf)
+{
+	DEBUG_IO("CMSIS-DAP: Queue Read Block 0x%02" PRIx8 " %" PRIu32, cmd, blocksize);
+
+	for (uint32_t i = 0; i < blocksize; i++) {
+		struct pending_transfer *t = cmsis_dap_swd_queue_transfer(cmd);
+		if (t == NULL)
+			return ERROR_FAIL;
+
+		t->buffer = dest_buf + 4 * i;
+	}
+
+	return ERROR_OK;
+}
+
+/* The synchronous accessors run everything queued before them, in order */
+
+static int cmsis_dap_swd_read_reg(uint8_t cmd, uint32_t *value)
+{
+	int retval = cmsis_dap_swd_queue_read_reg(cmd, value);
+	if (retval != ERROR_OK)
+		return retval;
+
+	return cmsis_dap_swd_run();
+}
+
+static int cmsis_dap_swd_write_reg(uint8_t cmd, uint32_t value)
+{
+	int retval = cmsis_dap_swd_queue_write_reg(cmd, value);
+	if (retval != ERROR_OK)
+		return retval;
+
+	return cmsis_dap_swd_run();
+}
+
+static int cmsis_dap_swd_read_block(uint8_t cmd, uint32_t blocksize, uint8_t *dest_buf)
+{
+	int retval = cmsis_dap_swd_queue_read_block(cmd, blocksize, dest_buf);
+	if (retval != ERROR_OK)
+		return retval;
+
+	return cmsis_dap_swd_run();
+}
+
 static int cmsis_dap_get_version_info(void)
 {
 	uint8_t *data;
@@ -851,6 +1116,12 @@ static int cmsis_dap_quit(void)
 
 	cmsis_dap_usb_close(cmsis_dap_handle);
 
+	free(pending_transfers);
+	pending_transfers = NULL;
+	pending_transfer_count = 0;
+	pending_transfer_done = 0;
+	pending_transfer_alloc = 0;
+
 	return ERROR_OK;
 }
 
@@ -1071,7 +1342,11 @@ static const struct swd_driver cmsis_dap_swd_driver = {
 	.init       = cmsis_dap_swd_init,
 	.read_reg   = cmsis_dap_swd_read_reg,
 	.write_reg  = cmsis_dap_swd_write_reg,
-	.read_block = cmsis_dap_swd_read_block
+	.read_block = cmsis_dap_swd_read_block,
+	.queue_read_reg   = cmsis_dap_swd_queue_read_reg,
+	.queue_write_reg  = cmsis_dap_swd_queue_write_reg,
+	.queue_read_block = cmsis_dap_swd_queue_read_block,
+	.run        = cmsis_dap_swd_run,
 };
 
 const char *cmsis_dap_transport[] = {"cmsis-dap", NULL};
@@ -0,0 +1,750 @@
+/***************************************************************************
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.           *
+ ***************************************************************************/
+
+/*
+ * In-process simulation of a JTAG scan chain, for exercising and timing
+ * the JTAG layer, SVF player and ADIv5 code without any hardware.
+ *
+ * Each simulated TAP has an IR, an optional IDCODE register, BYPASS, and
+ * a data register model that supplies any other DR.  The chain is clocked
+ * bit by bit through the bitbang vector callbacks, and the number of TCK
+ * cycles is reported next to the host CPU time used.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <time.h>
+
+#include <jtag/interface.h>
+#include <target/arm_adi_v5.h>
+#include "bitbang.h"
+
+/* JTAG-DP instructions and acknowledge, private to adi_v5_jtag.c */
+#define JTAG_DP_ABORT		0x8
+#define JTAG_DP_IDCODE		0xE
+#define JTAG_ACK_OK_FAULT	0x2
+
+#define CSW_SIZE_MASK		7
+
+/* AHB-AP revision 2, as found on Cortex-M3 */
+#define SIM_AHB_AP_IDR		0x24770011
+
+struct jtag_sim_tap;
+
+/**
+ * A data register model.  The core of the simulator implements the IR,
+ * BYPASS and IDCODE; a model provides the other data registers of a TAP.
+ */
+struct jtag_sim_model {
+	const char *name;
+
+	/** Instruction selecting the IDCODE register, loaded on reset */
+	uint32_t idcode_instr;
+
+	int (*init)(struct jtag_sim_tap *tap);
+	void (*quit)(struct jtag_sim_tap *tap);
+
+	/**
+	 * Capture-DR for the current instruction.  Stores the captured value
+	 * and returns the DR length (1..64), or 0 if the instruction does not
+	 * select one of the model's registers.
+	 */
+	unsigned (*capture)(struct jtag_sim_tap *tap, uint64_t *dr);
+
+	/** Update-DR of a register previously captured by the model */
+	void (*update)(struct jtag_sim_tap *tap, uint64_t dr);
+};
+
+struct jtag_sim_tap {
+	unsigned ir_length;
+	uint32_t idcode;	/* 0 if the TAP has no IDCODE register */
+	const struct jtag_sim_model *model;
+	void *priv;
+
+	uint32_t ir;
+	uint64_t shift;		/* IR or DR being shifted, bit 0 is on TDO */
+	unsigned shift_length;
+	bool model_dr;		/* the DR being shifted belongs to the model */
+};
+
+/* The chain, first TAP nearest to TDO as with "jtag newtap" */
+static struct jtag_sim_tap *sim_taps;
+static unsigned sim_tap_count;
+
+static tap_state_t sim_state = TAP_RESET;
+static int sim_tck;
+static int sim_khz;
+
+static uint32_t sim_ram_base = 0x20000000;
+static uint32_t sim_ram_size = 64 * 1024;
+
+/* Statistics, see jtag_sim_stats */
+static uint64_t sim_tck_count;
+static uint64_t sim_scan_count;
+static uint64_t sim_queue_count;
+static clock_t sim_start_clock;
+
+static uint32_t jtag_sim_ir_mask(const struct jtag_sim_tap *tap)
+{
+	return (uint32_t)((1ull << tap->ir_length) - 1);
+}
+
+/*
+ * The ADIv5 JTAG-DP model: DPACC, APACC and ABORT, with a single MEM-AP
+ * at APSEL 0 whose bus only contains a RAM of sim_ram_size bytes at
+ * sim_ram_base.  Accesses complete at once, so WAIT is never returned.
+ */
+struct jtag_sim_adiv5 {
+	uint32_t ctrl_stat;
+	uint32_t select;
+	uint32_t csw;
+	uint32_t tar;
+	uint32_t read_data;	/* posted result, captured by the next access */
+	uint8_t *ram;
+};
+
+static int jtag_sim_adiv5_init(struct jtag_sim_tap *tap)
+{
+	struct jtag_sim_adiv5 *dp = calloc(1, sizeof(*dp));
+	if (dp == NULL) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	dp->ram = calloc(1, sim_ram_size);
+	if (dp->ram == NULL) {
+		LOG_ERROR("Out of memory");
+		free(dp);
+		return ERROR_FAIL;
+	}
+
+	tap->priv = dp;
+	return ERROR_OK;
+}
+
+static void jtag_sim_adiv5_quit(struct jtag_sim_tap *tap)
+{
+	struct jtag_sim_adiv5 *dp = tap->priv;
+
+	if (dp)
+		free(dp->ram);
+	free(dp);
+	tap->priv = NULL;
+}
+
+static uint8_t *jtag_sim_adiv5_ram(struct jtag_sim_adiv5 *dp, uint32_t address)
+{
+	if (address - sim_ram_base >= sim_ram_size)
+		return NULL;
+	return dp->ram + (address - sim_ram_base);
+}
+
+/* Bus access of the size given by CSW; data is on the byte lanes of the address */
+static void jtag_sim_adiv5_mem(struct jtag_sim_adiv5 *dp, uint32_t address, bool read,
+		uint32_t *data)
+{
+	unsigned size = dp->csw & CSW_SIZE_MASK;
+	unsigned bytes = size == CSW_8BIT ? 1 : size == CSW_16BIT ? 2 : 4;
+
+	address &= ~(bytes - 1);
+	if (read)
+		*data = 0;
+
+	for (unsigned i = 0; i < bytes; i++) {
+		uint8_t *p = jtag_sim_adiv5_ram(dp, address + i);
+		unsigned lane = 8 * ((address + i) & 3);
+
+		if (p == NULL) {
+			dp->ctrl_stat |= SSTICKYERR;
+			if (read)
+				*data = 0;
+			return;
+		}
+
+		if (read)
+			*data |= (uint32_t)*p << lane;
+		else
+			*p = *data >> lane;
+	}
+
+	if ((dp->csw & CSW_ADDRINC_MASK) == CSW_ADDRINC_SINGLE) {
+		/* TAR only auto-increments within a 1 KiB block */
+		dp->tar = (dp->tar & ~0x3ff) | ((dp->tar + bytes) & 0x3ff);
+	}
+}
+
+static void jtag_sim_adiv5_ap(struct jtag_sim_adiv5 *dp, unsigned reg, bool read,
+		uint32_t data)
+{
+	uint32_t value = 0;
+
+	/* APACC accesses are discarded while a sticky error is set */
+	if ((dp->select >> 24) != 0 || (dp->ctrl_stat & SSTICKYERR)) {
+		if (read)
+			dp->read_data = 0;
+		return;
+	}
+
+	switch (reg) {
+	case AP_REG_CSW:
+		if (read) {
+			value = dp->csw | CSW_DEVICE_EN;
+		} else {
+			/* packed transfers are not implemented */
+			if ((data & CSW_ADDRINC_MASK) == CSW_ADDRINC_PACKED)
+				data &= ~CSW_ADDRINC_MASK;
+			dp->csw = data & ~(CSW_DEVICE_EN | CSW_TRIN_PROG);
+		}
+		break;
+	case AP_REG_TAR:
+		if (read)
+			value = dp->tar;
+		else
+			dp->tar = data;
+		break;
+	case AP_REG_DRW:
+		if (read)
+			jtag_sim_adiv5_mem(dp, dp->tar, true, &value);
+		else
+			jtag_sim_adiv5_mem(dp, dp->tar, false, &data);
+		break;
+	case AP_REG_BD0:
+	case AP_REG_BD1:
+	case AP_REG_BD2:
+	case AP_REG_BD3: {
+		/* banked accesses are words and leave TAR alone */
+		uint32_t csw = dp->csw, tar = dp->tar;
+		dp->csw = CSW_32BIT;
+		if (read)
+			jtag_sim_adiv5_mem(dp, (tar & ~0xf) | (reg & 0xc), true, &value);
+		else
+			jtag_sim_adiv5_mem(dp, (tar & ~0xf) | (reg & 0xc), false, &data);
+		dp->csw = csw;
+		dp->tar = tar;
+		break;
+	}
+	case AP_REG_BASE:
+		/* legacy format, no debug entries */
+		value = 0xffffffff;
+		break;
+	case AP_REG_IDR:
+		value = SIM_AHB_AP_IDR;
+		break;
+	default:
+		break;
+	}
+
+	if (read)
+		dp->read_data = value;
+}
+
+static void jtag_sim_adiv5_dp(struct jtag_sim_adiv5 *dp, unsigned reg, bool read,
+		uint32_t data)
+{
+	const uint32_t sticky = SSTICKYORUN | SSTICKYCMP | SSTICKYERR;
+	uint32_t value = 0;
+
+	switch (reg) {
+	case DP_CTRL_STAT:
+		if (read) {
+			value = dp->ctrl_stat;
+		} else {
+			/* sticky flags are cleared by writing 1, power up is acknowledged at once */
+			dp->ctrl_stat = (dp->ctrl_stat & sticky & ~data)
+				| (data & ~(sticky | CDBGPWRUPACK | CSYSPWRUPACK));
+			if (dp->ctrl_stat & CDBGPWRUPREQ)
+				dp->ctrl_stat |= CDBGPWRUPACK;
+			if (dp->ctrl_stat & CSYSPWRUPREQ)
+				dp->ctrl_stat |= CSYSPWRUPACK;
+		}
+		break;
+	case DP_SELECT:
+		if (read)
+			value = dp->select;
+		else
+			dp->select = data;
+		break;
+	default:
+		/* RDBUFF reads as zero on a JTAG-DP */
+		break;
+	}
+
+	if (read)
+		dp->read_data = value;
+}
+
+static unsigned jtag_sim_adiv5_capture(struct jtag_sim_tap *tap, uint64_t *dr)
+{
+	struct jtag_sim_adiv5 *dp = tap->priv;
+
+	switch (tap->ir) {
+	case JTAG_DP_ABORT:
+	case JTAG_DP_DPACC:
+	case JTAG_DP_APACC:
+		*dr = ((uint64_t)dp->read_data << 3) | JTAG_ACK_OK_FAULT;
+		return 35;
+	default:
+		return 0;
+	}
+}
+
+static void jtag_sim_adiv5_update(struct jtag_sim_tap *tap, uint64_t dr)
+{
+	struct jtag_sim_adiv5 *dp = tap->priv;
+	bool read = dr & 1;
+	unsigned reg = ((dr >> 1) & 3) << 2;
+	uint32_t data = dr >> 3;
+
+	switch (tap->ir) {
+	case JTAG_DP_ABORT:
+		/* transactions complete at once, so DAPABORT has nothing to
+		 * cancel; the other bits are SWD-only and JTAG clears sticky
+		 * flags by writing them to CTRL/STAT */
+		break;
+	case JTAG_DP_DPACC:
+		jtag_sim_adiv5_dp(dp, reg, read, data);
+		break;
+	case JTAG_DP_APACC:
+		jtag_sim_adiv5_ap(dp, (dp->select & 0xf0) | reg, read, data);
+		break;
+	}
+}
+
+static const struct jtag_sim_model jtag_sim_models[] = {
+	{
+		/* IDCODE and BYPASS only */
+		.name = "bypass",
+		.idcode_instr = 0x1,
+	},
+	{
+		.name = "adiv5",
+		.idcode_instr = JTAG_DP_IDCODE,
+		.init = jtag_sim_adiv5_init,
+		.quit = jtag_sim_adiv5_quit,
+		.capture = jtag_sim_adiv5_capture,
+		.update = jtag_sim_adiv5_update,
+	},
+};
+
+static const struct jtag_sim_model *jtag_sim_find_model(const char *name)
+{
+	for (unsigned i = 0; i < ARRAY_SIZE(jtag_sim_models); i++) {
+		if (strcmp(jtag_sim_models[i].name, name) == 0)
+			return &jtag_sim_models[i];
+	}
+	return NULL;
+}
+
+static int jtag_sim_add_tap(unsigned ir_length, uint32_t idcode,
+		const struct jtag_sim_model *model)
+{
+	/* the all-ones instruction is BYPASS, so IDCODE can't be selected
+	 * if its instruction is all ones too */
+	if (idcode && model->idcode_instr == (uint32_t)((1ull << ir_length) - 1)) {
+		LOG_ERROR("jtag_sim: IR length %u is too short for an IDCODE register", ir_length);
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+
+	struct jtag_sim_tap *taps = realloc(sim_taps, (sim_tap_count + 1) * sizeof(*taps));
+	if (taps == NULL) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	sim_taps = taps;
+
+	struct jtag_sim_tap *tap = &sim_taps[sim_tap_count++];
+	memset(tap, 0, sizeof(*tap));
+	tap->ir_length = ir_length;
+	tap->idcode = idcode;
+	tap->model = model;
+
+	return ERROR_OK;
+}
+
+/* Test-Logic-Reset: select IDCODE, or BYPASS if there is none */
+static void jtag_sim_reset_taps(void)
+{
+	for (unsigned i = 0; i < sim_tap_count; i++) {
+		struct jtag_sim_tap *tap = &sim_taps[i];
+		tap->ir = tap->idcode ? tap->model->idcode_instr : jtag_sim_ir_mask(tap);
+	}
+}
+
+static void jtag_sim_capture_dr(struct jtag_sim_tap *tap)
+{
+	unsigned length = 0;
+
+	if (tap->ir != jtag_sim_ir_mask(tap) && tap->model->capture)
+		length = tap->model->capture(tap, &tap->shift);
+
+	tap->model_dr = length != 0;
+	if (length) {
+		tap->shift_length = length;
+	} else if (tap->idcode && tap->ir == tap->model->idcode_instr) {
+		tap->shift = tap->idcode;
+		tap->shift_length = 32;
+	} else {
+		tap->shift = 0;
+		tap->shift_length = 1;
+	}
+}
+
+/* One TCK cycle of the whole chain, returns TDO as sampled before the rising edge */
+static int jtag_sim_clock(int tms, int tdi)
+{
+	tap_state_t old_state = sim_state;
+	int tdo = 0;
+
+	sim_tck_count++;
+
+	switch (sim_state) {
+	case TAP_IRCAPTURE:
+		/* IEEE 1149.1: the two least significant bits capture 01 */
+		for (unsigned i = 0; i < sim_tap_count; i++) {
+			sim_taps[i].shift = 1;
+			sim_taps[i].shift_length = sim_taps[i].ir_length;
+			sim_taps[i].model_dr = false;
+		}
+		break;
+	case TAP_DRCAPTURE:
+		for (unsigned i = 0; i < sim_tap_count; i++)
+			jtag_sim_capture_dr(&sim_taps[i]);
+		break;
+	case TAP_IRSHIFT:
+	case TAP_DRSHIFT:
+		if (sim_tap_count == 0) {
+			tdo = tdi;
+			break;
+		}
+		tdo = sim_taps[0].shift & 1;
+		for (unsigned i = 0; i < sim_tap_count; i++) {
+			struct jtag_sim_tap *tap = &sim_taps[i];
+			uint64_t in = (i + 1 < sim_tap_count) ? (sim_taps[i + 1].shift & 1) : (tdi != 0);
+			tap->shift = (tap->shift >> 1) | (in << (tap->shift_length - 1));
+		}
+		break;
+	default:
+		break;
+	}
+
+	sim_state = tap_state_transition(sim_state, tms);
+
+	switch (sim_state) {
+	case TAP_IRUPDATE:
+		for (unsigned i = 0; i < sim_tap_count; i++)
+			sim_taps[i].ir = sim_taps[i].shift & jtag_sim_ir_mask(&sim_taps[i]);
+		break;
+	case TAP_DRUPDATE:
+		for (unsigned i = 0; i < sim_tap_count; i++) {
+			struct jtag_sim_tap *tap = &sim_taps[i];
+			if (tap->model_dr)
+				tap->model->update(tap, tap->shift);
+		}
+		break;
+	case TAP_RESET:
+		if (old_state != TAP_RESET)
+			jtag_sim_reset_taps();
+		break;
+	default:
+		break;
+	}
+
+	return tdo;
+}
+
+static int jtag_sim_read(void)
+{
+	if ((sim_state == TAP_IRSHIFT || sim_state == TAP_DRSHIFT) && sim_tap_count)
+		return sim_taps[0].shift & 1;
+	return 0;
+}
+
+static void jtag_sim_write(int tck, int tms, int tdi)
+{
+	/* state transitions occur on the rising edge of TCK */
+	if (tck && !sim_tck)
+		jtag_sim_clock(tms, tdi);
+	sim_tck = tck;
+}
+
+static int jtag_sim_scan(const uint8_t *tms, const uint8_t *tdi, uint8_t *tdo, unsigned num_bits)
+{
+	/* tdi and tdo may be the same buffer */
+	for (unsigned i = 0; i < num_bits; i++) {
+		uint8_t mask = 1 << (i % 8);
+		int bit = jtag_sim_clock(tms[i / 8] & mask, tdi ? tdi[i / 8] & mask : 0);
+
+		if (tdo) {
+			if (bit)
+				tdo[i / 8] |= mask;
+			else
+				tdo[i / 8] &= ~mask;
+		}
+	}
+	sim_tck = 0;
+	sim_scan_count++;
+
+	return ERROR_OK;
+}
+
+static int jtag_sim_flush(void)
+{
+	/* TDO is stored as soon as it is scanned */
+	return ERROR_OK;
+}
+
+static void jtag_sim_reset(int trst, int srst)
+{
+	sim_tck = 0;
+
+	if (trst || (srst && (jtag_get_reset_config() & RESET_SRST_PULLS_TRST))) {
+		sim_state = TAP_RESET;
+		jtag_sim_reset_taps();
+	}
+}
+
+static struct bitbang_interface jtag_sim_bitbang = {
+	.read = &jtag_sim_read,
+	.write = &jtag_sim_write,
+	.reset = &jtag_sim_reset,
+	.scan = &jtag_sim_scan,
+	.flush = &jtag_sim_flush,
+};
+
+static int jtag_sim_execute_queue(void)
+{
+	sim_queue_count++;
+	return bitbang_execute_queue();
+}
+
+static void jtag_sim_stats_reset(void)
+{
+	sim_tck_count = 0;
+	sim_scan_count = 0;
+	sim_queue_count = 0;
+	sim_start_clock = clock();
+}
+
+static void jtag_sim_stats_print(struct command_context *cmd_ctx)
+{
+	double cpu = (double)(clock() - sim_start_clock) / CLOCKS_PER_SEC;
+
+	if (cmd_ctx == NULL) {
+		LOG_INFO("jtag_sim: %" PRIu64 " TCK cycles, %" PRIu64 " scans, %" PRIu64
+				" queues in %.3f s host CPU time",
+				sim_tck_count, sim_scan_count, sim_queue_count, cpu);
+		return;
+	}
+
+	command_print(cmd_ctx, "%" PRIu64 " TCK cycles, %" PRIu64 " scans, %" PRIu64
+			" queues in %.3f s host CPU time",
+			sim_tck_count, sim_scan_count, sim_queue_count, cpu);
+	if (sim_khz)
+		command_print(cmd_ctx, "%.3f s of TCK at %d kHz",
+				sim_tck_count / (sim_khz * 1000.0), sim_khz);
+	if (cpu > 0)
+		command_print(cmd_ctx, "%.0f TCK cycles per host CPU second",
+				sim_tck_count / cpu);
+}
+
+static int jtag_sim_khz(int khz, int *jtag_speed)
+{
+	*jtag_speed = khz;
+	return ERROR_OK;
+}
+
+static int jtag_sim_speed_div(int speed, int *khz)
+{
+	*khz = speed;
+	return ERROR_OK;
+}
+
+static int jtag_sim_speed(int speed)
+{
+	/* only used to convert the TCK count into time */
+	sim_khz = speed;
+	return ERROR_OK;
+}
+
+static int jtag_sim_init(void)
+{
+	int retval;
+
+	/* without an explicit chain, simulate the declared one */
+	if (sim_tap_count == 0) {
+		for (struct jtag_tap *tap = jtag_all_taps(); tap; tap = tap->next_tap) {
+			uint32_t idcode = tap->expected_ids_cnt ? tap->expected_ids[0] : 0;
+			const struct jtag_sim_model *model = jtag_sim_find_model("bypass");
+
+			if (tap->ir_length < 1 || tap->ir_length > 32) {
+				LOG_ERROR("jtag_sim: IR length of %s must be 1..32", tap->dotted_name);
+				return ERROR_FAIL;
+			}
+
+			/* ARM JTAG-DP, any version */
+			if (tap->ir_length == 4 && (idcode & 0x0fff0fff) == 0x0ba00477)
+				model = jtag_sim_find_model("adiv5");
+
+			retval = jtag_sim_add_tap(tap->ir_length, idcode, model);
+			if (retval != ERROR_OK)
+				return retval;
+		}
+	}
+
+	for (unsigned i = 0; i < sim_tap_count; i++) {
+		struct jtag_sim_tap *tap = &sim_taps[i];
+
+		if (tap->model->init) {
+			retval = tap->model->init(tap);
+			if (retval != ERROR_OK)
+				return retval;
+		}
+		LOG_INFO("jtag_sim: TAP %u: IR length %u, IDCODE 0x%08" PRIx32 ", %s",
+				i, tap->ir_length, tap->idcode, tap->model->name);
+	}
+
+	sim_state = TAP_RESET;
+	jtag_sim_reset_taps();
+	jtag_sim_stats_reset();
+
+	bitbang_interface = &jtag_sim_bitbang;
+
+	return ERROR_OK;
+}
+
+static int jtag_sim_quit(void)
+{
+	jtag_sim_stats_print(NULL);
+
+	for (unsigned i = 0; i < sim_tap_count; i++) {
+		if (sim_taps[i].model->quit)
+			sim_taps[i].model->quit(&sim_taps[i]);
+	}
+	free(sim_taps);
+	sim_taps = NULL;
+	sim_tap_count = 0;
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(jtag_sim_handle_tap_command)
+{
+	unsigned ir_length;
+	uint32_t idcode = 0;
+	const struct jtag_sim_model *model = jtag_sim_find_model("bypass");
+
+	if (CMD_ARGC < 1 || CMD_ARGC > 3)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], ir_length);
+	if (ir_length < 1 || ir_length > 32) {
+		LOG_ERROR("IR length must be 1..32");
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+
+	if (CMD_ARGC > 1)
+		COMMAND_PARSE_NUMBER(u32, CMD_ARGV[1], idcode);
+
+	if (CMD_ARGC > 2) {
+		model = jtag_sim_find_model(CMD_ARGV[2]);
+		if (model == NULL) {
+			LOG_ERROR("unknown TAP model '%s'", CMD_ARGV[2]);
+			return ERROR_COMMAND_ARGUMENT_INVALID;
+		}
+	}
+
+	if (model->idcode_instr > ((1ull << ir_length) - 1)) {
+		LOG_ERROR("the %s model needs a longer IR", model->name);
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+
+	return jtag_sim_add_tap(ir_length, idcode, model);
+}
+
+COMMAND_HANDLER(jtag_sim_handle_ram_command)
+{
+	if (CMD_ARGC != 2)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	COMMAND_PARSE_NUMBER(u32, CMD_ARGV[0], sim_ram_base);
+	COMMAND_PARSE_NUMBER(u32, CMD_ARGV[1], sim_ram_size);
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(jtag_sim_handle_stats_command)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		if (strcmp(CMD_ARGV[0], "reset") != 0)
+			return ERROR_COMMAND_SYNTAX_ERROR;
+		jtag_sim_stats_reset();
+		return ERROR_OK;
+	}
+
+	jtag_sim_stats_print(CMD_CTX);
+
+	return ERROR_OK;
+}
+
+static const struct command_registration jtag_sim_command_handlers[] = {
+	{
+		.name = "jtag_sim_tap",
+		.handler = &jtag_sim_handle_tap_command,
+		.mode = COMMAND_CONFIG,
+		.help = "append a TAP to the simulated chain, "
+			"the first one being nearest to TDO",
+		.usage = "ir_length [idcode [bypass|adiv5]]",
+	},
+	{
+		.name = "jtag_sim_ram",
+		.handler = &jtag_sim_handle_ram_command,
+		.mode = COMMAND_CONFIG,
+		.help = "set the RAM behind the MEM-AP of adiv5 TAPs",
+		.usage = "base size",
+	},
+	{
+		.name = "jtag_sim_stats",
+		.handler = &jtag_sim_handle_stats_command,
+		.mode = COMMAND_EXEC,
+		.help = "show the simulated TCK count and host CPU time, "
+			"or start counting again",
+		.usage = "['reset']",
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
+struct jtag_interface jtag_sim_interface = {
+	.name = "jtag_sim",
+
+	.supported = DEBUG_CAP_TMS_SEQ,
+	.commands = jtag_sim_command_handlers,
+	.transports = jtag_only,
+
+	.execute_queue = &jtag_sim_execute_queue,
+
+	.speed = &jtag_sim_speed,
+	.khz = &jtag_sim_khz,
+	.speed_div = &jtag_sim_speed_div,
+
+	.init = &jtag_sim_init,
+	.quit = &jtag_sim_quit,
+};
@@ -26,6 +26,9 @@
 #ifdef HAVE_ARPA_INET_H
 #include <arpa/inet.h>
 #endif
+#ifndef _WIN32
+#include <netinet/tcp.h>
+#endif
 
 #define NO_TAP_SHIFT	0
 #define TAP_SHIFT	1
@@ -34,6 +37,7 @@
 #define SERVER_PORT	5555
 
 #define	XFERT_MAX_SIZE		512
+#define	XFERT_V2_MAX_SIZE	16384
 
 #define CMD_RESET		0
 #define CMD_TMS_SEQ		1
@@ -41,8 +45,31 @@
 #define CMD_SCAN_CHAIN_FLIP_TMS	3
 #define CMD_STOP_SIMU		4
 
+/*
+ * Protocol version 2 replaces the fixed size struct vpi_cmd with a
+ * little endian header followed by DIV_ROUND_UP(nb_bits, 8) payload bytes:
+ *
+ *   u8 cmd, u8 flags, u16 reserved (0), u32 nb_bits
+ *
+ * The server only replies to scans with VPI_FLAG_CAPTURE set, and the
+ * reply is the raw TDO payload.  Version 1 servers reply to every scan
+ * with a full struct vpi_cmd.
+ */
+#define VPI_V2_HEADER_SIZE	8
+#define VPI_FLAG_CAPTURE	0x01
+
+/* Commands are collected in a send buffer and written in one go */
+#define SEND_BUFFER_SIZE	(64 * 1024)
+
+/*
+ * Replies are read back once this many bytes are outstanding, so the
+ * server never blocks writing replies while we block writing commands.
+ */
+#define MAX_PENDING_REPLY_BYTES	(32 * 1024)
+
 int server_port = SERVER_PORT;
 char *server_address;
+static int protocol_version = 1;
 
 int sockfd;
 struct sockaddr_in serv_addr;
@@ -55,21 +82,229 @@ struct vpi_cmd {
 	int nb_bits;
 };
 
+/* A reply the server still owes us, in the order commands were sent */
+struct pending_reply {
+	uint8_t *dst;		/* where the TDO bits go, NULL to discard */
+	int nb_bytes;
+};
+
+/* A scan whose captured bits are handed to jtag_read_buffer() on flush */
+struct pending_scan {
+	struct scan_command *cmd;
+	uint8_t *buf;
+};
+
+static uint8_t *send_buffer;
+static unsigned send_len;
+
+static struct pending_reply *pending_replies;
+static unsigned pending_reply_count;
+static unsigned pending_reply_size;
+static unsigned pending_reply_bytes;
+
+static struct pending_scan *pending_scans;
+static unsigned pending_scan_count;
+static unsigned pending_scan_size;
+
+static int jtag_vpi_write_all(const void *data, unsigned len)
+{
+	const uint8_t *p = data;
+
+	while (len) {
+		int retval = write_socket(sockfd, p, len);
+		if (retval <= 0) {
+			LOG_ERROR("jtag_vpi: write to server failed");
+			return ERROR_FAIL;
+		}
+		p += retval;
+		len -= retval;
+	}
+
+	return ERROR_OK;
+}
+
+static int jtag_vpi_read_all(void *data, unsigned len)
+{
+	uint8_t *p = data;
+
+	while (len) {
+		int retval = read_socket(sockfd, p, len);
+		if (retval <= 0) {
+			LOG_ERROR("jtag_vpi: read from server failed");
+			return ERROR_FAIL;
+		}
+		p += retval;
+		len -= retval;
+	}
+
+	return ERROR_OK;
+}
+
+static int jtag_vpi_send_buffer(void)
+{
+	int retval = jtag_vpi_write_all(send_buffer, send_len);
+
+	send_len = 0;
+	return retval;
+}
+
+/**
+ * jtag_vpi_reserve - get room for a command in the send buffer
+ * @len: size of the command in bytes, at most SEND_BUFFER_SIZE
+ *
+ * Returns a pointer to @len bytes at the end of the send buffer, writing
+ * out what is already buffered first if needed, or NULL on error.
+ */
+static uint8_t *jtag_vpi_reserve(unsigned len)
+{
+	if (send_len + len > SEND_BUFFER_SIZE && jtag_vpi_send_buffer() != ERROR_OK)
+		return NULL;
+
+	uint8_t *p = send_buffer + send_len;
+	send_len += len;
+	return p;
+}
+
+/**
+ * jtag_vpi_read_replies - send buffered commands and collect all replies
+ *
+ * Returns ERROR_OK if OK, ERROR_xxx if a read/write error occured.
+ */
+static int jtag_vpi_read_replies(void)
+{
+	int retval = jtag_vpi_send_buffer();
+
+	for (unsigned i = 0; retval == ERROR_OK && i < pending_reply_count; i++) {
+		struct pending_reply *reply = &pending_replies[i];
+
+		if (protocol_version == 1) {
+			struct vpi_cmd vpi;
+
+			retval = jtag_vpi_read_all(&vpi, sizeof(vpi));
+			if (retval == ERROR_OK && reply->dst)
+				memcpy(reply->dst, vpi.buffer_in, reply->nb_bytes);
+		} else {
+			retval = jtag_vpi_read_all(reply->dst, reply->nb_bytes);
+		}
+	}
+
+	pending_reply_count = 0;
+	pending_reply_bytes = 0;
+
+	return retval;
+}
+
+/**
+ * jtag_vpi_expect_reply - note that the next command sent gets a reply
+ * @dst: where the TDO bits of the reply are copied to (or NULL)
+ * @nb_bytes: number of TDO bytes in the reply
+ *
+ * Must be called before the command itself is added to the send buffer.
+ */
+static int jtag_vpi_expect_reply(uint8_t *dst, int nb_bytes)
+{
+	unsigned reply_bytes = protocol_version == 1 ? sizeof(struct vpi_cmd) : (unsigned)nb_bytes;
+
+	if (pending_reply_count && pending_reply_bytes + reply_bytes > MAX_PENDING_REPLY_BYTES) {
+		int retval = jtag_vpi_read_replies();
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
+	if (pending_reply_count == pending_reply_size) {
+		unsigned size = pending_reply_size ? 2 * pending_reply_size : 64;
+		struct pending_reply *p = realloc(pending_replies, size * sizeof(*p));
+		if (!p) {
+			LOG_ERROR("jtag_vpi: out of memory");
+			return ERROR_FAIL;
+		}
+		pending_replies = p;
+		pending_reply_size = size;
+	}
+
+	pending_replies[pending_reply_count].dst = dst;
+	pending_replies[pending_reply_count].nb_bytes = nb_bytes;
+	pending_reply_count++;
+	pending_reply_bytes += reply_bytes;
+
+	return ERROR_OK;
+}
+
+static int jtag_vpi_defer_scan(struct scan_command *cmd, uint8_t *buf)
+{
+	if (pending_scan_count == pending_scan_size) {
+		unsigned size = pending_scan_size ? 2 * pending_scan_size : 64;
+		struct pending_scan *p = realloc(pending_scans, size * sizeof(*p));
+		if (!p) {
+			LOG_ERROR("jtag_vpi: out of memory");
+			return ERROR_FAIL;
+		}
+		pending_scans = p;
+		pending_scan_size = size;
+	}
+
+	pending_scans[pending_scan_count].cmd = cmd;
+	pending_scans[pending_scan_count].buf = buf;
+	pending_scan_count++;
+
+	return ERROR_OK;
+}
+
+/**
+ * jtag_vpi_flush - complete everything sent so far
+ *
+ * Sends the buffered commands, waits for the outstanding replies and
+ * hands the captured bits of the deferred scans to jtag_read_buffer().
+ */
+static int jtag_vpi_flush(void)
+{
+	int retval = jtag_vpi_read_replies();
+
+	for (unsigned i = 0; i < pending_scan_count; i++) {
+		if (retval == ERROR_OK)
+			retval = jtag_read_buffer(pending_scans[i].buf, pending_scans[i].cmd);
+		free(pending_scans[i].buf);
+	}
+	pending_scan_count = 0;
+
+	return retval;
+}
+
 static int jtag_vpi_send_cmd(struct vpi_cmd *vpi)
 {
-	int retval = write_socket(sockfd, vpi, sizeof(struct vpi_cmd));
-	if (retval <= 0)
+	uint8_t *p = jtag_vpi_reserve(sizeof(struct vpi_cmd));
+	if (!p)
 		return ERROR_FAIL;
 
+	memcpy(p, vpi, sizeof(struct vpi_cmd));
 	return ERROR_OK;
 }
 
-static int jtag_vpi_receive_cmd(struct vpi_cmd *vpi)
+/**
+ * jtag_vpi_send_cmd_v2 - queue a protocol version 2 command
+ * @cmd: command code
+ * @flags: VPI_FLAG_xxx
+ * @bits: payload (or NULL if all ones are to be sent)
+ * @nb_bits: number of payload bits
+ */
+static int jtag_vpi_send_cmd_v2(int cmd, int flags, const uint8_t *bits, int nb_bits)
 {
-	int retval = read_socket(sockfd, vpi, sizeof(struct vpi_cmd));
-	if (retval < (int)sizeof(struct vpi_cmd))
+	int nb_bytes = DIV_ROUND_UP(nb_bits, 8);
+	uint8_t *p = jtag_vpi_reserve(VPI_V2_HEADER_SIZE + nb_bytes);
+	if (!p)
 		return ERROR_FAIL;
 
+	p[0] = cmd;
+	p[1] = flags;
+	p[2] = 0;
+	p[3] = 0;
+	h_u32_to_le(p + 4, nb_bits);
+
+	if (bits)
+		memcpy(p + VPI_V2_HEADER_SIZE, bits, nb_bytes);
+	else
+		memset(p + VPI_V2_HEADER_SIZE, 0xff, nb_bytes);
+
 	return ERROR_OK;
 }
 
@@ -82,6 +317,10 @@ static int jtag_vpi_reset(int trst, int srst)
 {
 	struct vpi_cmd vpi;
 
+	if (protocol_version == 2)
+		return jtag_vpi_send_cmd_v2(CMD_RESET, 0, NULL, 0);
+
+	memset(&vpi, 0, sizeof(vpi));
 	vpi.cmd = CMD_RESET;
 	vpi.length = 0;
 	return jtag_vpi_send_cmd(&vpi);
@@ -103,8 +342,12 @@ static int jtag_vpi_tms_seq(const uint8_t *bits, int nb_bits)
 	struct vpi_cmd vpi;
 	int nb_bytes;
 
+	if (protocol_version == 2)
+		return jtag_vpi_send_cmd_v2(CMD_TMS_SEQ, 0, bits, nb_bits);
+
 	nb_bytes = DIV_ROUND_UP(nb_bits, 8);
 
+	memset(&vpi, 0, sizeof(vpi));
 	vpi.cmd = CMD_TMS_SEQ;
 	memcpy(vpi.buffer_out, bits, nb_bytes);
 	vpi.length = nb_bytes;
@@ -165,12 +408,30 @@ static int jtag_vpi_state_move(tap_state_t state)
 	return ERROR_OK;
 }
 
-static int jtag_vpi_queue_tdi_xfer(uint8_t *bits, int nb_bits, int tap_shift)
+static int jtag_vpi_queue_tdi_xfer(uint8_t *bits, int nb_bits, int tap_shift, bool capture)
 {
 	struct vpi_cmd vpi;
 	int nb_bytes = DIV_ROUND_UP(nb_bits, 8);
+	int cmd = tap_shift ? CMD_SCAN_CHAIN_FLIP_TMS : CMD_SCAN_CHAIN;
+	uint8_t *dst = (bits && capture) ? bits : NULL;
+	int retval;
 
-	vpi.cmd = tap_shift ? CMD_SCAN_CHAIN_FLIP_TMS : CMD_SCAN_CHAIN;
+	if (protocol_version == 2) {
+		if (dst) {
+			retval = jtag_vpi_expect_reply(dst, nb_bytes);
+			if (retval != ERROR_OK)
+				return retval;
+		}
+		return jtag_vpi_send_cmd_v2(cmd, dst ? VPI_FLAG_CAPTURE : 0, bits, nb_bits);
+	}
+
+	/* version 1 servers reply to every scan, wanted or not */
+	retval = jtag_vpi_expect_reply(dst, nb_bytes);
+	if (retval != ERROR_OK)
+		return retval;
+
+	memset(&vpi, 0, sizeof(vpi));
+	vpi.cmd = cmd;
 
 	if (bits)
 		memcpy(vpi.buffer_out, bits, nb_bytes);
@@ -180,45 +441,38 @@ static int jtag_vpi_queue_tdi_xfer(uint8_t *bits, int nb_bits, int tap_shift)
 	vpi.length = nb_bytes;
 	vpi.nb_bits = nb_bits;
 
-	int retval = jtag_vpi_send_cmd(&vpi);
-	if (retval != ERROR_OK)
-		return retval;
-
-	retval = jtag_vpi_receive_cmd(&vpi);
-	if (retval != ERROR_OK)
-		return retval;
-
-	if (bits)
-		memcpy(bits, vpi.buffer_in, nb_bytes);
-
-	return ERROR_OK;
+	return jtag_vpi_send_cmd(&vpi);
 }
 
 /**
  * jtag_vpi_queue_tdi - short description
  * @bits: bits to be queued on TDI (or NULL if 0 are to be queued)
  * @nb_bits: number of bits
+ * @capture: true if the TDO bits are to be copied back into @bits
+ *
+ * The TDO bits are only valid after jtag_vpi_flush().
  */
-static int jtag_vpi_queue_tdi(uint8_t *bits, int nb_bits, int tap_shift)
+static int jtag_vpi_queue_tdi(uint8_t *bits, int nb_bits, int tap_shift, bool capture)
 {
-	int nb_xfer = DIV_ROUND_UP(nb_bits, XFERT_MAX_SIZE * 8);
-	uint8_t *xmit_buffer = bits;
+	int max_bytes = protocol_version == 2 ? XFERT_V2_MAX_SIZE : XFERT_MAX_SIZE;
+	int nb_xfer = DIV_ROUND_UP(nb_bits, max_bytes * 8);
 	int xmit_nb_bits = nb_bits;
 	int i = 0;
 	int retval;
 
 	while (nb_xfer) {
+		uint8_t *xmit_buffer = bits ? &bits[i] : NULL;
 
 		if (nb_xfer ==  1) {
-			retval = jtag_vpi_queue_tdi_xfer(&xmit_buffer[i], xmit_nb_bits, tap_shift);
+			retval = jtag_vpi_queue_tdi_xfer(xmit_buffer, xmit_nb_bits, tap_shift, capture);
 			if (retval != ERROR_OK)
 				return retval;
 		} else {
-			retval = jtag_vpi_queue_tdi_xfer(&xmit_buffer[i], XFERT_MAX_SIZE * 8, NO_TAP_SHIFT);
+			retval = jtag_vpi_queue_tdi_xfer(xmit_buffer, max_bytes * 8, NO_TAP_SHIFT, capture);
 			if (retval != ERROR_OK)
 				return retval;
-			xmit_nb_bits -= XFERT_MAX_SIZE * 8;
-			i += XFERT_MAX_SIZE;
+			xmit_nb_bits -= max_bytes * 8;
+			i += max_bytes;
 		}
 
 		nb_xfer--;
@@ -253,9 +507,18 @@ static int jtag_vpi_scan(struct scan_command *cmd)
 {
 	int scan_bits;
 	uint8_t *buf = NULL;
+	bool capture;
 	int retval = ERROR_OK;
 
 	scan_bits = jtag_build_buffer(cmd, &buf);
+	capture = jtag_scan_type(cmd) & SCAN_IN;
+
+	/* the TDO bits are only filled in when the queue is flushed */
+	retval = jtag_vpi_defer_scan(cmd, buf);
+	if (retval != ERROR_OK) {
+		free(buf);
+		return retval;
+	}
 
 	if (cmd->ir_scan) {
 		retval = jtag_vpi_state_move(TAP_IRSHIFT);
@@ -268,11 +531,11 @@ static int jtag_vpi_scan(struct scan_command *cmd)
 	}
 
 	if (cmd->end_state == TAP_DRSHIFT) {
-		retval = jtag_vpi_queue_tdi(buf, scan_bits, NO_TAP_SHIFT);
+		retval = jtag_vpi_queue_tdi(buf, scan_bits, NO_TAP_SHIFT, capture);
 		if (retval != ERROR_OK)
 			return retval;
 	} else {
-		retval = jtag_vpi_queue_tdi(buf, scan_bits, TAP_SHIFT);
+		retval = jtag_vpi_queue_tdi(buf, scan_bits, TAP_SHIFT, capture);
 		if (retval != ERROR_OK)
 			return retval;
 	}
@@ -292,13 +555,6 @@ static int jtag_vpi_scan(struct scan_command *cmd)
 			tap_set_state(TAP_DRPAUSE);
 	}
 
-	retval = jtag_read_buffer(buf, cmd);
-	if (retval != ERROR_OK)
-		return retval;
-
-	if (buf)
-		free(buf);
-
 	if (cmd->end_state != TAP_DRSHIFT) {
 		retval = jtag_vpi_state_move(cmd->end_state);
 		if (retval != ERROR_OK)
@@ -316,7 +572,7 @@ static int jtag_vpi_runtest(int cycles, tap_state_t state)
 	if (retval != ERROR_OK)
 		return retval;
 
-	retval = jtag_vpi_queue_tdi(NULL, cycles, TAP_SHIFT);
+	retval = jtag_vpi_queue_tdi(NULL, cycles, TAP_SHIFT, false);
 	if (retval != ERROR_OK)
 		return retval;
 
@@ -325,7 +581,7 @@ static int jtag_vpi_runtest(int cycles, tap_state_t state)
 
 static int jtag_vpi_stableclocks(int cycles)
 {
-	return jtag_vpi_queue_tdi(NULL, cycles, TAP_SHIFT);
+	return jtag_vpi_queue_tdi(NULL, cycles, TAP_SHIFT, false);
 }
 
 static int jtag_vpi_execute_queue(void)
@@ -356,6 +612,7 @@ static int jtag_vpi_execute_queue(void)
 			retval = jtag_vpi_tms(cmd->cmd.tms);
 			break;
 		case JTAG_SLEEP:
+			retval = jtag_vpi_flush();
 			jtag_sleep(cmd->cmd.sleep->us);
 			break;
 		case JTAG_SCAN:
@@ -364,11 +621,23 @@ static int jtag_vpi_execute_queue(void)
 		}
 	}
 
+	/* complete what was sent, and drop the deferred scans on error */
+	int flush_retval = jtag_vpi_flush();
+	if (retval == ERROR_OK)
+		retval = flush_retval;
+
 	return retval;
 }
 
 static int jtag_vpi_init(void)
 {
+	send_buffer = malloc(SEND_BUFFER_SIZE);
+	if (!send_buffer) {
+		LOG_ERROR("jtag_vpi: out of memory");
+		return ERROR_FAIL;
+	}
+	send_len = 0;
+
 	sockfd = socket(AF_INET, SOCK_STREAM, 0);
 	if (sockfd < 0) {
 		LOG_ERROR("Could not create socket");
@@ -396,13 +665,27 @@ static int jtag_vpi_init(void)
 		return ERROR_COMMAND_CLOSE_CONNECTION;
 	}
 
-	LOG_INFO("Connection to %s : %u succeed", server_address, server_port);
+	/* commands are batched, so don't let Nagle hold back the last one */
+	int flag = 1;
+	setsockopt(sockfd, IPPROTO_TCP, TCP_NODELAY, (char *)&flag, sizeof(int));
+
+	LOG_INFO("Connection to %s : %u succeed, protocol version %d",
+		 server_address, server_port, protocol_version);
 
 	return ERROR_OK;
 }
 
 static int jtag_vpi_quit(void)
 {
+	free(send_buffer);
+	send_buffer = NULL;
+	free(pending_replies);
+	pending_replies = NULL;
+	pending_reply_size = 0;
+	free(pending_scans);
+	pending_scans = NULL;
+	pending_scan_size = 0;
+
 	free(server_address);
 	return close(sockfd);
 }
@@ -434,6 +717,24 @@ COMMAND_HANDLER(jtag_vpi_set_address)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(jtag_vpi_set_protocol)
+{
+	if (CMD_ARGC != 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	int version;
+	COMMAND_PARSE_NUMBER(int, CMD_ARGV[0], version);
+	if (version != 1 && version != 2) {
+		LOG_ERROR("jtag_vpi: protocol version must be 1 or 2");
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+	protocol_version = version;
+
+	LOG_INFO("Set protocol version to %d", protocol_version);
+
+	return ERROR_OK;
+}
+
 static const struct command_registration jtag_vpi_command_handlers[] = {
 	{
 		.name = "jtag_vpi_set_port",
@@ -449,6 +750,14 @@ static const struct command_registration jtag_vpi_command_handlers[] = {
 		.help = "set the address of the VPI server",
 		.usage = "description_string",
 	},
+	{
+		.name = "jtag_vpi_set_protocol",
+		.handler = &jtag_vpi_set_protocol,
+		.mode = COMMAND_CONFIG,
+		.help = "select the VPI protocol version; version 2 streams "
+			"variable length commands and only returns captured TDO bits",
+		.usage = "(1|2)",
+	},
 	COMMAND_REGISTRATION_DONE
 };
 
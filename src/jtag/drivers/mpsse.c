@@ -66,6 +66,37 @@
 #define SIO_RESET_PURGE_RX 1
 #define SIO_RESET_PURGE_TX 2
 
+/* Bulk transfers kept in flight in each direction, and the size of each */
+#define MPSSE_URBS 4
+#define MPSSE_URB_SIZE 4096
+
+struct mpsse_batch;
+
+struct mpsse_urb {
+	struct mpsse_batch *batch;
+	struct libusb_transfer *transfer;
+	bool busy;
+};
+
+/* A submitted command buffer and the read data it will produce. While it is on the wire the
+ * context queues the next commands into the spare buffers. */
+struct mpsse_batch {
+	struct mpsse_ctx *ctx;
+	uint8_t *write_buffer;
+	unsigned write_count;
+	unsigned write_submitted;
+	unsigned written;
+	uint8_t *read_buffer;
+	unsigned read_count;
+	unsigned transferred;
+	struct bit_copy_queue read_queue;
+	struct mpsse_urb write_urb[MPSSE_URBS];
+	struct mpsse_urb read_urb[MPSSE_URBS];
+	unsigned busy;
+	bool active;
+	bool failed;
+};
+
 struct mpsse_ctx {
 	libusb_context *usb_ctx;
 	libusb_device_handle *usb_dev;
@@ -86,6 +117,7 @@ struct mpsse_ctx {
 	uint8_t *read_chunk;
 	unsigned read_chunk_size;
 	struct bit_copy_queue read_queue;
+	struct mpsse_batch batch;
 	int retval;
 };
 
@@ -272,15 +304,29 @@ struct mpsse_ctx *mpsse_open(const uint16_t *vid, const uint16_t *pid, const cha
 		return 0;
 
 	bit_copy_queue_init(&ctx->read_queue);
-	ctx->read_chunk_size = 16384;
+	bit_copy_queue_init(&ctx->batch.read_queue);
+	ctx->read_chunk_size = MPSSE_URBS * MPSSE_URB_SIZE;
 	ctx->read_size = 16384;
 	ctx->write_size = 16384;
 	ctx->read_chunk = malloc(ctx->read_chunk_size);
 	ctx->read_buffer = malloc(ctx->read_size);
 	ctx->write_buffer = malloc(ctx->write_size);
-	if (!ctx->read_chunk || !ctx->read_buffer || !ctx->write_buffer)
+	ctx->batch.read_buffer = malloc(ctx->read_size);
+	ctx->batch.write_buffer = malloc(ctx->write_size);
+	if (!ctx->read_chunk || !ctx->read_buffer || !ctx->write_buffer
+			|| !ctx->batch.read_buffer || !ctx->batch.write_buffer)
 		goto error;
 
+	ctx->batch.ctx = ctx;
+	for (int i = 0; i < MPSSE_URBS; i++) {
+		ctx->batch.write_urb[i].batch = &ctx->batch;
+		ctx->batch.write_urb[i].transfer = libusb_alloc_transfer(0);
+		ctx->batch.read_urb[i].batch = &ctx->batch;
+		ctx->batch.read_urb[i].transfer = libusb_alloc_transfer(0);
+		if (!ctx->batch.write_urb[i].transfer || !ctx->batch.read_urb[i].transfer)
+			goto error;
+	}
+
 	ctx->interface = channel;
 	ctx->index = channel + 1;
 	ctx->usb_read_timeout = 5000;
@@ -335,8 +381,16 @@ error:
 	return 0;
 }
 
+static void mpsse_cancel(struct mpsse_ctx *ctx);
+
 void mpsse_close(struct mpsse_ctx *ctx)
 {
+	if (ctx->usb_dev)
+		mpsse_cancel(ctx);
+	for (int i = 0; i < MPSSE_URBS; i++) {
+		libusb_free_transfer(ctx->batch.write_urb[i].transfer);
+		libusb_free_transfer(ctx->batch.read_urb[i].transfer);
+	}
 	if (ctx->usb_dev)
 		libusb_close(ctx->usb_dev);
 	if (ctx->usb_ctx)
@@ -346,6 +400,10 @@ void mpsse_close(struct mpsse_ctx *ctx)
 		free(ctx->write_buffer);
 	if (ctx->read_buffer)
 		free(ctx->read_buffer);
+	if (ctx->batch.write_buffer)
+		free(ctx->batch.write_buffer);
+	if (ctx->batch.read_buffer)
+		free(ctx->batch.read_buffer);
 	if (ctx->read_chunk)
 		free(ctx->read_chunk);
 
@@ -361,6 +419,7 @@ void mpsse_purge(struct mpsse_ctx *ctx)
 {
 	int err;
 	LOG_DEBUG("-");
+	mpsse_cancel(ctx);
 	ctx->write_count = 0;
 	ctx->read_count = 0;
 	ctx->retval = ERROR_OK;
@@ -380,6 +439,8 @@ void mpsse_purge(struct mpsse_ctx *ctx)
 	}
 }
 
+static int mpsse_submit(struct mpsse_ctx *ctx);
+
 static unsigned buffer_write_space(struct mpsse_ctx *ctx)
 {
 	/* Reserve one byte for SEND_IMMEDIATE */
@@ -451,8 +512,11 @@ void mpsse_clock_data(struct mpsse_ctx *ctx, const uint8_t *out, unsigned out_of
 	while (length > 0) {
 		/* Guarantee buffer space enough for a minimum size transfer */
 		if (buffer_write_space(ctx) + (length < 8) < (out || (!out && !in) ? 4 : 3)
-				|| (in && buffer_read_space(ctx) < 1))
-			ctx->retval = mpsse_flush(ctx);
+				|| (in && buffer_read_space(ctx) < 1)) {
+			ctx->retval = mpsse_submit(ctx);
+			if (ctx->retval != ERROR_OK)
+				return;
+		}
 
 		if (length < 8) {
 			/* Transfer remaining bits in bit mode */
@@ -525,8 +589,11 @@ void mpsse_clock_tms_cs(struct mpsse_ctx *ctx, const uint8_t *out, unsigned out_
 
 	while (length > 0) {
 		/* Guarantee buffer space enough for a minimum size transfer */
-		if (buffer_write_space(ctx) < 3 || (in && buffer_read_space(ctx) < 1))
-			ctx->retval = mpsse_flush(ctx);
+		if (buffer_write_space(ctx) < 3 || (in && buffer_read_space(ctx) < 1)) {
+			ctx->retval = mpsse_submit(ctx);
+			if (ctx->retval != ERROR_OK)
+				return;
+		}
 
 		/* Byte transfer */
 		unsigned this_bits = length;
@@ -568,8 +635,11 @@ void mpsse_set_data_bits_low_byte(struct mpsse_ctx *ctx, uint8_t data, uint8_t d
 		return;
 	}
 
-	if (buffer_write_space(ctx) < 3)
-		ctx->retval = mpsse_flush(ctx);
+	if (buffer_write_space(ctx) < 3) {
+		ctx->retval = mpsse_submit(ctx);
+		if (ctx->retval != ERROR_OK)
+			return;
+	}
 
 	buffer_write_byte(ctx, 0x80);
 	buffer_write_byte(ctx, data);
@@ -585,8 +655,11 @@ void mpsse_set_data_bits_high_byte(struct mpsse_ctx *ctx, uint8_t data, uint8_t
 		return;
 	}
 
-	if (buffer_write_space(ctx) < 3)
-		ctx->retval = mpsse_flush(ctx);
+	if (buffer_write_space(ctx) < 3) {
+		ctx->retval = mpsse_submit(ctx);
+		if (ctx->retval != ERROR_OK)
+			return;
+	}
 
 	buffer_write_byte(ctx, 0x82);
 	buffer_write_byte(ctx, data);
@@ -602,8 +675,11 @@ void mpsse_read_data_bits_low_byte(struct mpsse_ctx *ctx, uint8_t *data)
 		return;
 	}
 
-	if (buffer_write_space(ctx) < 1 || buffer_read_space(ctx) < 1)
-		ctx->retval = mpsse_flush(ctx);
+	if (buffer_write_space(ctx) < 1 || buffer_read_space(ctx) < 1) {
+		ctx->retval = mpsse_submit(ctx);
+		if (ctx->retval != ERROR_OK)
+			return;
+	}
 
 	buffer_write_byte(ctx, 0x81);
 	buffer_add_read(ctx, data, 0, 8, 0);
@@ -618,8 +694,11 @@ void mpsse_read_data_bits_high_byte(struct mpsse_ctx *ctx, uint8_t *data)
 		return;
 	}
 
-	if (buffer_write_space(ctx) < 1 || buffer_read_space(ctx) < 1)
-		ctx->retval = mpsse_flush(ctx);
+	if (buffer_write_space(ctx) < 1 || buffer_read_space(ctx) < 1) {
+		ctx->retval = mpsse_submit(ctx);
+		if (ctx->retval != ERROR_OK)
+			return;
+	}
 
 	buffer_write_byte(ctx, 0x83);
 	buffer_add_read(ctx, data, 0, 8, 0);
@@ -633,8 +712,11 @@ static void single_byte_boolean_helper(struct mpsse_ctx *ctx, bool var, uint8_t
 		return;
 	}
 
-	if (buffer_write_space(ctx) < 1)
-		ctx->retval = mpsse_flush(ctx);
+	if (buffer_write_space(ctx) < 1) {
+		ctx->retval = mpsse_submit(ctx);
+		if (ctx->retval != ERROR_OK)
+			return;
+	}
 
 	buffer_write_byte(ctx, var ? val_if_true : val_if_false);
 }
@@ -654,8 +736,11 @@ void mpsse_set_divisor(struct mpsse_ctx *ctx, uint16_t divisor)
 		return;
 	}
 
-	if (buffer_write_space(ctx) < 3)
-		ctx->retval = mpsse_flush(ctx);
+	if (buffer_write_space(ctx) < 3) {
+		ctx->retval = mpsse_submit(ctx);
+		if (ctx->retval != ERROR_OK)
+			return;
+	}
 
 	buffer_write_byte(ctx, 0x86);
 	buffer_write_byte(ctx, divisor & 0xff);
@@ -715,155 +800,280 @@ int mpsse_set_frequency(struct mpsse_ctx *ctx, int frequency)
 	return frequency;
 }
 
-/* Context needed by the callbacks */
-struct transfer_result {
-	struct mpsse_ctx *ctx;
-	bool done;
-	unsigned transferred;
-};
+static LIBUSB_CALL void write_cb(struct libusb_transfer *transfer);
+
+static bool mpsse_submit_write(struct mpsse_urb *urb)
+{
+	struct mpsse_batch *batch = urb->batch;
+	struct mpsse_ctx *ctx = batch->ctx;
+	unsigned length = batch->write_count - batch->write_submitted;
+
+	if (length == 0)
+		return true;
+	if (length > MPSSE_URB_SIZE)
+		length = MPSSE_URB_SIZE;
+
+	libusb_fill_bulk_transfer(urb->transfer, ctx->usb_dev, ctx->out_ep,
+		batch->write_buffer + batch->write_submitted, length, write_cb, urb,
+		ctx->usb_write_timeout);
+	if (libusb_submit_transfer(urb->transfer) != LIBUSB_SUCCESS) {
+		batch->failed = true;
+		return false;
+	}
+
+	batch->write_submitted += length;
+	urb->busy = true;
+	batch->busy++;
+	return true;
+}
+
+static bool mpsse_submit_read(struct mpsse_urb *urb)
+{
+	struct mpsse_batch *batch = urb->batch;
+
+	if (libusb_submit_transfer(urb->transfer) != LIBUSB_SUCCESS) {
+		batch->failed = true;
+		return false;
+	}
+
+	urb->busy = true;
+	batch->busy++;
+	return true;
+}
 
 static LIBUSB_CALL void read_cb(struct libusb_transfer *transfer)
 {
-	struct transfer_result *res = transfer->user_data;
-	struct mpsse_ctx *ctx = res->ctx;
+	struct mpsse_urb *urb = transfer->user_data;
+	struct mpsse_batch *batch = urb->batch;
+	struct mpsse_ctx *ctx = batch->ctx;
 
 	unsigned packet_size = ctx->max_packet_size;
 
+	urb->busy = false;
+	batch->busy--;
+
+	if (transfer->status != LIBUSB_TRANSFER_COMPLETED) {
+		if (transfer->status != LIBUSB_TRANSFER_CANCELLED)
+			batch->failed = true;
+		return;
+	}
+
 	DEBUG_PRINT_BUF(transfer->buffer, transfer->actual_length);
 
 	/* Strip the two status bytes sent at the beginning of each USB packet
-	 * while copying the chunk buffer to the read buffer */
+	 * while copying the chunk buffer to the read buffer. Transfers on one
+	 * endpoint complete in submission order, so the data arrives in order. */
 	unsigned num_packets = DIV_ROUND_UP(transfer->actual_length, packet_size);
 	unsigned chunk_remains = transfer->actual_length;
 	for (unsigned i = 0; i < num_packets && chunk_remains > 2; i++) {
 		unsigned this_size = packet_size - 2;
 		if (this_size > chunk_remains - 2)
 			this_size = chunk_remains - 2;
-		if (this_size > ctx->read_count - res->transferred)
-			this_size = ctx->read_count - res->transferred;
-		memcpy(ctx->read_buffer + res->transferred,
-			ctx->read_chunk + packet_size * i + 2,
+		if (this_size > batch->read_count - batch->transferred)
+			this_size = batch->read_count - batch->transferred;
+		memcpy(batch->read_buffer + batch->transferred,
+			transfer->buffer + packet_size * i + 2,
 			this_size);
-		res->transferred += this_size;
+		batch->transferred += this_size;
 		chunk_remains -= this_size + 2;
-		if (res->transferred == ctx->read_count) {
-			res->done = true;
+		if (batch->transferred == batch->read_count)
 			break;
-		}
 	}
 
-	DEBUG_IO("raw chunk %d, transferred %d of %d", transfer->actual_length, res->transferred,
-		ctx->read_count);
+	DEBUG_IO("raw chunk %d, transferred %d of %d", transfer->actual_length, batch->transferred,
+		batch->read_count);
 
-	if (!res->done)
-		if (libusb_submit_transfer(transfer) != LIBUSB_SUCCESS)
-			res->done = true;
+	if (batch->transferred < batch->read_count && !batch->failed)
+		mpsse_submit_read(urb);
 }
 
 static LIBUSB_CALL void write_cb(struct libusb_transfer *transfer)
 {
-	struct transfer_result *res = transfer->user_data;
-	struct mpsse_ctx *ctx = res->ctx;
+	struct mpsse_urb *urb = transfer->user_data;
+	struct mpsse_batch *batch = urb->batch;
 
-	res->transferred += transfer->actual_length;
+	urb->busy = false;
+	batch->busy--;
 
-	DEBUG_IO("transferred %d of %d", res->transferred, ctx->write_count);
+	if (transfer->status != LIBUSB_TRANSFER_COMPLETED) {
+		if (transfer->status != LIBUSB_TRANSFER_CANCELLED)
+			batch->failed = true;
+		return;
+	}
+
+	batch->written += transfer->actual_length;
+
+	DEBUG_IO("transferred %d of %d", batch->written, batch->write_count);
 
 	DEBUG_PRINT_BUF(transfer->buffer, transfer->actual_length);
 
-	if (res->transferred == ctx->write_count)
-		res->done = true;
-	else {
-		transfer->length = ctx->write_count - res->transferred;
-		transfer->buffer = ctx->write_buffer + res->transferred;
-		if (libusb_submit_transfer(transfer) != LIBUSB_SUCCESS)
-			res->done = true;
+	/* A short write would leave a hole in the command stream */
+	if (transfer->actual_length != transfer->length)
+		batch->failed = true;
+	else if (!batch->failed)
+		mpsse_submit_write(urb);
+}
+
+static void mpsse_cancel_urbs(struct mpsse_batch *batch)
+{
+	for (int i = 0; i < MPSSE_URBS; i++) {
+		if (batch->write_urb[i].busy)
+			libusb_cancel_transfer(batch->write_urb[i].transfer);
+		if (batch->read_urb[i].busy)
+			libusb_cancel_transfer(batch->read_urb[i].transfer);
 	}
 }
 
-int mpsse_flush(struct mpsse_ctx *ctx)
+/* Wait for the batch on the wire, if any, and deliver its read data */
+static int mpsse_wait(struct mpsse_ctx *ctx)
 {
-	int retval = ctx->retval;
+	struct mpsse_batch *batch = &ctx->batch;
+	bool cancelled = false;
+	int err = LIBUSB_SUCCESS;
+
+	if (!batch->active)
+		return ERROR_OK;
+
+	/* Polling loop, more or less taken from libftdi */
+	while (batch->busy) {
+		/* Read transfers still waiting once all data has arrived are surplus */
+		bool done = batch->written == batch->write_count
+			&& batch->transferred == batch->read_count;
+		if ((done || batch->failed) && !cancelled) {
+			mpsse_cancel_urbs(batch);
+			cancelled = true;
+		}
+
+		err = libusb_handle_events(ctx->usb_ctx);
+		keep_alive();
+		if (err != LIBUSB_SUCCESS && err != LIBUSB_ERROR_INTERRUPTED) {
+			mpsse_cancel_urbs(batch);
+			while (batch->busy)
+				if (libusb_handle_events(ctx->usb_ctx) != LIBUSB_SUCCESS)
+					break;
+			break;
+		}
+	}
+
+	batch->active = false;
+
+	int retval = ERROR_FAIL;
+	if (err != LIBUSB_SUCCESS && err != LIBUSB_ERROR_INTERRUPTED) {
+		LOG_ERROR("libusb_handle_events() failed with %d", err);
+	} else if (batch->written < batch->write_count) {
+		LOG_ERROR("ftdi device did not accept all data: %d, tried %d",
+			batch->written,
+			batch->write_count);
+	} else if (batch->transferred < batch->read_count) {
+		LOG_ERROR("ftdi device did not return all data: %d, expected %d",
+			batch->transferred,
+			batch->read_count);
+	} else {
+		retval = ERROR_OK;
+	}
+
+	if (retval == ERROR_OK)
+		bit_copy_execute(&batch->read_queue);
+	else
+		bit_copy_discard(&batch->read_queue);
+
+	return retval;
+}
+
+/* Abandon the batch on the wire, if any, without delivering its read data */
+static void mpsse_cancel(struct mpsse_ctx *ctx)
+{
+	struct mpsse_batch *batch = &ctx->batch;
+
+	if (!batch->active)
+		return;
+
+	mpsse_cancel_urbs(batch);
+	while (batch->busy)
+		if (libusb_handle_events(ctx->usb_ctx) != LIBUSB_SUCCESS)
+			break;
+
+	batch->active = false;
+	bit_copy_discard(&batch->read_queue);
+}
 
+/* Put the queued commands on the wire and return without waiting for them. Commands queued
+ * from here on go into the spare buffers; the previous batch is completed first, so at most
+ * one is in flight while the next is built. */
+static int mpsse_submit(struct mpsse_ctx *ctx)
+{
+	struct mpsse_batch *batch = &ctx->batch;
+
+	int retval = mpsse_wait(ctx);
 	if (retval != ERROR_OK) {
-		DEBUG_IO("Ignoring flush due to previous error");
-		assert(ctx->write_count == 0 && ctx->read_count == 0);
-		ctx->retval = ERROR_OK;
+		mpsse_purge(ctx);
 		return retval;
 	}
 
-	DEBUG_IO("write %d%s, read %d", ctx->write_count, ctx->read_count ? "+1" : "",
-			ctx->read_count);
-	assert(ctx->write_count > 0 || ctx->read_count == 0); /* No read data without write data */
-
 	if (ctx->write_count == 0)
-		return retval;
+		return ERROR_OK;
 
-	struct libusb_transfer *read_transfer = 0;
-	struct transfer_result read_result = { .ctx = ctx, .done = true };
-	if (ctx->read_count) {
+	if (ctx->read_count)
 		buffer_write_byte(ctx, 0x87); /* SEND_IMMEDIATE */
-		read_result.done = false;
-		/* delay read transaction to ensure the FTDI chip can support us with data
-		   immediately after processing the MPSSE commands in the write transaction */
-	}
 
-	struct transfer_result write_result = { .ctx = ctx, .done = false };
-	struct libusb_transfer *write_transfer = libusb_alloc_transfer(0);
-	libusb_fill_bulk_transfer(write_transfer, ctx->usb_dev, ctx->out_ep, ctx->write_buffer,
-		ctx->write_count, write_cb, &write_result, ctx->usb_write_timeout);
-	retval = libusb_submit_transfer(write_transfer);
+	uint8_t *spare = batch->write_buffer;
+	batch->write_buffer = ctx->write_buffer;
+	batch->write_count = ctx->write_count;
+	ctx->write_buffer = spare;
+	ctx->write_count = 0;
+
+	spare = batch->read_buffer;
+	batch->read_buffer = ctx->read_buffer;
+	batch->read_count = ctx->read_count;
+	ctx->read_buffer = spare;
+	ctx->read_count = 0;
+
+	list_splice_init(&ctx->read_queue.list, &batch->read_queue.list);
+
+	batch->write_submitted = 0;
+	batch->written = 0;
+	batch->transferred = 0;
+	batch->busy = 0;
+	batch->failed = false;
+	batch->active = true;
 
-	if (ctx->read_count) {
-		read_transfer = libusb_alloc_transfer(0);
-		libusb_fill_bulk_transfer(read_transfer, ctx->usb_dev, ctx->in_ep, ctx->read_chunk,
-			ctx->read_chunk_size, read_cb, &read_result,
+	for (int i = 0; i < MPSSE_URBS; i++)
+		if (!mpsse_submit_write(&batch->write_urb[i]))
+			break;
+
+	/* submit reads after the writes to ensure the FTDI chip can support us with data
+	 * immediately after processing the MPSSE commands in the write transaction */
+	for (int i = 0; i < MPSSE_URBS && batch->read_count && !batch->failed; i++) {
+		struct mpsse_urb *urb = &batch->read_urb[i];
+		libusb_fill_bulk_transfer(urb->transfer, ctx->usb_dev, ctx->in_ep,
+			ctx->read_chunk + i * MPSSE_URB_SIZE, MPSSE_URB_SIZE, read_cb, urb,
 			ctx->usb_read_timeout);
-		retval = libusb_submit_transfer(read_transfer);
+		mpsse_submit_read(urb);
 	}
 
-	/* Polling loop, more or less taken from libftdi */
-	while (!write_result.done || !read_result.done) {
-		retval = libusb_handle_events(ctx->usb_ctx);
-		keep_alive();
-		if (retval != LIBUSB_SUCCESS && retval != LIBUSB_ERROR_INTERRUPTED) {
-			libusb_cancel_transfer(write_transfer);
-			if (read_transfer)
-				libusb_cancel_transfer(read_transfer);
-			while (!write_result.done || !read_result.done)
-				if (libusb_handle_events(ctx->usb_ctx) != LIBUSB_SUCCESS)
-					break;
-		}
+	return ERROR_OK;
+}
+
+int mpsse_flush(struct mpsse_ctx *ctx)
+{
+	int retval = ctx->retval;
+
+	if (retval != ERROR_OK) {
+		DEBUG_IO("Ignoring flush due to previous error");
+		assert(ctx->write_count == 0 && ctx->read_count == 0);
+		ctx->retval = ERROR_OK;
+		return retval;
 	}
 
-	if (retval != LIBUSB_SUCCESS) {
-		LOG_ERROR("libusb_handle_events() failed with %d", retval);
-		retval = ERROR_FAIL;
-	} else if (write_result.transferred < ctx->write_count) {
-		LOG_ERROR("ftdi device did not accept all data: %d, tried %d",
-			write_result.transferred,
-			ctx->write_count);
-		retval = ERROR_FAIL;
-	} else if (read_result.transferred < ctx->read_count) {
-		LOG_ERROR("ftdi device did not return all data: %d, expected %d",
-			read_result.transferred,
+	DEBUG_IO("write %d%s, read %d", ctx->write_count, ctx->read_count ? "+1" : "",
 			ctx->read_count);
-		retval = ERROR_FAIL;
-	} else if (ctx->read_count) {
-		ctx->write_count = 0;
-		ctx->read_count = 0;
-		bit_copy_execute(&ctx->read_queue);
-		retval = ERROR_OK;
-	} else {
-		ctx->write_count = 0;
-		bit_copy_discard(&ctx->read_queue);
-		retval = ERROR_OK;
-	}
+	assert(ctx->write_count > 0 || ctx->read_count == 0); /* No read data without write data */
 
-	libusb_free_transfer(write_transfer);
-	if (read_transfer)
-		libusb_free_transfer(read_transfer);
+	retval = mpsse_submit(ctx);
+	if (retval != ERROR_OK)
+		return retval;
 
+	retval = mpsse_wait(ctx);
 	if (retval != ERROR_OK)
 		mpsse_purge(ctx);
 
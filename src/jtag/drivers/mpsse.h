@@ -73,7 +73,8 @@ int mpsse_rtck_config(struct mpsse_ctx *ctx, bool enable);
  * Frequency 0 means RTCK. */
 int mpsse_set_frequency(struct mpsse_ctx *ctx, int frequency);
 
-/* Queue handling */
+/* Queue handling. A full command buffer is sent in the background while the next one is
+ * filled; mpsse_flush() sends the rest and waits until everything has completed. */
 int mpsse_flush(struct mpsse_ctx *ctx);
 void mpsse_purge(struct mpsse_ctx *ctx);
 
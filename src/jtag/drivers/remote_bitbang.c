@@ -43,12 +43,51 @@
 		exit(-1); \
 	} while (0)
 
+/* Binary vector extension, see doc/manual/jtag/drivers/remote_bitbang.txt.
+ * Only offered with "remote_bitbang_binary on", as 'X' acknowledged
+ * by the server with 'X' followed by its version character before it
+ * answers the 'R' sent right after.  A server that does not know 'X'
+ * ignores it, so the first reply is then a plain '0' or '1'.
+ *
+ * 'V' flags len[4] tms[n] tdi[n] clocks len cycles (len little endian,
+ * n = ceil(len / 8), bit 0 first), sampling TDO before each rising edge
+ * and leaving TCK low.  If flags bit 0 is set, the server replies with
+ * the n bytes of sampled TDO.
+ */
+#define REMOTE_BITBANG_VERSION '1'
+#define REMOTE_BITBANG_CAPTURE 0x01
+
+/* clock cycles buffered before a 'V' is sent */
+#define REMOTE_BITBANG_VECTOR_BITS 32768
+/* unread TDO bytes after which replies are collected, so that neither
+ * side ever blocks on a full socket */
+#define REMOTE_BITBANG_MAX_PENDING 16384
+
 static char *remote_bitbang_host;
 static char *remote_bitbang_port;
+static bool remote_bitbang_use_binary;
+static bool remote_bitbang_binary;
 
 FILE *remote_bitbang_in;
 FILE *remote_bitbang_out;
 
+/* clock cycles queued by remote_bitbang_write() in binary mode */
+static uint8_t remote_bitbang_tms[REMOTE_BITBANG_VECTOR_BITS / 8];
+static uint8_t remote_bitbang_tdi[REMOTE_BITBANG_VECTOR_BITS / 8];
+static unsigned remote_bitbang_bits;
+static int remote_bitbang_tck;
+
+/* captures whose TDO has not been read yet */
+struct remote_bitbang_capture {
+	uint8_t *tdo;
+	unsigned num_bits;
+};
+
+static struct remote_bitbang_capture *remote_bitbang_captures;
+static unsigned remote_bitbang_capture_count;
+static unsigned remote_bitbang_capture_size;
+static unsigned remote_bitbang_pending_bytes;
+
 static void remote_bitbang_putc(int c)
 {
 	if (EOF == fputc(c, remote_bitbang_out))
@@ -76,6 +115,12 @@ static int remote_bitbang_quit(void)
 
 	free(remote_bitbang_host);
 	free(remote_bitbang_port);
+	free(remote_bitbang_captures);
+	remote_bitbang_host = NULL;
+	remote_bitbang_port = NULL;
+	remote_bitbang_captures = NULL;
+	remote_bitbang_capture_count = 0;
+	remote_bitbang_capture_size = 0;
 
 	LOG_INFO("remote_bitbang interface quit");
 	return ERROR_OK;
@@ -102,30 +147,156 @@ static int remote_bitbang_rread(void)
 	}
 }
 
+static void remote_bitbang_fwrite(const void *buf, size_t size)
+{
+	if (size && fwrite(buf, size, 1, remote_bitbang_out) != 1)
+		REMOTE_BITBANG_RAISE_ERROR("remote_bitbang_fwrite: %s", strerror(errno));
+}
+
+/* Send one 'V' command */
+static void remote_bitbang_send_vector(const uint8_t *tms, const uint8_t *tdi,
+		unsigned num_bits, bool capture)
+{
+	uint8_t header[6];
+	unsigned num_bytes = DIV_ROUND_UP(num_bits, 8);
+
+	header[0] = 'V';
+	header[1] = capture ? REMOTE_BITBANG_CAPTURE : 0;
+	h_u32_to_le(&header[2], num_bits);
+	remote_bitbang_fwrite(header, sizeof(header));
+	remote_bitbang_fwrite(tms, num_bytes);
+	remote_bitbang_fwrite(tdi, num_bytes);
+}
+
+/* Send the clock cycles queued by remote_bitbang_write() */
+static void remote_bitbang_send_bits(void)
+{
+	if (remote_bitbang_bits == 0)
+		return;
+
+	remote_bitbang_send_vector(remote_bitbang_tms, remote_bitbang_tdi,
+			remote_bitbang_bits, false);
+	memset(remote_bitbang_tms, 0, DIV_ROUND_UP(remote_bitbang_bits, 8));
+	memset(remote_bitbang_tdi, 0, DIV_ROUND_UP(remote_bitbang_bits, 8));
+	remote_bitbang_bits = 0;
+}
+
 static int remote_bitbang_read(void)
 {
+	remote_bitbang_send_bits();
 	remote_bitbang_putc('R');
 	return remote_bitbang_rread();
 }
 
 static void remote_bitbang_write(int tck, int tms, int tdi)
 {
-	char c = '0' + ((tck ? 0x4 : 0x0) | (tms ? 0x2 : 0x0) | (tdi ? 0x1 : 0x0));
-	remote_bitbang_putc(c);
+	if (!remote_bitbang_binary) {
+		char c = '0' + ((tck ? 0x4 : 0x0) | (tms ? 0x2 : 0x0) | (tdi ? 0x1 : 0x0));
+		remote_bitbang_putc(c);
+		return;
+	}
+
+	/* every rising edge is one clock cycle of the next vector */
+	if (tck && !remote_bitbang_tck) {
+		if (tms)
+			remote_bitbang_tms[remote_bitbang_bits / 8] |= 1 << (remote_bitbang_bits % 8);
+		if (tdi)
+			remote_bitbang_tdi[remote_bitbang_bits / 8] |= 1 << (remote_bitbang_bits % 8);
+		if (++remote_bitbang_bits == REMOTE_BITBANG_VECTOR_BITS)
+			remote_bitbang_send_bits();
+	}
+	remote_bitbang_tck = tck;
 }
 
 static void remote_bitbang_reset(int trst, int srst)
 {
 	char c = 'r' + ((trst ? 0x2 : 0x0) | (srst ? 0x1 : 0x0));
+	remote_bitbang_send_bits();
 	remote_bitbang_putc(c);
 }
 
 static void remote_bitbang_blink(int on)
 {
 	char c = on ? 'B' : 'b';
+	remote_bitbang_send_bits();
 	remote_bitbang_putc(c);
 }
 
+static int remote_bitbang_flush(void)
+{
+	remote_bitbang_send_bits();
+
+	if (EOF == fflush(remote_bitbang_out)) {
+		remote_bitbang_quit();
+		REMOTE_BITBANG_RAISE_ERROR("fflush: %s", strerror(errno));
+	}
+
+	for (unsigned i = 0; i < remote_bitbang_capture_count; i++) {
+		struct remote_bitbang_capture *capture = &remote_bitbang_captures[i];
+		size_t num_bytes = DIV_ROUND_UP(capture->num_bits, 8);
+
+		if (fread(capture->tdo, num_bytes, 1, remote_bitbang_in) != 1) {
+			remote_bitbang_quit();
+			REMOTE_BITBANG_RAISE_ERROR("remote_bitbang: short vector response");
+		}
+	}
+
+	remote_bitbang_capture_count = 0;
+	remote_bitbang_pending_bytes = 0;
+
+	return ERROR_OK;
+}
+
+static int remote_bitbang_scan(const uint8_t *tms, const uint8_t *tdi, uint8_t *tdo,
+		unsigned num_bits)
+{
+	if (tdo == NULL) {
+		/* output only, append to the queued cycles */
+		for (unsigned i = 0; i < num_bits; i++) {
+			remote_bitbang_write(0, buf_get_u32(tms, i, 1), tdi ? buf_get_u32(tdi, i, 1) : 0);
+			remote_bitbang_write(1, buf_get_u32(tms, i, 1), tdi ? buf_get_u32(tdi, i, 1) : 0);
+		}
+		remote_bitbang_write(0, 0, 0);
+		return ERROR_OK;
+	}
+
+	if (remote_bitbang_capture_count == remote_bitbang_capture_size) {
+		unsigned size = remote_bitbang_capture_size ? 2 * remote_bitbang_capture_size : 64;
+		struct remote_bitbang_capture *p = realloc(remote_bitbang_captures,
+				size * sizeof(*p));
+		if (p == NULL) {
+			LOG_ERROR("Out of memory");
+			return ERROR_FAIL;
+		}
+		remote_bitbang_captures = p;
+		remote_bitbang_capture_size = size;
+	}
+
+	remote_bitbang_send_bits();
+
+	if (tdi) {
+		remote_bitbang_send_vector(tms, tdi, num_bits, true);
+	} else {
+		uint8_t *zero = calloc(1, DIV_ROUND_UP(num_bits, 8));
+		if (zero == NULL) {
+			LOG_ERROR("Out of memory");
+			return ERROR_FAIL;
+		}
+		remote_bitbang_send_vector(tms, zero, num_bits, true);
+		free(zero);
+	}
+
+	remote_bitbang_captures[remote_bitbang_capture_count].tdo = tdo;
+	remote_bitbang_captures[remote_bitbang_capture_count].num_bits = num_bits;
+	remote_bitbang_capture_count++;
+
+	remote_bitbang_pending_bytes += DIV_ROUND_UP(num_bits, 8);
+	if (remote_bitbang_pending_bytes > REMOTE_BITBANG_MAX_PENDING)
+		return remote_bitbang_flush();
+
+	return ERROR_OK;
+}
+
 static struct bitbang_interface remote_bitbang_bitbang = {
 	.read = &remote_bitbang_read,
 	.write = &remote_bitbang_write,
@@ -133,6 +304,36 @@ static struct bitbang_interface remote_bitbang_bitbang = {
 	.blink = &remote_bitbang_blink,
 };
 
+/* Offer the binary extension; see the protocol description at the top */
+static void remote_bitbang_negotiate(void)
+{
+	remote_bitbang_putc('X');
+	remote_bitbang_putc('R');
+
+	if (EOF == fflush(remote_bitbang_out)) {
+		remote_bitbang_quit();
+		REMOTE_BITBANG_RAISE_ERROR("fflush: %s", strerror(errno));
+	}
+
+	int c = fgetc(remote_bitbang_in);
+	if (c == 'X') {
+		int version = fgetc(remote_bitbang_in);
+		remote_bitbang_rread();
+		if (version != REMOTE_BITBANG_VERSION) {
+			LOG_WARNING("remote_bitbang: unsupported protocol version %c(%i)",
+					version, version);
+			return;
+		}
+		remote_bitbang_binary = true;
+		remote_bitbang_bitbang.scan = &remote_bitbang_scan;
+		remote_bitbang_bitbang.flush = &remote_bitbang_flush;
+		LOG_INFO("remote_bitbang: using binary vectors");
+	} else {
+		ungetc(c, remote_bitbang_in);
+		remote_bitbang_rread();
+	}
+}
+
 static int remote_bitbang_init_tcp(void)
 {
 	struct addrinfo hints = { .ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM };
@@ -231,6 +432,12 @@ static int remote_bitbang_init(void)
 		return ERROR_FAIL;
 	}
 
+	remote_bitbang_binary = false;
+	remote_bitbang_bitbang.scan = NULL;
+	remote_bitbang_bitbang.flush = NULL;
+	if (remote_bitbang_use_binary)
+		remote_bitbang_negotiate();
+
 	LOG_INFO("remote_bitbang driver initialized");
 	return ERROR_OK;
 }
@@ -257,6 +464,15 @@ COMMAND_HANDLER(remote_bitbang_handle_remote_bitbang_host_command)
 	return ERROR_COMMAND_SYNTAX_ERROR;
 }
 
+COMMAND_HANDLER(remote_bitbang_handle_remote_bitbang_binary_command)
+{
+	if (CMD_ARGC == 1) {
+		COMMAND_PARSE_ON_OFF(CMD_ARGV[0], remote_bitbang_use_binary);
+		return ERROR_OK;
+	}
+	return ERROR_COMMAND_SYNTAX_ERROR;
+}
+
 static const struct command_registration remote_bitbang_command_handlers[] = {
 	{
 		.name = "remote_bitbang_port",
@@ -274,6 +490,14 @@ static const struct command_registration remote_bitbang_command_handlers[] = {
 			"  if port is 0 or unset, this is the name of the unix socket to use.",
 		.usage = "host_name",
 	},
+	{
+		.name = "remote_bitbang_binary",
+		.handler = remote_bitbang_handle_remote_bitbang_binary_command,
+		.mode = COMMAND_CONFIG,
+		.help = "Offer the binary vector protocol extension to the remote jtag "
+			"(default off). Only turn on for servers that implement it.",
+		.usage = "('on'|'off')",
+	},
 	COMMAND_REGISTRATION_DONE,
 };
 
@@ -53,6 +53,9 @@ extern struct jtag_interface parport_interface;
 #if BUILD_DUMMY == 1
 extern struct jtag_interface dummy_interface;
 #endif
+#if BUILD_JTAG_SIM == 1
+extern struct jtag_interface jtag_sim_interface;
+#endif
 #if BUILD_FT2232_FTD2XX == 1
 extern struct jtag_interface ft2232_interface;
 #endif
@@ -152,6 +155,9 @@ struct jtag_interface *jtag_interfaces[] = {
 #if BUILD_DUMMY == 1
 		&dummy_interface,
 #endif
+#if BUILD_JTAG_SIM == 1
+		&jtag_sim_interface,
+#endif
 #if BUILD_FT2232_FTD2XX == 1
 		&ft2232_interface,
 #endif
@@ -65,11 +65,14 @@ static inline uint8_t swd_cmd(bool is_read, bool is_ap, uint8_t regnum)
 /* SWD_ACK_* bits are defined in <target/arm_adi_v5.h> */
 
 /*
- * FOR NOW  ... SWD driver ops are synchronous and return ACK
- * status ... no quueueing.
+ * SWD driver ops are synchronous and return ACK status.
  *
  * Individual ops are request/response, and fast-fail permits much
  * better fault handling.  Upper layers may queue if desired.
+ *
+ * Drivers whose adapters pay a high per-request latency (USB) may
+ * also provide the optional queue_*() and run() ops.  Queued reads
+ * only store their result once run() returns ERROR_OK.
  */
 
 struct swd_driver {
@@ -122,6 +125,46 @@ struct swd_driver {
 	  */
 	 int (*read_block)(uint8_t cmd, uint32_t blocksize, uint8_t *buffer);
 
+	 /**
+	  * Queued read of an AP or DP register; optional.
+	  *
+	  * @param cmd with APnDP/RnW/addr/parity bits
+	  * @param where to store the value once run() succeeds
+	  *
+	  * @return ERROR_OK if queued, else a negative fault code
+	  */
+	 int (*queue_read_reg)(uint8_t cmd, uint32_t *value);
+
+	 /**
+	  * Queued write of an AP or DP register; optional.
+	  *
+	  * @param cmd with APnDP/RnW/addr/parity bits
+	  * @param value to be written to the register
+	  *
+	  * @return ERROR_OK if queued, else a negative fault code
+	  */
+	 int (*queue_write_reg)(uint8_t cmd, uint32_t value);
+
+	 /**
+	  * Queued block read of an AP or DP register; optional.
+	  *
+	  * @param cmd with APnDP/RnW/addr/parity bits
+	  * @param number of reads from register to be executed
+	  * @param buffer to store data once run() succeeds
+	  *
+	  * @return ERROR_OK if queued, else a negative fault code
+	  */
+	 int (*queue_read_block)(uint8_t cmd, uint32_t blocksize, uint8_t *buffer);
+
+	 /**
+	  * Execute all queued transfers, in order.  Required if
+	  * any of the queue_*() ops is provided.
+	  *
+	  * @return ERROR_OK, else the SWD_ACK_* code of the
+	  *		failing transaction or (negative) fault code
+	  */
+	 int (*run)(void);
+
 	/**
 	 * Configures data collection from the Single-wire
 	 * trace (SWO) signal.
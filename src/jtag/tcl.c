@@ -37,6 +37,7 @@
 #include "minidriver.h"
 #include "interface.h"
 #include "interfaces.h"
+#include "commands.h"
 #include "tcl.h"
 
 #ifdef HAVE_STRINGS_H
@@ -826,6 +827,24 @@ COMMAND_HANDLER(handle_jtag_init_command)
 	return jtag_init(CMD_CTX);
 }
 
+COMMAND_HANDLER(handle_jtag_queue_stats_command)
+{
+	struct cmd_queue_stats stats;
+
+	if (CMD_ARGC == 1 && strcmp(CMD_ARGV[0], "reset") == 0) {
+		cmd_queue_reset_stats();
+		return ERROR_OK;
+	} else if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	cmd_queue_get_stats(&stats);
+	command_print(CMD_CTX, "queue: %zu bytes in %u pages, high-water %zu bytes in %u pages",
+			stats.bytes, stats.pages, stats.max_bytes, stats.max_pages);
+	command_print(CMD_CTX, "pages: %u allocated, %u recycled, %u kept for reuse",
+			stats.pages_allocated, stats.pages_recycled, stats.free_pages);
+	return ERROR_OK;
+}
+
 static const struct command_registration jtag_subcommand_handlers[] = {
 	{
 		.name = "init",
@@ -908,6 +927,13 @@ static const struct command_registration jtag_subcommand_handlers[] = {
 		.jim_handler = jim_jtag_names,
 		.help = "Returns list of all JTAG tap names.",
 	},
+	{
+		.name = "queue_stats",
+		.mode = COMMAND_ANY,
+		.handler = handle_jtag_queue_stats_command,
+		.help = "Display or reset JTAG command queue memory statistics.",
+		.usage = "['reset']",
+	},
 	{
 		.chain = jtag_command_handlers_to_move,
 	},
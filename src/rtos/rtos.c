@@ -189,19 +189,27 @@ static char *next_symbol(struct rtos *os, char *cur_symbol, uint64_t cur_addr)
 int rtos_qsymbol(struct connection *connection, char *packet, int packet_size)
 {
 	int rtos_detected = 0;
-	uint64_t addr;
-	size_t reply_len;
-	char reply[GDB_BUFFER_SIZE], cur_sym[GDB_BUFFER_SIZE / 2] = "", *next_sym;
+	uint64_t addr = 0;
+	size_t reply_len = 0;
+	char *reply = NULL, *cur_sym = NULL, *next_sym;
+	const char *hex_sym;
 	struct target *target = get_target_from_connection(connection);
 	struct rtos *os = target->rtos;
 
-	reply_len = sprintf(reply, "OK");
-
 	if (!os)
 		goto done;
 
-	/* Decode any symbol name in the packet*/
-	int len = unhexify(cur_sym, strchr(packet + 8, ':') + 1, strlen(strchr(packet + 8, ':') + 1));
+	/* Decode any symbol name in the packet. The name is sized from the
+	 * packet, gdb_packet_size allows far more than GDB_BUFFER_SIZE. */
+	hex_sym = packet_size >= 8 ? strchr(packet + 8, ':') : NULL;
+	hex_sym = hex_sym ? hex_sym + 1 : "";
+	size_t sym_size = strlen(hex_sym) / 2 + 1;
+	cur_sym = malloc(sym_size);
+	if (!cur_sym) {
+		LOG_ERROR("Out of memory");
+		goto done;
+	}
+	int len = unhexify(cur_sym, hex_sym, sym_size - 1);
 	cur_sym[len] = 0;
 
 	if ((strcmp(packet, "qSymbol::") != 0) &&               /* GDB is not offering symbol lookup for the first time */
@@ -241,16 +249,27 @@ int rtos_qsymbol(struct connection *connection, char *packet, int packet_size)
 		}
 	}
 
-	if (8 + (strlen(next_sym) * 2) + 1 > sizeof(reply)) {
+	reply_len = 8 + strlen(next_sym) * 2;
+	if (reply_len + 1 > GDB_BUFFER_SIZE) {
 		LOG_ERROR("ERROR: RTOS symbol '%s' name is too long for GDB!", next_sym);
 		goto done;
 	}
 
-	reply_len = snprintf(reply, sizeof(reply), "qSymbol:");
-	reply_len += hexify(reply + reply_len, next_sym, 0, sizeof(reply) - reply_len);
+	reply = malloc(reply_len + 1);
+	if (!reply) {
+		LOG_ERROR("Out of memory");
+		goto done;
+	}
+	strcpy(reply, "qSymbol:");
+	hexify(reply + 8, next_sym, 0, reply_len + 1 - 8);
 
 done:
-	gdb_put_packet(connection, reply, reply_len);
+	if (reply)
+		gdb_put_packet(connection, reply, reply_len);
+	else
+		gdb_put_packet(connection, "OK", 2);
+	free(reply);
+	free(cur_sym);
 	return rtos_detected;
 }
 
@@ -65,14 +65,28 @@ struct target_desc_format {
 	uint32_t tdesc_length;
 };
 
+/* vFlashWrite data not yet handed to flash_write() */
+struct gdb_vflash_stream {
+	uint8_t *buffer;
+	uint32_t address;	/* target address of buffer[0] */
+	uint32_t size;		/* bytes held in buffer */
+	uint32_t alloc;
+	uint32_t written;	/* bytes programmed in this session */
+	bool started;		/* TARGET_EVENT_GDB_FLASH_WRITE_START sent */
+	int error;		/* deferred flash_write() result */
+};
+
 /* private connection data for GDB */
 struct gdb_connection {
-	char buffer[GDB_BUFFER_SIZE];
+	char *buffer;		/* raw bytes received from gdb */
+	char *packet;		/* unescaped packet being processed */
+	int buffer_size;	/* size of both, PacketSize + 1 */
 	char *buf_p;
 	int buf_cnt;
 	int ctrl_c;
 	enum target_state frontend_state;
 	struct image *vflash_image;
+	struct gdb_vflash_stream vflash_stream;
 	int closed;
 	int busy;
 	int noack_mode;
@@ -104,6 +118,7 @@ static int gdb_breakpoint_override;
 static enum breakpoint_type gdb_breakpoint_override_type;
 
 static int gdb_error(struct connection *connection, int retval);
+static int gdb_vflash_stream_done(struct connection *connection);
 static char *gdb_port;
 static char *gdb_port_next;
 
@@ -120,6 +135,15 @@ int gdb_actual_connections;
 static int gdb_use_memory_map = 1;
 /* enabled by default*/
 static int gdb_flash_program = 1;
+/* program vFlashWrite data a sector at a time as it arrives instead of
+ * all at once on vFlashDone, disabled by default */
+static int gdb_flash_stream;
+
+/* size of the packet buffers for new connections, see gdb_packet_size */
+static int gdb_buffer_size = GDB_BUFFER_SIZE;
+
+/* without sector information, stream to flash in chunks of this size */
+#define GDB_VFLASH_CHUNK	(64 * 1024)
 
 /* if set, data aborts cause an error to be reported in memory read packets
  * see the code in gdb_read_memory_packet() for further explanations.
@@ -202,14 +226,14 @@ static int gdb_get_char_inner(struct connection *connection, int *next_char)
 #endif
 	for (;; ) {
 		if (connection->service->type != CONNECTION_TCP)
-			gdb_con->buf_cnt = read(connection->fd, gdb_con->buffer, GDB_BUFFER_SIZE);
+			gdb_con->buf_cnt = read(connection->fd, gdb_con->buffer, gdb_con->buffer_size);
 		else {
 			retval = check_pending(connection, 1, NULL);
 			if (retval != ERROR_OK)
 				return retval;
 			gdb_con->buf_cnt = read_socket(connection->fd,
 					gdb_con->buffer,
-					GDB_BUFFER_SIZE);
+					gdb_con->buffer_size);
 		}
 
 		if (gdb_con->buf_cnt > 0)
@@ -915,11 +939,23 @@ static int gdb_new_connection(struct connection *connection)
 	connection->priv = gdb_connection;
 
 	/* initialize gdb connection information */
+	gdb_connection->buffer_size = gdb_buffer_size;
+	gdb_connection->buffer = malloc(gdb_connection->buffer_size);
+	gdb_connection->packet = malloc(gdb_connection->buffer_size);
+	if (gdb_connection->buffer == NULL || gdb_connection->packet == NULL) {
+		LOG_ERROR("Out of memory for GDB packet buffers");
+		free(gdb_connection->buffer);
+		free(gdb_connection->packet);
+		free(gdb_connection);
+		connection->priv = NULL;
+		return ERROR_FAIL;
+	}
 	gdb_connection->buf_p = gdb_connection->buffer;
 	gdb_connection->buf_cnt = 0;
 	gdb_connection->ctrl_c = 0;
 	gdb_connection->frontend_state = TARGET_HALTED;
 	gdb_connection->vflash_image = NULL;
+	memset(&gdb_connection->vflash_stream, 0, sizeof(gdb_connection->vflash_stream));
 	gdb_connection->closed = 0;
 	gdb_connection->busy = 0;
 	gdb_connection->noack_mode = 0;
@@ -1017,11 +1053,22 @@ static int gdb_connection_closed(struct connection *connection)
 		free(gdb_connection->vflash_image);
 		gdb_connection->vflash_image = NULL;
 	}
+	/* program what was acknowledged already and end the flash session */
+	if (gdb_connection->vflash_stream.size || gdb_connection->vflash_stream.started) {
+		int retval = gdb_vflash_stream_done(connection);
+		if (retval != ERROR_OK)
+			LOG_ERROR("GDB closed during a vFlash session, flash write failed");
+	} else {
+		free(gdb_connection->vflash_stream.buffer);
+		gdb_connection->vflash_stream.buffer = NULL;
+	}
 
 	/* if this connection registered a debug-message receiver delete it */
 	delete_debug_msg_receiver(connection->cmd_ctx, gdb_service->target);
 
 	if (connection->priv) {
+		free(gdb_connection->buffer);
+		free(gdb_connection->packet);
 		free(connection->priv);
 		connection->priv = NULL;
 	} else
@@ -1095,7 +1142,7 @@ static void gdb_str_to_target(struct target *target,
 
 	for (i = 0; i < buf_len; i++) {
 		int j = gdb_reg_pos(target, i, buf_len);
-		tstr += sprintf(tstr, "%02x", buf[j]);
+		tstr += hexify(tstr, (const char *)&buf[j], 1, 3);
 	}
 }
 
@@ -1110,14 +1157,11 @@ static void gdb_target_to_reg(struct target *target,
 
 	int i;
 	for (i = 0; i < str_len; i += 2) {
-		unsigned t;
-		if (sscanf(tstr + i, "%02x", &t) != 1) {
+		int j = gdb_reg_pos(target, i/2, str_len/2);
+		if (unhexify((char *)&bin[j], tstr + i, 1) != 1) {
 			LOG_ERROR("BUG: unable to convert register value");
 			exit(-1);
 		}
-
-		int j = gdb_reg_pos(target, i/2, str_len/2);
-		bin[j] = t;
 	}
 }
 
@@ -1210,8 +1254,11 @@ static int gdb_set_registers_packet(struct connection *connection,
 		uint8_t *bin_buf;
 		int chars = (DIV_ROUND_UP(reg_list[i]->size, 8) * 2);
 
-		if (packet_p + chars > packet + packet_size)
-			LOG_ERROR("BUG: register packet is too small for registers");
+		if (packet_p + chars > packet + packet_size) {
+			LOG_ERROR("register packet is too small for registers, dropping connection");
+			free(reg_list);
+			return ERROR_SERVER_REMOTE_CLOSED;
+		}
 
 		bin_buf = malloc(DIV_ROUND_UP(reg_list[i]->size, 8));
 		gdb_target_to_reg(target, packet_p, chars, bin_buf);
@@ -1366,7 +1413,7 @@ static int gdb_read_memory_packet(struct connection *connection,
 
 	LOG_DEBUG("addr: 0x%8.8" PRIx32 ", len: 0x%8.8" PRIx32 "", addr, len);
 
-	retval = target_read_buffer(target, addr, len, buffer);
+	retval = target_read_buffer_cached(target, addr, len, buffer);
 
 	if ((retval != ERROR_OK) && !gdb_report_data_abort) {
 		/* TODO : Here we have to lie and send back all zero's lest stack traces won't work.
@@ -1430,6 +1477,12 @@ static int gdb_write_memory_packet(struct connection *connection,
 		return ERROR_SERVER_REMOTE_CLOSED;
 	}
 
+	/* the data must be in the packet, this also bounds the allocation */
+	if (strlen(separator) < 2 * (size_t)len) {
+		LOG_ERROR("incomplete write memory packet received, dropping connection");
+		return ERROR_SERVER_REMOTE_CLOSED;
+	}
+
 	buffer = malloc(len);
 
 	LOG_DEBUG("addr: 0x%8.8" PRIx32 ", len: 0x%8.8" PRIx32 "", addr, len);
@@ -2339,7 +2392,7 @@ static int gdb_query_packet(struct connection *connection,
 			&pos,
 			&size,
 			"PacketSize=%x;qXfer:memory-map:read%c;qXfer:features:read%c;QStartNoAckMode+",
-			(GDB_BUFFER_SIZE - 1),
+			(((struct gdb_connection *)connection->priv)->buffer_size - 1),
 			((gdb_use_memory_map == 1) && (flash_get_bank_count() > 0)) ? '+' : '-',
 			(gdb_target_desc_supported == 1) ? '+' : '-');
 
@@ -2397,6 +2450,163 @@ static int gdb_query_packet(struct connection *connection,
 	return ERROR_OK;
 }
 
+/* find the flash sector holding addr, false if there is none */
+static bool gdb_vflash_sector(struct target *target, uint32_t addr,
+		struct flash_bank **bank, uint32_t *start, uint32_t *end)
+{
+	int i;
+
+	if (get_flash_bank_by_addr(target, addr, false, bank) != ERROR_OK || *bank == NULL)
+		return false;
+
+	for (i = 0; i < (*bank)->num_sectors; i++) {
+		*start = (*bank)->base + (*bank)->sectors[i].offset;
+		*end = *start + (*bank)->sectors[i].size;
+		if (addr >= *start && addr < *end)
+			return true;
+	}
+	return false;
+}
+
+/* program the first len bytes of the vFlash stream and drop them */
+static int gdb_vflash_stream_flush(struct connection *connection, uint32_t len)
+{
+	struct gdb_connection *gdb_connection = connection->priv;
+	struct gdb_service *gdb_service = connection->service->priv;
+	struct gdb_vflash_stream *stream = &gdb_connection->vflash_stream;
+	struct image image;
+	uint32_t written = 0;
+	int retval;
+
+	if (len == 0)
+		return ERROR_OK;
+
+	if (!stream->started) {
+		target_call_event_callbacks(gdb_service->target,
+				TARGET_EVENT_GDB_FLASH_WRITE_START);
+		stream->started = true;
+	}
+
+	retval = image_open(&image, "", "build");
+	if (retval != ERROR_OK)
+		return retval;
+	retval = image_add_section(&image, stream->address, len, 0x0, stream->buffer);
+	if (retval == ERROR_OK)
+		retval = flash_write(gdb_service->target, &image, &written, 0);
+	image_close(&image);
+
+	stream->written += written;
+	stream->size -= len;
+	stream->address += len;
+	memmove(stream->buffer, stream->buffer + len, stream->size);
+
+	return retval;
+}
+
+/* end the vFlash session, returns the first error seen during it */
+static int gdb_vflash_stream_done(struct connection *connection)
+{
+	struct gdb_connection *gdb_connection = connection->priv;
+	struct gdb_service *gdb_service = connection->service->priv;
+	struct gdb_vflash_stream *stream = &gdb_connection->vflash_stream;
+	int retval = stream->error;
+
+	if (retval == ERROR_OK)
+		retval = gdb_vflash_stream_flush(connection, stream->size);
+
+	if (stream->started)
+		target_call_event_callbacks(gdb_service->target,
+				TARGET_EVENT_GDB_FLASH_WRITE_END);
+
+	LOG_DEBUG("wrote %u bytes from vFlash stream to flash", (unsigned)stream->written);
+
+	free(stream->buffer);
+	memset(stream, 0, sizeof(*stream));
+	return retval;
+}
+
+static void gdb_vflash_send_error(struct connection *connection, int retval)
+{
+	if (retval == ERROR_FLASH_DST_OUT_OF_BANK)
+		gdb_put_packet(connection, "E.memtype", 9);
+	else
+		gdb_send_error(connection, EIO);
+}
+
+/*
+ * Queue vFlashWrite data and program every sector that is complete. The
+ * packet is acknowledged before programming, so that GDB sends the next
+ * one while the flash is busy. A programming error is reported on the
+ * next vFlashWrite or vFlashDone, like memory write errors are.
+ */
+static int gdb_vflash_stream_write(struct connection *connection,
+		uint32_t addr, uint32_t length, const uint8_t *data)
+{
+	struct gdb_connection *gdb_connection = connection->priv;
+	struct gdb_service *gdb_service = connection->service->priv;
+	struct gdb_vflash_stream *stream = &gdb_connection->vflash_stream;
+	struct flash_bank *bank;
+	uint32_t start, end, pad = 0;
+	int retval;
+
+	if (stream->error != ERROR_OK) {
+		retval = gdb_vflash_stream_done(connection);
+		gdb_vflash_send_error(connection, retval);
+		return ERROR_OK;
+	}
+
+	/* data must follow what is queued, small gaps inside the same
+	 * sector are padded like flash_write() does */
+	if (stream->size && addr != stream->address + stream->size) {
+		uint32_t queued_end = stream->address + stream->size;
+		if (addr > queued_end &&
+				gdb_vflash_sector(gdb_service->target, queued_end, &bank, &start, &end) &&
+				addr < end)
+			pad = addr - queued_end;
+		else {
+			retval = gdb_vflash_stream_flush(connection, stream->size);
+			if (retval != ERROR_OK) {
+				gdb_vflash_stream_done(connection);
+				gdb_vflash_send_error(connection, retval);
+				return ERROR_OK;
+			}
+		}
+	}
+	if (stream->size == 0)
+		stream->address = addr;
+
+	if (stream->size + pad + length > stream->alloc) {
+		uint32_t alloc = stream->size + pad + length;
+		uint8_t *buffer = realloc(stream->buffer, alloc);
+		if (buffer == NULL) {
+			LOG_ERROR("Out of memory for vFlash data");
+			gdb_vflash_stream_done(connection);
+			gdb_send_error(connection, ENOMEM);
+			return ERROR_OK;
+		}
+		stream->buffer = buffer;
+		stream->alloc = alloc;
+	}
+	if (pad) {
+		memset(stream->buffer + stream->size, bank->default_padded_value, pad);
+		stream->size += pad;
+	}
+	memcpy(stream->buffer + stream->size, data, length);
+	stream->size += length;
+
+	gdb_put_packet(connection, "OK", 2);
+
+	/* program everything up to the start of the sector still being filled */
+	end = stream->address + stream->size;
+	if (gdb_vflash_sector(gdb_service->target, end, &bank, &start, &end)) {
+		if (start > stream->address)
+			stream->error = gdb_vflash_stream_flush(connection, start - stream->address);
+	} else if (stream->size >= GDB_VFLASH_CHUNK)
+		stream->error = gdb_vflash_stream_flush(connection, stream->size);
+
+	return ERROR_OK;
+}
+
 static int gdb_v_packet(struct connection *connection,
 		char *packet, int packet_size)
 {
@@ -2484,6 +2694,9 @@ static int gdb_v_packet(struct connection *connection,
 		}
 		length = packet_size - (parse - packet);
 
+		if (gdb_flash_stream)
+			return gdb_vflash_stream_write(connection, addr, length, (uint8_t *)parse);
+
 		/* create a new image if there isn't already one */
 		if (gdb_connection->vflash_image == NULL) {
 			gdb_connection->vflash_image = malloc(sizeof(struct image));
@@ -2504,18 +2717,24 @@ static int gdb_v_packet(struct connection *connection,
 	if (strncmp(packet, "vFlashDone", 10) == 0) {
 		uint32_t written;
 
+		if (gdb_connection->vflash_image == NULL) {
+			result = gdb_vflash_stream_done(connection);
+			if (result != ERROR_OK)
+				gdb_vflash_send_error(connection, result);
+			else
+				gdb_put_packet(connection, "OK", 2);
+			return ERROR_OK;
+		}
+
 		/* process the flashing buffer. No need to erase as GDB
 		 * always issues a vFlashErase first. */
 		target_call_event_callbacks(gdb_service->target,
 				TARGET_EVENT_GDB_FLASH_WRITE_START);
 		result = flash_write(gdb_service->target, gdb_connection->vflash_image, &written, 0);
 		target_call_event_callbacks(gdb_service->target, TARGET_EVENT_GDB_FLASH_WRITE_END);
-		if (result != ERROR_OK) {
-			if (result == ERROR_FLASH_DST_OUT_OF_BANK)
-				gdb_put_packet(connection, "E.memtype", 9);
-			else
-				gdb_send_error(connection, EIO);
-		} else {
+		if (result != ERROR_OK)
+			gdb_vflash_send_error(connection, result);
+		else {
 			LOG_DEBUG("wrote %u bytes from vFlash image to flash", (unsigned)written);
 			gdb_put_packet(connection, "OK", 2);
 		}
@@ -2611,15 +2830,12 @@ static void gdb_sig_halted(struct connection *connection)
 
 static int gdb_input_inner(struct connection *connection)
 {
-	/* Do not allocate this on the stack */
-	static char gdb_packet_buffer[GDB_BUFFER_SIZE];
-
 	struct gdb_service *gdb_service = connection->service->priv;
 	struct target *target = gdb_service->target;
-	char *packet = gdb_packet_buffer;
+	struct gdb_connection *gdb_con = connection->priv;
+	char *packet = gdb_con->packet;
 	int packet_size;
 	int retval;
-	struct gdb_connection *gdb_con = connection->priv;
 	static int extended_protocol;
 
 	/* drain input buffer. If one of the packets fail, then an error
@@ -2634,7 +2850,7 @@ static int gdb_input_inner(struct connection *connection)
 	 * drain the rest of the buffer.
 	 */
 	do {
-		packet_size = GDB_BUFFER_SIZE-1;
+		packet_size = gdb_con->buffer_size - 1;
 		retval = gdb_get_packet(connection, packet, &packet_size);
 		if (retval != ERROR_OK)
 			return retval;
@@ -2989,6 +3205,36 @@ COMMAND_HANDLER(handle_gdb_flash_program_command)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(handle_gdb_packet_size_command)
+{
+	int size;
+
+	if (CMD_ARGC == 0) {
+		command_print(CMD_CTX, "%d", gdb_buffer_size - 1);
+		return ERROR_OK;
+	}
+	if (CMD_ARGC != 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	COMMAND_PARSE_NUMBER(int, CMD_ARGV[0], size);
+	if (size < GDB_BUFFER_SIZE_MIN - 1 || size > GDB_BUFFER_SIZE_MAX - 1) {
+		LOG_ERROR("packet size must be between %d and %d bytes",
+				GDB_BUFFER_SIZE_MIN - 1, GDB_BUFFER_SIZE_MAX - 1);
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+	gdb_buffer_size = size + 1;
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_gdb_flash_stream_command)
+{
+	if (CMD_ARGC != 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	COMMAND_PARSE_ENABLE(CMD_ARGV[0], gdb_flash_stream);
+	return ERROR_OK;
+}
+
 COMMAND_HANDLER(handle_gdb_report_data_abort_command)
 {
 	if (CMD_ARGC != 1)
@@ -3112,6 +3358,22 @@ static const struct command_registration gdb_command_handlers[] = {
 		.help = "enable or disable flash program",
 		.usage = "('enable'|'disable')"
 	},
+	{
+		.name = "gdb_packet_size",
+		.handler = handle_gdb_packet_size_command,
+		.mode = COMMAND_ANY,
+		.help = "display or set the maximum packet size advertised to "
+			"new GDB connections",
+		.usage = "[bytes]"
+	},
+	{
+		.name = "gdb_flash_stream",
+		.handler = handle_gdb_flash_stream_command,
+		.mode = COMMAND_ANY,
+		.help = "enable or disable programming flash while GDB is "
+			"still sending vFlashWrite data",
+		.usage = "('enable'|'disable')"
+	},
 	{
 		.name = "gdb_report_data_abort",
 		.handler = handle_gdb_report_data_abort_command,
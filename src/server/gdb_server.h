@@ -35,6 +35,9 @@ struct reg;
 #include <target/target.h>
 
 #define GDB_BUFFER_SIZE 16384
+/* limits of the per connection packet buffer, see gdb_packet_size */
+#define GDB_BUFFER_SIZE_MIN 1024
+#define GDB_BUFFER_SIZE_MAX (512 * 1024)
 
 int gdb_target_add_all(struct target *target);
 int gdb_register_commands(struct command_context *command_context);
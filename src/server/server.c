@@ -41,11 +41,128 @@
 #include <netinet/tcp.h>
 #endif
 
+#if defined(HAVE_SYS_EPOLL_H) && defined(HAVE_SYS_TIMERFD_H)
+#define USE_EPOLL
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#endif
+
 static struct service *services;
 
 /* shutdown_openocd == 1: exit the main event loop, and quit the debugger */
 static int shutdown_openocd;
 
+#ifdef USE_EPOLL
+/* longest sleep, also bounds the latency of jim events and keep_alive() */
+#define SERVER_MAX_SLEEP_US		100000
+#define SERVER_MAX_EVENTS		32
+
+/* what a watched fd belongs to, indexed by fd */
+struct watched_fd {
+	bool watched;
+	struct service *service;	/* listener when connection is NULL */
+	struct connection *connection;
+};
+
+static int epoll_fd = -1;
+static int timer_fd = -1;
+static struct watched_fd *watched_fds;
+static int num_watched_fds;
+
+/* cleared if epoll can't be used, server_loop() then falls back to select() */
+static bool use_epoll = true;
+
+static void server_epoll_disable(const char *what)
+{
+	LOG_DEBUG("%s failed (%s), using select()", what, strerror(errno));
+	use_epoll = false;
+}
+
+static int server_epoll_setup(void)
+{
+	struct epoll_event ev;
+
+	if (epoll_fd != -1)
+		return ERROR_OK;
+
+	epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if (epoll_fd == -1) {
+		server_epoll_disable("epoll_create1");
+		return ERROR_FAIL;
+	}
+
+	timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (timer_fd == -1) {
+		server_epoll_disable("timerfd_create");
+		return ERROR_FAIL;
+	}
+
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.fd = timer_fd;
+	if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, timer_fd, &ev) == -1) {
+		server_epoll_disable("epoll_ctl");
+		return ERROR_FAIL;
+	}
+
+	return ERROR_OK;
+}
+
+/* start watching fd, or just update its owner if it is watched already */
+static void server_watch_fd(int fd, struct service *service, struct connection *connection)
+{
+	struct epoll_event ev;
+
+	if (!use_epoll || fd < 0)
+		return;
+	if (server_epoll_setup() != ERROR_OK)
+		return;
+
+	if (fd >= num_watched_fds) {
+		int n = fd + 16;
+		struct watched_fd *w = realloc(watched_fds, n * sizeof(*w));
+		if (w == NULL) {
+			server_epoll_disable("realloc");
+			return;
+		}
+		memset(&w[num_watched_fds], 0, (n - num_watched_fds) * sizeof(*w));
+		watched_fds = w;
+		num_watched_fds = n;
+	}
+
+	if (!watched_fds[fd].watched) {
+		memset(&ev, 0, sizeof(ev));
+		ev.events = EPOLLIN;
+		ev.data.fd = fd;
+		/* fails e.g. for stdin redirected from a regular file */
+		if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+			server_epoll_disable("epoll_ctl");
+			return;
+		}
+		watched_fds[fd].watched = true;
+	}
+	watched_fds[fd].service = service;
+	watched_fds[fd].connection = connection;
+}
+
+static void server_unwatch_fd(int fd)
+{
+	if (fd < 0 || fd >= num_watched_fds || !watched_fds[fd].watched)
+		return;
+
+	epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+	memset(&watched_fds[fd], 0, sizeof(watched_fds[fd]));
+}
+#else
+static inline void server_watch_fd(int fd, struct service *service, struct connection *connection)
+{
+}
+
+static inline void server_unwatch_fd(int fd)
+{
+}
+#endif
+
 static int add_connection(struct service *service, struct command_context *cmd_ctx)
 {
 	socklen_t address_size;
@@ -104,6 +221,7 @@ static int add_connection(struct service *service, struct command_context *cmd_c
 		LOG_INFO("accepting '%s' connection from pipe", service->name);
 		retval = service->new_connection(c);
 		if (retval != ERROR_OK) {
+			server_unwatch_fd(c->fd);
 			LOG_ERROR("attempted '%s' connection rejected", service->name);
 			command_done(c->cmd_ctx);
 			free(c);
@@ -125,6 +243,7 @@ static int add_connection(struct service *service, struct command_context *cmd_c
 		LOG_INFO("accepting '%s' connection from pipe %s", service->name, service->port);
 		retval = service->new_connection(c);
 		if (retval != ERROR_OK) {
+			server_unwatch_fd(c->fd);
 			LOG_ERROR("attempted '%s' connection rejected", service->name);
 			command_done(c->cmd_ctx);
 			free(c);
@@ -137,6 +256,8 @@ static int add_connection(struct service *service, struct command_context *cmd_c
 		;
 	*p = c;
 
+	server_watch_fd(c->fd, service, c);
+
 	service->max_connections--;
 
 	return ERROR_OK;
@@ -151,12 +272,15 @@ static int remove_connection(struct service *service, struct connection *connect
 	while ((c = *p)) {
 		if (c->fd == connection->fd) {
 			service->connection_closed(c);
-			if (service->type == CONNECTION_TCP)
+			if (service->type == CONNECTION_TCP) {
+				server_unwatch_fd(c->fd);
 				close_socket(c->fd);
-			else if (service->type == CONNECTION_PIPE) {
+			} else if (service->type == CONNECTION_PIPE) {
 				/* The service will listen to the pipe again */
 				c->service->fd = c->fd;
-			}
+				server_watch_fd(c->fd, c->service, NULL);
+			} else
+				server_unwatch_fd(c->fd);
 
 			command_done(c->cmd_ctx);
 
@@ -291,6 +415,8 @@ int add_service(char *name,
 		;
 	*p = c;
 
+	server_watch_fd(c->fd, c, NULL);
+
 	return ERROR_OK;
 }
 
@@ -306,8 +432,10 @@ static int remove_services(void)
 			free(c->name);
 
 		if (c->type == CONNECTION_PIPE) {
-			if (c->fd != -1)
+			if (c->fd != -1) {
+				server_unwatch_fd(c->fd);
 				close(c->fd);
+			}
 		}
 		if (c->port)
 			free(c->port);
@@ -327,7 +455,45 @@ static int remove_services(void)
 	return ERROR_OK;
 }
 
-int server_loop(struct command_context *command_context)
+static void server_accept(struct service *service, struct command_context *command_context)
+{
+	if (service->max_connections > 0)
+		add_connection(service, command_context);
+	else {
+		if (service->type == CONNECTION_TCP) {
+			struct sockaddr_in sin;
+			socklen_t address_size = sizeof(sin);
+			int tmp_fd;
+			tmp_fd = accept(service->fd,
+					(struct sockaddr *)&service->sin,
+					&address_size);
+			close_socket(tmp_fd);
+		}
+		LOG_INFO(
+			"rejected '%s' connection, no more connections allowed",
+			service->name);
+	}
+}
+
+/* returns ERROR_OK if the connection is still open */
+static int server_input(struct service *service, struct connection *c)
+{
+	int retval = service->input(c);
+	if (retval != ERROR_OK) {
+		if (service->type == CONNECTION_PIPE ||
+				service->type == CONNECTION_STDINOUT) {
+			/* if connection uses a pipe then
+			 * shutdown openocd on error */
+			shutdown_openocd = 1;
+		}
+		remove_connection(service, c);
+		LOG_INFO("dropped '%s' connection",
+			service->name);
+	}
+	return retval;
+}
+
+static int server_loop_select(struct command_context *command_context)
 {
 	struct service *service;
 
@@ -340,11 +506,6 @@ int server_loop(struct command_context *command_context)
 	/* used in accept() */
 	int retval;
 
-#ifndef _WIN32
-	if (signal(SIGPIPE, SIG_IGN) == SIG_ERR)
-		LOG_ERROR("couldn't set SIGPIPE to SIG_IGN");
-#endif
-
 	while (!shutdown_openocd) {
 		/* monitor sockets for activity */
 		fd_max = 0;
@@ -437,48 +598,18 @@ int server_loop(struct command_context *command_context)
 		for (service = services; service; service = service->next) {
 			/* handle new connections on listeners */
 			if ((service->fd != -1)
-			    && (FD_ISSET(service->fd, &read_fds))) {
-				if (service->max_connections > 0)
-					add_connection(service, command_context);
-				else {
-					if (service->type == CONNECTION_TCP) {
-						struct sockaddr_in sin;
-						socklen_t address_size = sizeof(sin);
-						int tmp_fd;
-						tmp_fd = accept(service->fd,
-								(struct sockaddr *)&service->sin,
-								&address_size);
-						close_socket(tmp_fd);
-					}
-					LOG_INFO(
-						"rejected '%s' connection, no more connections allowed",
-						service->name);
-				}
-			}
+			    && (FD_ISSET(service->fd, &read_fds)))
+				server_accept(service, command_context);
 
 			/* handle activity on connections */
 			if (service->connections) {
 				struct connection *c;
 
 				for (c = service->connections; c; ) {
-					if ((FD_ISSET(c->fd, &read_fds)) || c->input_pending) {
-						retval = service->input(c);
-						if (retval != ERROR_OK) {
-							struct connection *next = c->next;
-							if (service->type == CONNECTION_PIPE ||
-									service->type == CONNECTION_STDINOUT) {
-								/* if connection uses a pipe then
-								 * shutdown openocd on error */
-								shutdown_openocd = 1;
-							}
-							remove_connection(service, c);
-							LOG_INFO("dropped '%s' connection",
-								service->name);
-							c = next;
-							continue;
-						}
-					}
-					c = c->next;
+					struct connection *next = c->next;
+					if ((FD_ISSET(c->fd, &read_fds)) || c->input_pending)
+						server_input(service, c);
+					c = next;
 				}
 			}
 		}
@@ -495,6 +626,165 @@ int server_loop(struct command_context *command_context)
 	return ERROR_OK;
 }
 
+#ifdef USE_EPOLL
+/* microseconds until the next timer callback is due, capped to the
+ * longest sleep we allow, 0 if it is due already */
+static int64_t server_timer_remaining_us(void)
+{
+	struct timeval now, when;
+	int64_t us;
+
+	if (target_timer_next_callback(&when) != ERROR_OK)
+		return SERVER_MAX_SLEEP_US;
+
+	gettimeofday(&now, NULL);
+	us = (int64_t)(when.tv_sec - now.tv_sec) * 1000000 +
+		(when.tv_usec - now.tv_usec);
+	if (us < 0)
+		return 0;
+	if (us > SERVER_MAX_SLEEP_US)
+		return SERVER_MAX_SLEEP_US;
+	return us;
+}
+
+static bool server_input_pending(void)
+{
+	struct service *service;
+	struct connection *c;
+
+	for (service = services; service; service = service->next) {
+		for (c = service->connections; c; c = c->next) {
+			if (c->input_pending)
+				return true;
+		}
+	}
+	return false;
+}
+
+/*
+ * Same policy as server_loop_select(): poll while there is activity and
+ * run the timer callbacks and jim events when idle. Sleeping is done on
+ * a timerfd armed for the next timer callback deadline rather than a
+ * fixed 100ms select() timeout, and only fds with activity are visited.
+ */
+static int server_loop_epoll(struct command_context *command_context)
+{
+	struct epoll_event events[SERVER_MAX_EVENTS];
+	struct watched_fd *w;
+	bool poll_ok = true;
+	int i, n, active;
+
+	while (!shutdown_openocd) {
+		int timeout = 0;
+
+		if (!use_epoll)
+			return server_loop_select(command_context);
+
+		if (!poll_ok && !server_input_pending()) {
+			int64_t us = server_timer_remaining_us();
+			if (us > 0) {
+				struct itimerspec its;
+				memset(&its, 0, sizeof(its));
+				its.it_value.tv_sec = us / 1000000;
+				its.it_value.tv_nsec = (us % 1000000) * 1000;
+				if (timerfd_settime(timer_fd, 0, &its, NULL) == 0)
+					timeout = -1;
+				else
+					timeout = (us + 999) / 1000;
+			}
+		}
+
+		if (timeout) {
+			/* Only while we're sleeping we'll let others run */
+			openocd_sleep_prelude();
+			kept_alive();
+			n = epoll_wait(epoll_fd, events, SERVER_MAX_EVENTS, timeout);
+			openocd_sleep_postlude();
+		} else
+			n = epoll_wait(epoll_fd, events, SERVER_MAX_EVENTS, 0);
+
+		if (n == -1) {
+			if (errno != EINTR) {
+				LOG_ERROR("error during epoll_wait: %s", strerror(errno));
+				exit(-1);
+			}
+			n = 0;
+		}
+
+		/* connections first, so that an fd closed here can't be reused
+		 * by a connection accepted in the same round */
+		active = 0;
+		for (i = 0; i < n; i++) {
+			int fd = events[i].data.fd;
+			if (fd == timer_fd) {
+				uint64_t expirations;
+				if (read(timer_fd, &expirations, sizeof(expirations)) < 0)
+					LOG_DEBUG("timerfd read: %s", strerror(errno));
+				continue;
+			}
+			active++;
+			if (fd >= num_watched_fds)
+				continue;
+			w = &watched_fds[fd];
+			if (w->watched && w->connection)
+				server_input(w->service, w->connection);
+		}
+		for (i = 0; i < n; i++) {
+			int fd = events[i].data.fd;
+			if (fd == timer_fd || fd >= num_watched_fds)
+				continue;
+			w = &watched_fds[fd];
+			if (w->watched && !w->connection && w->service->fd == fd)
+				server_accept(w->service, command_context);
+		}
+
+		if (server_input_pending()) {
+			struct service *service;
+			for (service = services; service; service = service->next) {
+				struct connection *c;
+				for (c = service->connections; c; ) {
+					struct connection *next = c->next;
+					if (c->input_pending)
+						server_input(service, c);
+					c = next;
+				}
+			}
+		}
+
+		if (!active) {
+			/* nothing to do or the timer fired */
+			target_call_timer_callbacks();
+			process_jim_events(command_context);
+			poll_ok = false;
+		} else {
+			/* don't let a busy connection hold off the timer callbacks */
+			if (server_timer_remaining_us() == 0)
+				target_call_timer_callbacks();
+			poll_ok = true;
+		}
+
+		/* This greatly improves performance of DCC. */
+		poll_ok = poll_ok || target_got_message();
+	}
+
+	return ERROR_OK;
+}
+#endif
+
+int server_loop(struct command_context *command_context)
+{
+#ifndef _WIN32
+	if (signal(SIGPIPE, SIG_IGN) == SIG_ERR)
+		LOG_ERROR("couldn't set SIGPIPE to SIG_IGN");
+#endif
+
+#ifdef USE_EPOLL
+	if (use_epoll && server_epoll_setup() == ERROR_OK)
+		return server_loop_epoll(command_context);
+#endif
+	return server_loop_select(command_context);
+}
+
 #ifdef _WIN32
 BOOL WINAPI ControlHandler(DWORD dwCtrlType)
 {
@@ -550,6 +840,18 @@ int server_quit(void)
 {
 	remove_services();
 
+#ifdef USE_EPOLL
+	if (timer_fd != -1)
+		close(timer_fd);
+	if (epoll_fd != -1)
+		close(epoll_fd);
+	timer_fd = -1;
+	epoll_fd = -1;
+	free(watched_fds);
+	watched_fds = NULL;
+	num_watched_fds = 0;
+#endif
+
 #ifdef _WIN32
 	WSACleanup();
 	SetConsoleCtrlHandler(ControlHandler, FALSE);
@@ -64,12 +64,23 @@ static int (cmsis_dap_queue_ap_abort)(struct adiv5_dap *dap, uint8_t *ack)
 			(CMSIS_CMD_DP | CMSIS_CMD_WRITE | CMSIS_CMD_A32(DP_ABORT)), 0x1e);
 }
 
-static int cmsis_dap_queue_dp_read(struct adiv5_dap *dap, unsigned reg, uint32_t *data)
+/* Queue one register access if the driver can queue, else perform it now */
+static int cmsis_dap_queue_reg(struct adiv5_dap *dap, uint8_t cmd,
+		uint32_t *data, uint32_t value)
 {
-	LOG_DEBUG("CMSIS-ADI: cmsis_dap_queue_dp_read %d", reg);
+	const struct swd_driver *swd = jtag_interface->swd;
+	int retval;
 
-	int retval = jtag_interface->swd->read_reg(
-			(CMSIS_CMD_DP | CMSIS_CMD_READ | CMSIS_CMD_A32(reg)), data);
+	if (swd->run) {
+		if (cmd & CMSIS_CMD_READ)
+			return swd->queue_read_reg(cmd, data);
+		return swd->queue_write_reg(cmd, value);
+	}
+
+	if (cmd & CMSIS_CMD_READ)
+		retval = swd->read_reg(cmd, data);
+	else
+		retval = swd->write_reg(cmd, value);
 
 	if (retval != ERROR_OK) {
 		/* fault response */
@@ -80,11 +91,23 @@ static int cmsis_dap_queue_dp_read(struct adiv5_dap *dap, unsigned reg, uint32_t
 	return retval;
 }
 
+static int cmsis_dap_queue_dp_read(struct adiv5_dap *dap, unsigned reg, uint32_t *data)
+{
+	LOG_DEBUG("CMSIS-ADI: cmsis_dap_queue_dp_read %d", reg);
+
+	return cmsis_dap_queue_reg(dap,
+			(CMSIS_CMD_DP | CMSIS_CMD_READ | CMSIS_CMD_A32(reg)), data, 0);
+}
+
+static int cmsis_dap_run(struct adiv5_dap *dap);
+
 static int cmsis_dap_queue_idcode_read(struct adiv5_dap *dap, uint8_t *ack, uint32_t *data)
 {
 	LOG_DEBUG("CMSIS-ADI: cmsis_dap_queue_idcode_read");
 
 	int retval = cmsis_dap_queue_dp_read(dap, DP_IDCODE, data);
+	if (retval == ERROR_OK)
+		retval = cmsis_dap_run(dap);
 	if (retval != ERROR_OK)
 		return retval;
 
@@ -104,16 +127,8 @@ static int (cmsis_dap_queue_dp_write)(struct adiv5_dap *dap, unsigned reg, uint3
 		data &= ~CORUNDETECT;
 	}
 
-	int retval = jtag_interface->swd->write_reg(
-			(CMSIS_CMD_DP | CMSIS_CMD_WRITE | CMSIS_CMD_A32(reg)), data);
-
-	if (retval != ERROR_OK) {
-		/* fault response */
-		uint8_t ack = retval & 0xff;
-		cmsis_dap_queue_ap_abort(dap, &ack);
-	}
-
-	return retval;
+	return cmsis_dap_queue_reg(dap,
+			(CMSIS_CMD_DP | CMSIS_CMD_WRITE | CMSIS_CMD_A32(reg)), NULL, data);
 }
 
 /** Select the AP register bank matching bits 7:4 of reg. */
@@ -138,16 +153,8 @@ static int (cmsis_dap_queue_ap_read)(struct adiv5_dap *dap, unsigned reg, uint32
 	if (retval != ERROR_OK)
 		return retval;
 
-	retval = jtag_interface->swd->read_reg(
-			(CMSIS_CMD_AP | CMSIS_CMD_READ | CMSIS_CMD_A32(reg)), data);
-
-	if (retval != ERROR_OK) {
-		/* fault response */
-		uint8_t ack = retval & 0xff;
-		cmsis_dap_queue_ap_abort(dap, &ack);
-	}
-
-	return retval;
+	return cmsis_dap_queue_reg(dap,
+			(CMSIS_CMD_AP | CMSIS_CMD_READ | CMSIS_CMD_A32(reg)), data, 0);
 }
 
 static int (cmsis_dap_queue_ap_write)(struct adiv5_dap *dap, unsigned reg, uint32_t data)
@@ -163,16 +170,8 @@ static int (cmsis_dap_queue_ap_write)(struct adiv5_dap *dap, unsigned reg, uint3
 	if (retval != ERROR_OK)
 		return retval;
 
-	retval = jtag_interface->swd->write_reg(
-			(CMSIS_CMD_AP | CMSIS_CMD_WRITE | CMSIS_CMD_A32(reg)), data);
-
-	if (retval != ERROR_OK) {
-		/* fault response */
-		uint8_t ack = retval & 0xff;
-		cmsis_dap_queue_ap_abort(dap, &ack);
-	}
-
-	return retval;
+	return cmsis_dap_queue_reg(dap,
+			(CMSIS_CMD_AP | CMSIS_CMD_WRITE | CMSIS_CMD_A32(reg)), NULL, data);
 }
 
 static int (cmsis_dap_queue_ap_read_block)(struct adiv5_dap *dap, unsigned reg,
@@ -180,10 +179,13 @@ static int (cmsis_dap_queue_ap_read_block)(struct adiv5_dap *dap, unsigned reg,
 {
 	LOG_DEBUG("CMSIS-ADI: cmsis_dap_queue_ap_read_block 0x%08" PRIx32, blocksize);
 
-	int retval = jtag_interface->swd->read_block(
-			(CMSIS_CMD_AP | CMSIS_CMD_READ | CMSIS_CMD_A32(AP_REG_DRW)),
-			blocksize, buffer);
+	const struct swd_driver *swd = jtag_interface->swd;
+	uint8_t cmd = CMSIS_CMD_AP | CMSIS_CMD_READ | CMSIS_CMD_A32(AP_REG_DRW);
+
+	if (swd->run)
+		return swd->queue_read_block(cmd, blocksize, buffer);
 
+	int retval = swd->read_block(cmd, blocksize, buffer);
 	if (retval != ERROR_OK) {
 		/* fault response */
 		uint8_t ack = retval & 0xff;
@@ -197,9 +199,19 @@ static int (cmsis_dap_queue_ap_read_block)(struct adiv5_dap *dap, unsigned reg,
 static int cmsis_dap_run(struct adiv5_dap *dap)
 {
 	LOG_DEBUG("CMSIS-ADI: cmsis_dap_run");
-	/* FIXME: for now the CMSIS-DAP interface hard-wires a zero-size queue. */
 
-	return ERROR_OK;
+	const struct swd_driver *swd = jtag_interface->swd;
+	if (!swd->run)
+		return ERROR_OK;
+
+	int retval = swd->run();
+	if (retval != ERROR_OK) {
+		/* fault response */
+		uint8_t ack = retval & 0xff;
+		cmsis_dap_queue_ap_abort(dap, &ack);
+	}
+
+	return retval;
 }
 
 const struct dap_ops cmsis_dap_ops = {
@@ -55,6 +55,12 @@ int quark_se_arc_write_memory(struct target *t, uint32_t addr, uint32_t size,
 
 }
 
+int quark_se_arc_init_target(struct command_context *cmd_ctx, struct target *target)
+{
+	quark_se_flash_init_config(cmd_ctx->interp);
+	return arc_ocd_init_target(cmd_ctx, target);
+}
+
 int quark_se_arc_assert_reset(struct target *target)
 {
 	/* halt target before to restore memory */
@@ -109,7 +115,7 @@ struct target_type arc32_target = {
 	.commands = arc_monitor_command_handlers, /* see: arc_mntr.c|.h */
 
 	.target_create = arc_ocd_target_create,
-	.init_target = arc_ocd_init_target,
+	.init_target = quark_se_arc_init_target,
 	.examine = arc_ocd_examine,
 
 	.virt2phys = arc_mem_virt2phys,
@@ -81,7 +81,9 @@ int arc32_init_arch_info(struct target *target, struct arc32_common *arc32,
  * Read register that are used in GDB g-packet. We don't read them one-by-one,
  * but do that in one batch operation to improve speed. Calls to JTAG layer are
  * expensive so it is better to make one big call that reads all necessary
- * registers, instead of many calls, one for one register.
+ * registers, instead of many calls, one for one register. Core and AUX
+ * registers are collected into preallocated transfer plan and read with a
+ * single JTAG queue execution.
  */
 int arc32_save_context(struct target *target)
 {
@@ -89,76 +91,56 @@ int arc32_save_context(struct target *target)
 	unsigned int i;
 	struct arc32_common *arc32 = target_to_arc32(target);
 	struct reg *reg_list = arc32->core_cache->reg_list;
+	struct arc32_reg_plan *plan = &arc32->reg_plan;
+	struct duration bench;
 
 	LOG_DEBUG("-");
 	assert(reg_list);
 
+	duration_start(&bench);
+
+	/* BCRs are read only once, because they define which registers exist. */
 	if (!arc32->bcr_init)
 		arc_regs_read_bcrs(target);
 
-	/* It is assumed that there is at least one AUX register in the list, for
-	 * example PC. */
-	const uint32_t core_regs_size = ARC_REG_FIRST_AUX * sizeof(uint32_t);
 	const uint32_t regs_to_scan = (arc32->gdb_compatibility_mode ?
 			ARC_TOTAL_NUM_REGS : ARC_REG_AFTER_GDB_GENERAL);
-	const uint32_t aux_regs_size = (regs_to_scan - ARC_REG_FIRST_AUX) *
-		sizeof(uint32_t);
-	uint32_t *core_values = malloc(core_regs_size);
-	uint32_t *aux_values = malloc(aux_regs_size);
-	uint32_t *core_addrs = malloc(core_regs_size);
-	uint32_t *aux_addrs = malloc(aux_regs_size);
-	unsigned int core_cnt = 0;
-	unsigned int aux_cnt = 0;
-
-	if (!core_values || !core_addrs || !aux_values || !aux_addrs)  {
-		LOG_ERROR("Not enough memory");
-		retval = ERROR_FAIL;
-		goto exit;
-	}
-
-	memset(core_values, 0xdeadbeef, core_regs_size);
-	memset(core_addrs, 0xdeadbeef, core_regs_size);
-	memset(aux_values, 0xdeadbeef, aux_regs_size);
-	memset(aux_addrs, 0xdeadbeef, aux_regs_size);
 
+	plan->core_cnt = 0;
+	plan->aux_cnt = 0;
 	for (i = 0; i < regs_to_scan; i++) {
 		struct reg *reg = &(reg_list[i]);
 		struct arc_reg_t *arc_reg = reg->arch_info;
 		if (!reg->valid && reg->exist && !arc_reg->dummy) {
 			if (arc_reg->desc->regnum < ARC_REG_FIRST_AUX) {
 				/* core reg */
-				core_addrs[core_cnt] = arc_reg->desc->addr;
-				core_cnt += 1;
+				plan->core_addrs[plan->core_cnt] = arc_reg->desc->addr;
+				plan->core_cnt += 1;
 			} else {
 				/* aux reg */
-				aux_addrs[aux_cnt] = arc_reg->desc->addr;
-				aux_cnt += 1;
+				plan->aux_addrs[plan->aux_cnt] = arc_reg->desc->addr;
+				plan->aux_cnt += 1;
 			}
 		}
 	}
 
 	/* Read data from target. */
-	retval = arc_jtag_read_core_reg(&arc32->jtag_info, core_addrs, core_cnt, core_values);
+	retval = arc_jtag_read_regs(&arc32->jtag_info,
+			plan->core_addrs, plan->core_cnt, plan->core_values,
+			plan->aux_addrs, plan->aux_cnt, plan->aux_values);
 	if (ERROR_OK != retval) {
-		LOG_ERROR("Attempt to read core registers failed.");
-		retval = ERROR_FAIL;
-		goto exit;
-	}
-	retval = arc_jtag_read_aux_reg(&arc32->jtag_info, aux_addrs, aux_cnt, aux_values);
-	if (ERROR_OK != retval) {
-		LOG_ERROR("Attempt to read aux registers failed.");
-		retval = ERROR_FAIL;
-		goto exit;
+		LOG_ERROR("Attempt to read registers failed.");
+		return ERROR_FAIL;
 	}
 
 	/* Parse core regs */
-	core_cnt = 0;
+	uint32_t core_cnt = 0;
 	for (i = 0; i < ARC_REG_FIRST_AUX; i++) {
 		struct reg *reg = &(reg_list[i]);
 		struct arc_reg_t *arc_reg = reg->arch_info;
 		if (!reg->valid && reg->exist) {
 			if (!arc_reg->dummy) {
-				arc_reg->value = core_values[core_cnt];
+				arc_reg->value = plan->core_values[core_cnt];
 				core_cnt += 1;
 			} else {
 				arc_reg->value = 0;
@@ -172,13 +154,13 @@ int arc32_save_context(struct target *target)
 	}
 
 	/* Parse aux regs */
-	aux_cnt = 0;
+	uint32_t aux_cnt = 0;
 	for (i = ARC_REG_FIRST_AUX; i < regs_to_scan; i++) {
 		struct reg *reg = &(reg_list[i]);
 		struct arc_reg_t *arc_reg = reg->arch_info;
 		if (!reg->valid && reg->exist) {
 			if (!arc_reg->dummy) {
-				arc_reg->value = aux_values[aux_cnt];
+				arc_reg->value = plan->aux_values[aux_cnt];
 				aux_cnt += 1;
 			} else {
 				arc_reg->value = 0;
@@ -191,11 +173,13 @@ int arc32_save_context(struct target *target)
 		}
 	}
 
-exit:
-	free(core_values);
-	free(core_addrs);
-	free(aux_values);
-	free(aux_addrs);
+	if (duration_measure(&bench) == ERROR_OK) {
+		arc32->reg_stats.saves += 1;
+		arc32->reg_stats.last_save_regs = plan->core_cnt + plan->aux_cnt;
+		arc32->reg_stats.last_save_time = duration_elapsed(&bench);
+		LOG_DEBUG("Saved %" PRIu32 " registers in %fs",
+			arc32->reg_stats.last_save_regs, arc32->reg_stats.last_save_time);
+	}
 
 	return retval;
 }
@@ -211,6 +195,8 @@ int arc32_restore_context(struct target *target)
 	unsigned int i;
 	struct arc32_common *arc32 = target_to_arc32(target);
 	struct reg *reg_list = arc32->core_cache->reg_list;
+	struct arc32_reg_plan *plan = &arc32->reg_plan;
+	struct duration bench;
 
 	LOG_DEBUG("-");
 	assert(reg_list);
@@ -220,28 +206,10 @@ int arc32_restore_context(struct target *target)
 		return ERROR_FAIL;
 	}
 
-	/* It is assumed that there is at least one AUX register in the list. */
-	const uint32_t core_regs_size = ARC_REG_AFTER_CORE_EXT * sizeof(uint32_t);
-	const uint32_t aux_regs_size = (ARC_REG_AFTER_AUX - ARC_REG_FIRST_AUX) *
-		sizeof(uint32_t);
-	uint32_t *core_values = malloc(core_regs_size);
-	uint32_t *aux_values = malloc(aux_regs_size);
-	uint32_t *core_addrs = malloc(core_regs_size);
-	uint32_t *aux_addrs = malloc(aux_regs_size);
-	unsigned int core_cnt = 0;
-	unsigned int aux_cnt = 0;
-
-	if (!core_values || !core_addrs || !aux_values || !aux_addrs)  {
-		LOG_ERROR("Not enough memory");
-		retval = ERROR_FAIL;
-		goto exit;
-	}
-
-	memset(core_values, 0xdeadbeef, core_regs_size);
-	memset(core_addrs, 0xdeadbeef, core_regs_size);
-	memset(aux_values, 0xdeadbeef, aux_regs_size);
-	memset(aux_addrs, 0xdeadbeef, aux_regs_size);
+	duration_start(&bench);
 
+	plan->core_cnt = 0;
+	plan->aux_cnt = 0;
 	for (i = 0; i < ARC_REG_AFTER_AUX; i++) {
 		struct reg *reg = &(reg_list[i]);
 		struct arc_reg_t *arc_reg = reg->arch_info;
@@ -249,38 +217,33 @@ int arc32_restore_context(struct target *target)
 			LOG_DEBUG("Will write regnum=%u", i);
 			if (arc_reg->desc->regnum < ARC_REG_FIRST_AUX) {
 				/* core reg */
-				core_addrs[core_cnt] = arc_reg->desc->addr;
-				core_values[core_cnt] = arc_reg->value;
-				core_cnt += 1;
+				plan->core_addrs[plan->core_cnt] = arc_reg->desc->addr;
+				plan->core_values[plan->core_cnt] = arc_reg->value;
+				plan->core_cnt += 1;
 			} else {
 				/* aux reg */
-				aux_addrs[aux_cnt] = arc_reg->desc->addr;
-				aux_values[aux_cnt] = arc_reg->value;
-				aux_cnt += 1;
+				plan->aux_addrs[plan->aux_cnt] = arc_reg->desc->addr;
+				plan->aux_values[plan->aux_cnt] = arc_reg->value;
+				plan->aux_cnt += 1;
 			}
 		}
 	}
 
 	/* Write data to target. */
 	/* JTAG layer will return quickly if count == 0. */
-	retval = arc_jtag_write_core_reg(&arc32->jtag_info, core_addrs, core_cnt, core_values);
+	retval = arc_jtag_write_regs(&arc32->jtag_info,
+			plan->core_addrs, plan->core_cnt, plan->core_values,
+			plan->aux_addrs, plan->aux_cnt, plan->aux_values);
 	if (ERROR_OK != retval) {
-		LOG_ERROR("Attempt to write to core registers failed.");
-		retval = ERROR_FAIL;
-		goto exit;
-	}
-	retval = arc_jtag_write_aux_reg(&arc32->jtag_info, aux_addrs, aux_cnt, aux_values);
-	if (ERROR_OK != retval) {
-		LOG_ERROR("Attempt to write to aux registers failed.");
-		retval = ERROR_FAIL;
-		goto exit;
+		LOG_ERROR("Attempt to write to registers failed.");
+		return ERROR_FAIL;
 	}
 
-exit:
-	free(core_values);
-	free(core_addrs);
-	free(aux_values);
-	free(aux_addrs);
+	if (duration_measure(&bench) == ERROR_OK) {
+		arc32->reg_stats.restores += 1;
+		arc32->reg_stats.last_restore_regs = plan->core_cnt + plan->aux_cnt;
+		arc32->reg_stats.last_restore_time = duration_elapsed(&bench);
+	}
 
 	return retval;
 }
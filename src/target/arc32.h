@@ -52,6 +52,28 @@ struct arc32_comparator {
 	uint32_t reg_address;
 };
 
+/* Preallocated register transfer plan. All registers that have to be read or
+ * written are collected here, so they can be transferred with a single JTAG
+ * queue execution. */
+struct arc32_reg_plan {
+	uint32_t core_addrs[ARC_REG_FIRST_AUX];
+	uint32_t core_values[ARC_REG_FIRST_AUX];
+	uint32_t core_cnt;
+	uint32_t aux_addrs[ARC_TOTAL_NUM_REGS - ARC_REG_FIRST_AUX];
+	uint32_t aux_values[ARC_TOTAL_NUM_REGS - ARC_REG_FIRST_AUX];
+	uint32_t aux_cnt;
+};
+
+/* Register transfer statistics, updated on each context save/restore. */
+struct arc32_reg_stats {
+	uint32_t saves;
+	uint32_t restores;
+	uint32_t last_save_regs;
+	uint32_t last_restore_regs;
+	float last_save_time;		/* seconds */
+	float last_restore_time;	/* seconds */
+};
+
 struct arc32_common {
 	uint32_t common_magic;
 	void *arch_info;
@@ -90,6 +112,9 @@ struct arc32_common {
 	bool gdb_compatibility_mode;
 	/* Store values of BCR permanently. */
 	struct bcr_set_t bcr_set;
+
+	struct arc32_reg_plan reg_plan;
+	struct arc32_reg_stats reg_stats;
 };
 
 //#define ARC32_FASTDATA_HANDLER_SIZE	0x8000 /* haps51 */
@@ -162,9 +162,11 @@ static void arc_jtag_reset_transaction(struct arc_jtag *jtag_info)
 }
 
 /**
- * Write registers. addr is an array of addresses, and those addresses can be
- * in any order, though it is recommended that they are in sequential order
- * where possible, as this reduces number of JTAG commands to transfer.
+ * Queue writing of registers. addr is an array of addresses, and those
+ * addresses can be in any order, though it is recommended that they are in
+ * sequential order where possible, as this reduces number of JTAG commands to
+ * transfer. Values are converted to byte-buffers immediately, so buffer can be
+ * reused before queue is executed.
  *
  * @param jtag_info
  * @param type		Type of registers to write: core or aux.
@@ -172,10 +174,9 @@ static void arc_jtag_reset_transaction(struct arc_jtag *jtag_info)
  * @param count		Amount of registers in arrays.
  * @param values	Array of register values.
  */
-static int arc_jtag_write_registers(struct arc_jtag *jtag_info, reg_type_t type,
-	uint32_t *addr, uint32_t count, const uint32_t *buffer)
+static void arc_jtag_queue_write_registers(struct arc_jtag *jtag_info,
+	reg_type_t type, uint32_t *addr, uint32_t count, const uint32_t *buffer)
 {
-	int retval = ERROR_OK;
 	unsigned int i;
 
 	/*
@@ -194,7 +195,7 @@ static int arc_jtag_write_registers(struct arc_jtag *jtag_info, reg_type_t type,
 		(type == ARC_JTAG_CORE_REG ? "core" : "aux"), *addr, count, *buffer);
 
 	if (count == 0)
-		return retval;
+		return;
 
 	arc_jtag_reset_transaction(jtag_info);
 
@@ -219,6 +220,20 @@ static int arc_jtag_write_registers(struct arc_jtag *jtag_info, reg_type_t type,
 
 	/* Cleanup. */
 	arc_jtag_reset_transaction(jtag_info);
+}
+
+/**
+ * Write registers. See arc_jtag_queue_write_registers for details.
+ */
+static int arc_jtag_write_registers(struct arc_jtag *jtag_info, reg_type_t type,
+	uint32_t *addr, uint32_t count, const uint32_t *buffer)
+{
+	int retval = ERROR_OK;
+
+	if (count == 0)
+		return retval;
+
+	arc_jtag_queue_write_registers(jtag_info, type, addr, count, buffer);
 
 	/* Execute queue. */
 	retval = jtag_execute_queue();
@@ -232,9 +247,14 @@ static int arc_jtag_write_registers(struct arc_jtag *jtag_info, reg_type_t type,
 }
 
 /**
- * Read registers. addr is an array of addresses, and those addresses can be in
- * any order, though it is recommended that they are in sequential order where
- * possible, as this reduces number of JTAG commands to transfer.
+ * Queue reading of registers. addr is an array of addresses, and those
+ * addresses can be in any order, though it is recommended that they are in
+ * sequential order where possible, as this reduces number of JTAG commands to
+ * transfer.
+ *
+ * Registers are scanned directly into buffer, which must stay valid until
+ * queue is executed. After execution buffer contains values in little endian
+ * byte order, use arc_jtag_regs_to_host to convert them to host presentation.
  *
  * @param jtag_info
  * @param type		Type of registers to read: core or aux.
@@ -242,10 +262,9 @@ static int arc_jtag_write_registers(struct arc_jtag *jtag_info, reg_type_t type,
  * @param count		Amount of registers in arrays.
  * @param values	Array of register values.
  */
-static int arc_jtag_read_registers(struct arc_jtag *jtag_info, reg_type_t type,
-		uint32_t *addr, uint32_t count, uint32_t *buffer)
+static void arc_jtag_queue_read_registers(struct arc_jtag *jtag_info,
+	reg_type_t type, uint32_t *addr, uint32_t count, uint32_t *buffer)
 {
-	int retval = ERROR_OK;
 	uint32_t i;
 
 	assert(jtag_info != NULL);
@@ -255,7 +274,7 @@ static int arc_jtag_read_registers(struct arc_jtag *jtag_info, reg_type_t type,
 		(type == ARC_JTAG_CORE_REG ? "core" : "aux"), *addr, count);
 
 	if (count == 0)
-		return retval;
+		return;
 
 	arc_jtag_reset_transaction(jtag_info);
 
@@ -264,9 +283,6 @@ static int arc_jtag_read_registers(struct arc_jtag *jtag_info, reg_type_t type,
 			ARC_JTAG_READ_FROM_CORE_REG : ARC_JTAG_READ_FROM_AUX_REG);
 	arc_jtag_set_transaction(jtag_info, transaction, TAP_DRPAUSE);
 
-	struct scan_field *fields = calloc(sizeof(struct scan_field), count);
-	uint8_t *data_buf = calloc(sizeof(uint8_t), count * 4);
-
 	for (i = 0; i < count; i++) {
 		/* Some of registers are sequential, so we need to set address only
 		 * for the first one in sequence. */
@@ -277,11 +293,33 @@ static int arc_jtag_read_registers(struct arc_jtag *jtag_info, reg_type_t type,
 			arc_jtag_write_ir(jtag_info, ARC_DATA_REG);
 		}
 
-		arc_jtag_read_dr(jtag_info, data_buf + i * 4, TAP_IDLE);
+		arc_jtag_read_dr(jtag_info, (uint8_t *)(buffer + i), TAP_IDLE);
 	}
 
 	/* Clean up */
 	arc_jtag_reset_transaction(jtag_info);
+}
+
+/** Convert values scanned by arc_jtag_queue_read_registers in place. */
+static void arc_jtag_regs_to_host(uint32_t count, uint32_t *buffer)
+{
+	uint32_t i;
+	for (i = 0; i < count; i++)
+		buffer[i] = le_to_h_u32((uint8_t *)(buffer + i));
+}
+
+/**
+ * Read registers. See arc_jtag_queue_read_registers for details.
+ */
+static int arc_jtag_read_registers(struct arc_jtag *jtag_info, reg_type_t type,
+		uint32_t *addr, uint32_t count, uint32_t *buffer)
+{
+	int retval = ERROR_OK;
+
+	if (count == 0)
+		return retval;
+
+	arc_jtag_queue_read_registers(jtag_info, type, addr, count, buffer);
 
 	retval = jtag_execute_queue();
 	if (ERROR_OK != retval) {
@@ -291,11 +329,7 @@ static int arc_jtag_read_registers(struct arc_jtag *jtag_info, reg_type_t type,
 	}
 
 	/* Convert byte-buffers to host presentation. */
-	for (i = 0; i < count; i++) {
-		buffer[i] = buf_get_u32(data_buf + 4*i, 0, 32);
-	}
-	free(data_buf);
-	free(fields);
+	arc_jtag_regs_to_host(count, buffer);
 	LOG_DEBUG("Read from register: buf[0]=0x%" PRIx32, buffer[0]);
 
 	return retval;
@@ -440,9 +474,85 @@ int arc_jtag_write_memory(struct arc_jtag *jtag_info, uint32_t addr,
 }
 
 /**
- * Read a sequence of 4-byte words from target memory.
+ * Write a sequence of 4-byte words from byte buffer into target memory.
  *
- * We can read only 4byte words via JTAG.
+ * Each word in buffer must be in the byte order in which it is shifted into
+ * the DR, that is little-endian. Words are copied into JTAG queue directly from
+ * the buffer without any intermediate conversions. Large requests are split
+ * into chunks of ARC_JTAG_WRITE_CHUNK_WORDS.
+ *
+ * @param jtag_info
+ * @param addr		Address of first word to write into.
+ * @param count		Amount of words to write.
+ * @param buffer	Array of count*4 bytes to write into memory.
+ */
+int arc_jtag_write_memory_buf(struct arc_jtag *jtag_info, uint32_t addr,
+	uint32_t count, const uint8_t *buffer)
+{
+	int retval = ERROR_OK;
+
+	assert(jtag_info != NULL);
+	assert(jtag_info->tap != NULL);
+	assert(buffer != NULL);
+
+	LOG_DEBUG("Writing to memory: addr=0x%08" PRIx32 ";count=%" PRIu32,
+		addr, count);
+
+	while (count > 0) {
+		const uint32_t chunk = (count > ARC_JTAG_WRITE_CHUNK_WORDS ?
+				ARC_JTAG_WRITE_CHUNK_WORDS : count);
+
+		/* We do not know where we come from. */
+		arc_jtag_reset_transaction(jtag_info);
+
+		/* We want to write to memory. */
+		arc_jtag_set_transaction(jtag_info, ARC_JTAG_WRITE_TO_MEMORY,
+				TAP_DRPAUSE);
+
+		/* Set target memory address of the first word in chunk. */
+		arc_jtag_write_ir(jtag_info, ARC_ADDRESS_REG);
+		arc_jtag_write_dr(jtag_info, addr, TAP_DRPAUSE);
+
+		/* Start sending words. Address is auto-incremented on 4bytes by HW. */
+		arc_jtag_write_ir(jtag_info, ARC_DATA_REG);
+		jtag_info->tap_end_state = TAP_IDLE;
+		uint32_t i;
+		for (i = 0; i < chunk; i++) {
+			struct scan_field field;
+			field.num_bits = 32;
+			field.out_value = buffer + i * 4;
+			field.in_value = NULL;
+			/* Field is copied into command queue. */
+			jtag_add_dr_scan(jtag_info->tap, 1, &field, TAP_IDLE);
+		}
+
+		/* Cleanup. */
+		arc_jtag_reset_transaction(jtag_info);
+
+		retval = jtag_execute_queue();
+		if (ERROR_OK != retval) {
+			LOG_ERROR("Writing to memory failed. Error code = %i", retval);
+			return retval;
+		}
+
+		addr += chunk * 4;
+		buffer += chunk * 4;
+		count -= chunk;
+	}
+
+	return retval;
+}
+
+/**
+ * Read a sequence of 4-byte words from target memory into a byte buffer.
+ *
+ * Data register is scanned directly into the caller's buffer, so no
+ * intermediate copies are made. Each word is stored in the byte order in which
+ * it is shifted out of the DR, that is little-endian; conversion to target
+ * endianness, if required, is left to the caller.
+ *
+ * Large requests are split into chunks of ARC_JTAG_READ_CHUNK_WORDS, so that
+ * size of JTAG command queue stays bounded regardless of the request size.
  *
  * This function read directly from the memory, so it can read invalid data if
  * data cache hasn't been flushed before hand. It is responsibility of upper
@@ -451,10 +561,10 @@ int arc_jtag_write_memory(struct arc_jtag *jtag_info, uint32_t addr,
  * @param jtag_info
  * @param addr		Address of first word to read from.
  * @param count		Amount of words to read.
- * @param buffer	Array of words to read into.
+ * @param buffer	Array of count*4 bytes to read into.
  */
-int arc_jtag_read_memory(struct arc_jtag *jtag_info, uint32_t addr,
-	uint32_t count, uint32_t *buffer )
+int arc_jtag_read_memory_buf(struct arc_jtag *jtag_info, uint32_t addr,
+	uint32_t count, uint8_t *buffer)
 {
 	int retval = ERROR_OK;
 
@@ -463,41 +573,68 @@ int arc_jtag_read_memory(struct arc_jtag *jtag_info, uint32_t addr,
 
 	LOG_DEBUG("Reading memory: addr=0x%" PRIx32 ";count=%" PRIu32, addr, count);
 
-	if (count == 0)
-		return retval;
+	while (count > 0) {
+		const uint32_t chunk = (count > ARC_JTAG_READ_CHUNK_WORDS ?
+				ARC_JTAG_READ_CHUNK_WORDS : count);
 
-	arc_jtag_reset_transaction(jtag_info);
+		arc_jtag_reset_transaction(jtag_info);
 
-	/* We are reading from memory. */
-	arc_jtag_set_transaction(jtag_info, ARC_JTAG_READ_FROM_MEMORY, TAP_DRPAUSE);
+		/* We are reading from memory. */
+		arc_jtag_set_transaction(jtag_info, ARC_JTAG_READ_FROM_MEMORY,
+				TAP_DRPAUSE);
 
-	/* Set address of the first word */
-	arc_jtag_write_ir(jtag_info, ARC_ADDRESS_REG);
-	arc_jtag_write_dr(jtag_info, addr, TAP_IDLE);
+		/* Set address of the first word in chunk. */
+		arc_jtag_write_ir(jtag_info, ARC_ADDRESS_REG);
+		arc_jtag_write_dr(jtag_info, addr, TAP_IDLE);
 
-	/* Read data */
-	arc_jtag_write_ir(jtag_info, ARC_DATA_REG);
-	uint8_t *data_buf = calloc(sizeof(uint8_t), count * 4);
-	uint32_t i;
-	for (i = 0; i < count; i++) {
-		arc_jtag_read_dr(jtag_info, data_buf + i * 4, TAP_IDLE);
+		/* Read data. Address is auto-incremented on 4 bytes by HW. */
+		arc_jtag_write_ir(jtag_info, ARC_DATA_REG);
+		uint32_t i;
+		for (i = 0; i < chunk; i++)
+			arc_jtag_read_dr(jtag_info, buffer + i * 4, TAP_IDLE);
+
+		/* Clean up */
+		arc_jtag_reset_transaction(jtag_info);
+
+		retval = jtag_execute_queue();
+		if (ERROR_OK != retval) {
+			LOG_ERROR("Reading from memory failed. Error code=%i", retval);
+			return retval;
+		}
+
+		addr += chunk * 4;
+		buffer += chunk * 4;
+		count -= chunk;
 	}
 
-	/* Clean up */
-	arc_jtag_reset_transaction(jtag_info);
+	return retval;
+}
 
-	retval = jtag_execute_queue();
-	if (ERROR_OK != retval) {
-		LOG_ERROR("Reading from memory failed. Error code=%i", retval);
+/**
+ * Read a sequence of 4-byte words from target memory.
+ *
+ * We can read only 4byte words via JTAG.
+ *
+ * Same as arc_jtag_read_memory_buf, but words are returned in host
+ * endianness. Conversion is done in place, without additional buffers.
+ *
+ * @param jtag_info
+ * @param addr		Address of first word to read from.
+ * @param count		Amount of words to read.
+ * @param buffer	Array of words to read into.
+ */
+int arc_jtag_read_memory(struct arc_jtag *jtag_info, uint32_t addr,
+	uint32_t count, uint32_t *buffer )
+{
+	int retval = arc_jtag_read_memory_buf(jtag_info, addr, count,
+			(uint8_t *)buffer);
+	if (ERROR_OK != retval)
 		return retval;
-	}
 
 	/* Convert byte-buffers to host presentation. */
-	for (i = 0; i < count; i++) {
-		buffer[i] = buf_get_u32(data_buf + 4*i, 0, 32);
-	}
-
-	free(data_buf);
+	uint32_t i;
+	for (i = 0; i < count; i++)
+		buffer[i] = le_to_h_u32((uint8_t *)(buffer + i));
 
 	return retval;
 }
@@ -598,3 +735,72 @@ int arc_jtag_read_aux_reg(struct arc_jtag *jtag_info, uint32_t *addr,
 			buffer);
 }
 
+/**
+ * Read core and AUX registers with a single JTAG queue execution. This is the
+ * same as calling arc_jtag_read_core_reg and arc_jtag_read_aux_reg, but
+ * requires only one round-trip to the JTAG adapter.
+ *
+ * @param jtag_info
+ * @param core_addrs	Array of core register numbers.
+ * @param core_count	Amount of core registers.
+ * @param core_values	Array of core register values.
+ * @param aux_addrs	Array of AUX register numbers.
+ * @param aux_count	Amount of AUX registers.
+ * @param aux_values	Array of AUX register values.
+ */
+int arc_jtag_read_regs(struct arc_jtag *jtag_info,
+	uint32_t *core_addrs, uint32_t core_count, uint32_t *core_values,
+	uint32_t *aux_addrs, uint32_t aux_count, uint32_t *aux_values)
+{
+	int retval = ERROR_OK;
+
+	if (core_count == 0 && aux_count == 0)
+		return retval;
+
+	if (core_count > 0)
+		arc_jtag_queue_read_registers(jtag_info, ARC_JTAG_CORE_REG,
+				core_addrs, core_count, core_values);
+	if (aux_count > 0)
+		arc_jtag_queue_read_registers(jtag_info, ARC_JTAG_AUX_REG,
+				aux_addrs, aux_count, aux_values);
+
+	retval = jtag_execute_queue();
+	if (ERROR_OK != retval) {
+		LOG_ERROR("Reading from registers failed. Error code=%i", retval);
+		return retval;
+	}
+
+	arc_jtag_regs_to_host(core_count, core_values);
+	arc_jtag_regs_to_host(aux_count, aux_values);
+
+	return retval;
+}
+
+/**
+ * Write core and AUX registers with a single JTAG queue execution. See
+ * arc_jtag_read_regs.
+ */
+int arc_jtag_write_regs(struct arc_jtag *jtag_info,
+	uint32_t *core_addrs, uint32_t core_count, const uint32_t *core_values,
+	uint32_t *aux_addrs, uint32_t aux_count, const uint32_t *aux_values)
+{
+	int retval = ERROR_OK;
+
+	if (core_count == 0 && aux_count == 0)
+		return retval;
+
+	if (core_count > 0)
+		arc_jtag_queue_write_registers(jtag_info, ARC_JTAG_CORE_REG,
+				core_addrs, core_count, core_values);
+	if (aux_count > 0)
+		arc_jtag_queue_write_registers(jtag_info, ARC_JTAG_AUX_REG,
+				aux_addrs, aux_count, aux_values);
+
+	retval = jtag_execute_queue();
+	if (ERROR_OK != retval) {
+		LOG_ERROR("Writing to registers failed. Error code=%i", retval);
+		return retval;
+	}
+
+	return retval;
+}
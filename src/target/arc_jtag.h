@@ -59,6 +59,11 @@ typedef enum arc_jtag_transaction {
 
 #define ARC_BYPASS_REG				0xF /* TDI to TDO */
 
+/* Maximum amount of words read from or written to memory with one JTAG queue
+ * execution. */
+#define ARC_JTAG_READ_CHUNK_WORDS	4096
+#define ARC_JTAG_WRITE_CHUNK_WORDS	4096
+
 struct arc_jtag {
 	struct jtag_tap *tap;
 	uint32_t tap_end_state;
@@ -85,6 +90,10 @@ int arc_jtag_write_memory(struct arc_jtag *jtag_info, uint32_t addr,
 	uint32_t count, const uint32_t *buffer);
 int arc_jtag_read_memory(struct arc_jtag *jtag_info, uint32_t addr,
 	uint32_t count, uint32_t *buffer);
+int arc_jtag_write_memory_buf(struct arc_jtag *jtag_info, uint32_t addr,
+	uint32_t count, const uint8_t *buffer);
+int arc_jtag_read_memory_buf(struct arc_jtag *jtag_info, uint32_t addr,
+	uint32_t count, uint8_t *buffer);
 
 int arc_jtag_write_core_reg(struct arc_jtag *jtag_info, uint32_t *addr,
 	uint32_t count, const uint32_t *buffer);
@@ -104,4 +113,11 @@ int arc_jtag_read_aux_reg(struct arc_jtag *jtag_info, uint32_t *addr,
 int arc_jtag_read_aux_reg_one(struct arc_jtag *jtag_info, uint32_t addr,
 	uint32_t *value);
 
+int arc_jtag_read_regs(struct arc_jtag *jtag_info,
+	uint32_t *core_addrs, uint32_t core_count, uint32_t *core_values,
+	uint32_t *aux_addrs, uint32_t aux_count, uint32_t *aux_values);
+int arc_jtag_write_regs(struct arc_jtag *jtag_info,
+	uint32_t *core_addrs, uint32_t core_count, const uint32_t *core_values,
+	uint32_t *aux_addrs, uint32_t aux_count, const uint32_t *aux_values);
+
 #endif /* ARC_JTAG_H */
@@ -28,145 +28,146 @@
 
 /* ----- Supporting functions ---------------------------------------------- */
 
+/* Read words at word-aligned address directly into byte buffer. Data in
+ * buffer is in target endianness. */
 static int arc_mem_read_block(struct target *target, uint32_t addr,
-	int size, int count, void *buf)
+	uint32_t count, uint8_t *buf)
 {
 	struct arc32_common *arc32 = target_to_arc32(target);
 	int retval = ERROR_OK;
 
-	LOG_DEBUG("Read memory: addr=0x%" PRIx32 ", size=%i, count=%i",
-			addr, size, count);
+	LOG_DEBUG("Read memory: addr=0x%" PRIx32 ", count=%" PRIu32, addr, count);
 	assert(!(addr & 3));
-	assert(size == 4);
 
-	/* Always call D$ flush, it will decide whether to perform actual
-	 * flush. */
-	retval = arc32_dcache_flush(target);
+	if (count == 0)
+		return retval;
+
+	retval = arc_jtag_read_memory_buf(&arc32->jtag_info, addr, count, buf);
 	if (ERROR_OK != retval)
 		return retval;
 
-	retval = arc_jtag_read_memory(&arc32->jtag_info, addr, count, buf);
+	/* Words are scanned out of DR in little endian order. */
+	if (target->endianness == TARGET_BIG_ENDIAN)
+		buf_bswap32(buf, buf, count * 4);
 
 	return retval;
 }
 
-/* Write word at word-aligned address */
-static int arc_mem_write_block32(struct target *target, uint32_t addr, int count,
-	void *buf)
+/* Write words at word-aligned address from byte buffer. Data in buffer is in
+ * target endianness. */
+static int arc_mem_write_block(struct target *target, uint32_t addr,
+	uint32_t count, const uint8_t *buf)
 {
 	struct arc32_common *arc32 = target_to_arc32(target);
 	int retval = ERROR_OK;
 
-	/* Check arguments */
-	if (addr & 0x3u)
-		return ERROR_TARGET_UNALIGNED_ACCESS;
+	LOG_DEBUG("Write memory: addr=0x%" PRIx32 ", count=%" PRIu32, addr, count);
+	assert(!(addr & 3));
 
-	/* No need to flush cache, because we don't read values from memory. */
-	retval = arc_jtag_write_memory( &arc32->jtag_info, addr, count, (uint32_t *)buf);
-	if (ERROR_OK != retval)
+	if (count == 0)
 		return retval;
 
-	/* Invalidate caches. */
-	retval = arc32_cache_invalidate(target);
+	/* Words are scanned into DR in little endian order. */
+	if (target->endianness == TARGET_BIG_ENDIAN) {
+		uint8_t *tunnel = malloc(count * 4);
+		if (!tunnel) {
+			LOG_ERROR("Out of memory");
+			return ERROR_FAIL;
+		}
+		buf_bswap32(tunnel, buf, count * 4);
+		retval = arc_jtag_write_memory_buf(&arc32->jtag_info, addr, count,
+				tunnel);
+		free(tunnel);
+	} else {
+		retval = arc_jtag_write_memory_buf(&arc32->jtag_info, addr, count,
+				buf);
+	}
 
 	return retval;
 }
 
-/* Write half-word at half-word-aligned address */
-static int arc_mem_write_block16(struct target *target, uint32_t addr, int count,
-	void *buf)
+/**
+ * Write arbitrary byte range to target memory.
+ *
+ * JTAG interface can access only whole words at word-aligned addresses, so
+ * request is split into word-aligned body, which is written as is, and
+ * unaligned head and tail. Bytes of head and tail are merged into boundary
+ * words with one read-modify-write per boundary word, regardless of access
+ * size requested by the caller.
+ */
+static int arc_mem_write_buf(struct target *target, uint32_t address,
+	uint32_t bytes, const uint8_t *buffer)
 {
-	struct arc32_common *arc32 = target_to_arc32(target);
 	int retval = ERROR_OK;
-	int i;
 
-	LOG_DEBUG("Write memory (16bit): addr=0x%" PRIx32 ", count=%i", addr, count);
-
-	/* Check arguments */
-	if (addr & 1u)
-		return ERROR_TARGET_UNALIGNED_ACCESS;
+	const uint32_t end = address + bytes;
+	const uint32_t head_addr = address & ~3u;
+	const uint32_t tail_addr = (end - 1) & ~3u;
+	const uint32_t head = address & 3u;
+	const uint32_t tail = end & 3u;
 
 	/* We will read data from memory, so we need to flush D$. */
-	retval = arc32_dcache_flush(target);
-	if (ERROR_OK != retval)
-		return retval;
-
-	uint32_t buffer_he;
-	uint8_t buffer_te[sizeof(uint32_t)];
-	uint8_t halfword_te[sizeof(uint16_t)];
-	/* non-word writes are less common, than 4-byte writes, so I suppose we can
-	 * allowe ourselves to write this in a cycle, instead of calling arc_jtag
-	 * with count > 1. */
-	for(i = 0; i < count; i++) {
-		/* We can read only word at word-aligned address. Also *jtag_read_memory
-		 * functions return data in host endianness, so host endianness !=
-		 * target endianness we have to convert data back to target endianness,
-		 * or bytes will be at the wrong places.So:
-		 *   1) read word
-		 *   2) convert to target endianness
-		 *   3) make changes
-		 *   4) convert back to host endianness
-		 *   5) write word back to target.
-		 */
-		retval = arc_jtag_read_memory(&arc32->jtag_info,
-				(addr + i * sizeof(uint16_t)) & ~3u, 1, &buffer_he);
-		target_buffer_set_u32(target, buffer_te, buffer_he);
-		/* buf is in host endianness, convert to target */
-		target_buffer_set_u16(target, halfword_te, ((uint16_t *)buf)[i]);
-		memcpy(buffer_te  + ((addr + i * sizeof(uint16_t)) & 3u),
-                        halfword_te, sizeof(uint16_t));
-		buffer_he = target_buffer_get_u32(target, buffer_te);
-		retval = arc_jtag_write_memory(&arc32->jtag_info,
-                        (addr + i * sizeof(uint16_t)) & ~3u, 1, &buffer_he);
-
+	if (head || tail) {
+		retval = arc32_dcache_flush(target);
 		if (ERROR_OK != retval)
 			return retval;
 	}
 
-	/* Invalidate caches. */
-	retval = arc32_cache_invalidate(target);
+	if (head_addr == tail_addr && (head || tail)) {
+		/* Whole request fits into single word. */
+		uint8_t word[sizeof(uint32_t)];
+		retval = arc_mem_read_block(target, head_addr, 1, word);
+		if (ERROR_OK != retval)
+			return retval;
+		memcpy(word + head, buffer, bytes);
+		retval = arc_mem_write_block(target, head_addr, 1, word);
+	} else {
+		uint32_t body_start = address;
+		uint32_t body_end = end;
+
+		if (head) {
+			uint8_t word[sizeof(uint32_t)];
+			retval = arc_mem_read_block(target, head_addr, 1, word);
+			if (ERROR_OK != retval)
+				return retval;
+			memcpy(word + head, buffer, sizeof(uint32_t) - head);
+			retval = arc_mem_write_block(target, head_addr, 1, word);
+			if (ERROR_OK != retval)
+				return retval;
+			body_start = head_addr + sizeof(uint32_t);
+		}
 
-	return retval;
-}
+		if (tail) {
+			uint8_t word[sizeof(uint32_t)];
+			retval = arc_mem_read_block(target, tail_addr, 1, word);
+			if (ERROR_OK != retval)
+				return retval;
+			memcpy(word, buffer + (tail_addr - address), tail);
+			retval = arc_mem_write_block(target, tail_addr, 1, word);
+			if (ERROR_OK != retval)
+				return retval;
+			body_end = tail_addr;
+		}
 
-/* Write byte at address */
-static int arc_mem_write_block8(struct target *target, uint32_t addr, int count,
-	void *buf)
-{
-	struct arc32_common *arc32 = target_to_arc32(target);
-	int retval = ERROR_OK;
-	int i;
+		retval = arc_mem_write_block(target, body_start,
+				(body_end - body_start) / 4, buffer + (body_start - address));
+	}
 
-	/* We will read data from memory, so we need to flush D$. */
-	retval = arc32_dcache_flush(target);
 	if (ERROR_OK != retval)
 		return retval;
 
-	uint32_t buffer_he;
-	uint8_t buffer_te[sizeof(uint32_t)];
-	/* non-word writes are less common, than 4-byte writes, so I suppose we can
-	 * allowe ourselves to write this in a cycle, instead of calling arc_jtag
-	 * with count > 1. */
-	for(i = 0; i < count; i++) {
-		/* See comment in arc_mem_write_block16 for details. Since it is a byte
-		 * there is not need to convert write buffer to target endianness, but
-		 * we still have to convert read buffer. */
-		retval = arc_jtag_read_memory(&arc32->jtag_info, (addr + i) & ~3, 1, &buffer_he);
-		target_buffer_set_u32(target, buffer_te, buffer_he);
-		memcpy(buffer_te  + ((addr + i) & 3), (uint8_t*)buf + i, 1);
-		buffer_he = target_buffer_get_u32(target, buffer_te);
-		retval = arc_jtag_write_memory(&arc32->jtag_info, (addr + i) & ~3, 1, &buffer_he);
-
-		if (ERROR_OK != retval)
-			return retval;
-	}
-
 	/* Invalidate caches. */
 	retval = arc32_cache_invalidate(target);
 
 	return retval;
 }
 
+/* A request may end at the top of the address space but not run past it. */
+static bool arc_mem_range_wraps(uint32_t address, uint32_t size, uint32_t count)
+{
+	return (uint64_t)address + (uint64_t)size * count > (1ULL << 32);
+}
+
 /* ----- Exported functions ------------------------------------------------ */
 
 int arc_mem_read(struct target *target, uint32_t address, uint32_t size,
@@ -189,59 +190,70 @@ int arc_mem_read(struct target *target, uint32_t address, uint32_t size,
 	if (((size == 4) && (address & 0x3u)) || ((size == 2) && (address & 0x1u)))
 	    return ERROR_TARGET_UNALIGNED_ACCESS;
 
-	void *tunnel_he;
-	uint8_t *tunnel_te;
-	uint32_t words_to_read, bytes_to_read;
-
-	/* TODO: I think this function might be made much more clear if it
-	 * would be splitted onto three based on size (4/2/1). That would
-	 * duplicate some logic, but it would be much easier to understand it,
-	 * those bit operations are just asking for a trouble. And they emulate
-	 * size-specific logic, that is smart, but dangerous.  */
-	/* Reads are word-aligned, so padding might be required if count > 1.
-	 * NB: +3 is a padding for the last word (in case it's not aligned;
-	 * addr&3 is a padding for the first word (since address can be
-	 * unaligned as well).  */
-	bytes_to_read = (count * size + 3 + (address & 3u)) & ~3u;
-	words_to_read = bytes_to_read >> 2;
-	tunnel_he = malloc(bytes_to_read);
-	tunnel_te = malloc(bytes_to_read);
-	if (!tunnel_he || !tunnel_te) {
-		LOG_ERROR("Out of memory");
+	if (arc_mem_range_wraps(address, size, count)) {
+		LOG_ERROR("Read of %" PRIu32 " bytes at 0x%" PRIx32 " wraps around the address space",
+				size * count, address);
 		return ERROR_FAIL;
 	}
 
-	/* We can read only word-aligned words. */
-	retval = arc_mem_read_block(target, address & ~3u, sizeof(uint32_t),
-		words_to_read, tunnel_he);
-
-	/* arc32_..._read_mem with size 4/2 returns uint32_t/uint16_t in host */
-	/* endianness, but byte array should represent target endianness      */
-
-	if (ERROR_OK == retval) {
-		switch (size) {
-		case 4:
-			target_buffer_set_u32_array(target, buffer, count,
-				tunnel_he);
-			break;
-		case 2:
-			target_buffer_set_u32_array(target, tunnel_te,
-				words_to_read, tunnel_he);
-			/* Will that work properly with count > 1 and big endian? */
-			memcpy(buffer, tunnel_te + (address & 3u),
-				count * sizeof(uint16_t));
-			break;
-		case 1:
-			target_buffer_set_u32_array(target, tunnel_te,
-				words_to_read, tunnel_he);
-			/* Will that work properly with count > 1 and big endian? */
-			memcpy(buffer, tunnel_te + (address & 3u), count);
-			break;
+	/* Always call D$ flush, it will decide whether to perform actual
+	 * flush. */
+	retval = arc32_dcache_flush(target);
+	if (ERROR_OK != retval)
+		return retval;
+
+	struct duration bench;
+	duration_start(&bench);
+
+	/* We can read only word-aligned words. Request is split into unaligned
+	 * head, word-aligned body and unaligned tail. Body is read directly into
+	 * the caller's buffer, head and tail go through a small bounce buffer.
+	 * The bounds are 64-bit, so that a request may end at 4 GiB. */
+	const uint64_t end = (uint64_t)address + count * size;
+	const uint64_t body_start = ((uint64_t)address + 3u) & ~3ull;
+	const uint64_t body_end = end & ~3ull;
+	uint8_t bounce[2 * sizeof(uint32_t)];
+
+	if (body_start >= body_end) {
+		/* Whole request fits into at most two words. */
+		const uint32_t first = address & ~3u;
+		const uint32_t bytes = ((end + 3u) & ~3ull) - first;
+		if (bytes > sizeof(bounce)) {
+			LOG_ERROR("BUG: short read of %" PRIu32 " bytes does not fit the bounce buffer", bytes);
+			return ERROR_FAIL;
+		}
+		retval = arc_mem_read_block(target, first, bytes / 4, bounce);
+		if (ERROR_OK == retval)
+			memcpy(buffer, bounce + (address & 3u), count * size);
+	} else {
+		const uint32_t head = body_start - address;
+		const uint32_t tail = end - body_end;
+
+		if (head) {
+			retval = arc_mem_read_block(target, address & ~3u, 1, bounce);
+			if (ERROR_OK != retval)
+				return retval;
+			memcpy(buffer, bounce + (address & 3u), head);
+		}
+
+		retval = arc_mem_read_block(target, body_start,
+				(body_end - body_start) / 4, buffer + head);
+		if (ERROR_OK != retval)
+			return retval;
+
+		if (tail) {
+			retval = arc_mem_read_block(target, body_end, 1, bounce);
+			if (ERROR_OK != retval)
+				return retval;
+			memcpy(buffer + (body_end - address), bounce, tail);
 		}
 	}
 
-	free(tunnel_he);
-	free(tunnel_te);
+	if (ERROR_OK == retval && duration_measure(&bench) == ERROR_OK) {
+		LOG_DEBUG("Read %" PRIu32 " bytes in %fs (%0.3f KiB/s)",
+				count * size, duration_elapsed(&bench),
+				duration_kbps(&bench, count * size));
+	}
 
 	return retval;
 }
@@ -267,58 +279,34 @@ int arc_mem_write(struct target *target, uint32_t address, uint32_t size,
 	if (((size == 4) && (address & 0x3u)) || ((size == 2) && (address & 0x1u)))
 		return ERROR_TARGET_UNALIGNED_ACCESS;
 
-	/* correct endianess if we have word or hword access */
-	void *tunnel = NULL;
+	if (arc_mem_range_wraps(address, size, count)) {
+		LOG_ERROR("Write of %" PRIu32 " bytes at 0x%" PRIx32 " wraps around the address space",
+				size * count, address);
+		return ERROR_FAIL;
+	}
 
-	if (size > 1) {
-		/*
-		 * arc32_..._write_mem with size 4/2 requires uint32_t/uint16_t
-		 * in host endianness, but byte array represents target endianness.
-		 */
-		tunnel = malloc(count * size * sizeof(uint8_t));
-		if (tunnel == NULL) {
-			LOG_ERROR("Out of memory");
-			return ERROR_FAIL;
-		}
+	struct duration bench;
+	duration_start(&bench);
 
-		switch (size) {
-		case 4:
-			target_buffer_get_u32_array(target, buffer, count,
-				(uint32_t *)tunnel);
-			break;
-		case 2:
-			target_buffer_get_u16_array(target, buffer, count,
-				(uint16_t *)tunnel);
-			break;
-		}
-		buffer = tunnel;
-	}
+	/* Buffer is in target endianness, which is exactly what is written to
+	 * memory, so no conversion is required regardless of access size. */
+	retval = arc_mem_write_buf(target, address, count * size, buffer);
 
-	if (size == 4) {
-		retval = arc_mem_write_block32(target, address, count, (void *)buffer);
-	} else if (size == 2) {
-		/* We convert buffer from host endianness to target. But then in
-		 * write_block16, we do the reverse. Is there a way to avoid this without
-		 * breaking other cases? */
-		retval = arc_mem_write_block16(target, address, count, (void *)buffer);
-	} else {
-		retval = arc_mem_write_block8(target, address, count, (void *)buffer);
+	if (ERROR_OK == retval && duration_measure(&bench) == ERROR_OK) {
+		LOG_DEBUG("Wrote %" PRIu32 " bytes in %fs (%0.3f KiB/s)",
+				count * size, duration_elapsed(&bench),
+				duration_kbps(&bench, count * size));
 	}
 
-	if (tunnel != NULL)
-		free(tunnel);
-
 	return retval;
 }
 
 int arc_mem_checksum(struct target *target, uint32_t address, uint32_t count,
 	uint32_t *checksum)
 {
-	int retval = ERROR_OK;
-
-	LOG_ERROR("arc_mem_checksum NOT SUPPORTED IN THIS RELEASE.");
-
-	return retval;
+	/* no algorithm support, target_checksum_memory() reads the memory
+	 * back and checksums it on the host instead */
+	return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
 }
 
 int arc_mem_blank_check(struct target *target, uint32_t address,
@@ -278,6 +278,69 @@ COMMAND_HANDLER(handle_write_mem_word_command)
 	return retval;
 }
 
+COMMAND_HANDLER(handle_mem_bench_command)
+{
+	int retval = ERROR_OK;
+	uint32_t mem_addr, size;
+	struct duration bench;
+	static const uint32_t access_sizes[] = { 4, 2, 1 };
+
+	struct target *target = get_current_target(CMD_CTX);
+
+	if (CMD_ARGC != 2)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	COMMAND_PARSE_NUMBER(u32, CMD_ARGV[0], mem_addr);
+	COMMAND_PARSE_NUMBER(u32, CMD_ARGV[1], size);
+
+	if ((mem_addr & 3u) || (size & 3u) || size == 0) {
+		command_print(CMD_CTX, "address and size must be word-aligned");
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+
+	if (target->state != TARGET_HALTED) {
+		command_print(CMD_CTX, "NOTE: target must be HALTED for \"%s\" command",
+			CMD_NAME);
+		return ERROR_TARGET_NOT_HALTED;
+	}
+
+	uint8_t *buffer = malloc(size);
+	if (buffer == NULL) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	/* Memory contents are written back unchanged, so benchmark is not
+	 * destructive. */
+	for (unsigned i = 0; i < ARRAY_SIZE(access_sizes); i++) {
+		const uint32_t access = access_sizes[i];
+
+		duration_start(&bench);
+		retval = target_read_memory(target, mem_addr, access, size / access,
+				buffer);
+		if (ERROR_OK != retval)
+			break;
+		duration_measure(&bench);
+		command_print(CMD_CTX, "read  %" PRIu32 "-byte: %" PRIu32
+				" bytes in %fs (%0.3f KiB/s)", access, size,
+				duration_elapsed(&bench), duration_kbps(&bench, size));
+
+		duration_start(&bench);
+		retval = target_write_memory(target, mem_addr, access, size / access,
+				buffer);
+		if (ERROR_OK != retval)
+			break;
+		duration_measure(&bench);
+		command_print(CMD_CTX, "write %" PRIu32 "-byte: %" PRIu32
+				" bytes in %fs (%0.3f KiB/s)", access, size,
+				duration_elapsed(&bench), duration_kbps(&bench, size));
+	}
+
+	free(buffer);
+
+	return retval;
+}
+
 COMMAND_HANDLER(handle_print_core_status_command)
 {
 	int retval = ERROR_OK;
@@ -306,6 +369,25 @@ COMMAND_HANDLER(handle_print_core_status_command)
 	return retval;
 }
 
+COMMAND_HANDLER(handle_reg_stats_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	struct arc32_common *arc32 = target_to_arc32(target);
+	struct arc32_reg_stats *stats = &arc32->reg_stats;
+
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	command_print(CMD_CTX, "context saves: %" PRIu32 ", last: %" PRIu32
+			" registers in %.3f ms", stats->saves, stats->last_save_regs,
+			stats->last_save_time * 1000.0);
+	command_print(CMD_CTX, "context restores: %" PRIu32 ", last: %" PRIu32
+			" registers in %.3f ms", stats->restores, stats->last_restore_regs,
+			stats->last_restore_time * 1000.0);
+
+	return ERROR_OK;
+}
+
 COMMAND_HANDLER(arc_handle_has_dcache)
 {
 	struct target *target = get_current_target(CMD_CTX);
@@ -457,6 +539,14 @@ static const struct command_registration arc_core_command_handlers[] = {
 		.usage = "has two argument: <mem-addr> <value to write>",
 		.help = "write value (1 word) to a particular memory location",
 	},
+	{
+		.name = "mem-bench",
+		.handler = handle_mem_bench_command,
+		.mode = COMMAND_EXEC,
+		.usage = "has two arguments: <mem-addr> <size>",
+		.help = "measure memory read and write speed for each access size; "\
+			"memory contents are preserved",
+	},
 	{
 		.name = "print-core-status",
 		.handler = handle_print_core_status_command,
@@ -464,6 +554,14 @@ static const struct command_registration arc_core_command_handlers[] = {
 		.usage = "has no arguments",
 		.help = "list the content of core aux debug & status32 register",
 	},
+	{
+		.name = "reg-stats",
+		.handler = handle_reg_stats_command,
+		.mode = COMMAND_EXEC,
+		.usage = "has no arguments",
+		.help = "show amount of registers transferred and time spent on "\
+			"last context save and restore",
+	},
 	{
 		.name = "has-dcache",
 		.handler = arc_handle_has_dcache,
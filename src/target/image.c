@@ -33,7 +33,9 @@
 
 #include "image.h"
 #include "target.h"
+#include <helper/binarybuffer.h>
 #include <helper/log.h>
+#include <helper/time_support.h>
 
 /* convert ELF header field to host endianness */
 #define field16(elf, field) \
@@ -117,6 +119,19 @@ static int identify_image_type(struct image *image, const char *type_string, con
 	return ERROR_OK;
 }
 
+/* decode the hex data bytes of a record, adding them to its checksum */
+static int image_decode_data(uint8_t *buffer, const char *hex, uint32_t count,
+	uint8_t *checksum)
+{
+	if (unhexify((char *)buffer, hex, count) != (int)count)
+		return ERROR_IMAGE_FORMAT_ERROR;
+
+	for (uint32_t i = 0; i < count; i++)
+		*checksum += buffer[i];
+
+	return ERROR_OK;
+}
+
 static int image_ihex_buffer_complete_inner(struct image *image,
 	char *lpszLine,
 	struct imagesection *section)
@@ -188,16 +203,15 @@ static int image_ihex_buffer_complete_inner(struct image *image,
 				full_address = (full_address & 0xffff0000) | address;
 			}
 
-			while (count-- > 0) {
-				unsigned value;
-				sscanf(&lpszLine[bytes_read], "%2x", &value);
-				ihex->buffer[cooked_bytes] = (uint8_t)value;
-				cal_checksum += (uint8_t)ihex->buffer[cooked_bytes];
-				bytes_read += 2;
-				cooked_bytes += 1;
-				section[image->num_sections].size += 1;
-				full_address++;
+			if (image_decode_data(&ihex->buffer[cooked_bytes], &lpszLine[bytes_read],
+					count, &cal_checksum) != ERROR_OK) {
+				LOG_ERROR("invalid data record found in IHEX file");
+				return ERROR_IMAGE_FORMAT_ERROR;
 			}
+			bytes_read += 2 * count;
+			cooked_bytes += count;
+			section[image->num_sections].size += count;
+			full_address += count;
 		} else if (record_type == 1) {	/* End of File Record */
 			/* finish the current section */
 			image->num_sections++;
@@ -463,6 +477,17 @@ static int image_elf_read_headers(struct image *image)
 	return ERROR_OK;
 }
 
+/* segment contents within the mapped file, NULL if not mapped */
+static const uint8_t *image_elf_view(struct image_elf *elf, Elf32_Phdr *segment,
+	uint32_t offset, uint32_t size)
+{
+	uint64_t start = (uint64_t)field32(elf, segment->p_offset) + offset;
+
+	if (!elf->map || start + size > elf->map_size)
+		return NULL;
+	return elf->map + start;
+}
+
 static int image_elf_read_section(struct image *image,
 	int section,
 	uint32_t offset,
@@ -485,6 +510,12 @@ static int image_elf_read_section(struct image *image,
 		read_size = MIN(size, field32(elf, segment->p_filesz) - offset);
 		LOG_DEBUG("read elf: size = 0x%zu at 0x%" PRIx32 "", read_size,
 			field32(elf, segment->p_offset) + offset);
+		const uint8_t *data = image_elf_view(elf, segment, offset, read_size);
+		if (data) {
+			memcpy(buffer, data, read_size);
+			*size_read += read_size;
+			return ERROR_OK;
+		}
 		/* read initialized area of the segment */
 		retval = fileio_seek(&elf->fileio, field32(elf, segment->p_offset) + offset);
 		if (retval != ERROR_OK) {
@@ -611,16 +642,15 @@ static int image_mot_buffer_complete_inner(struct image *image,
 				full_address = address;
 			}
 
-			while (count-- > 0) {
-				unsigned value;
-				sscanf(&lpszLine[bytes_read], "%2x", &value);
-				mot->buffer[cooked_bytes] = (uint8_t)value;
-				cal_checksum += (uint8_t)mot->buffer[cooked_bytes];
-				bytes_read += 2;
-				cooked_bytes += 1;
-				section[image->num_sections].size += 1;
-				full_address++;
+			if (image_decode_data(&mot->buffer[cooked_bytes], &lpszLine[bytes_read],
+					count, &cal_checksum) != ERROR_OK) {
+				LOG_ERROR("invalid data record found in S19 file");
+				return ERROR_IMAGE_FORMAT_ERROR;
 			}
+			bytes_read += 2 * count;
+			cooked_bytes += count;
+			section[image->num_sections].size += count;
+			full_address += count;
 		} else if (record_type == 5) {
 			/* S5 is the data count record, we ignore it */
 			uint32_t dummy;
@@ -714,6 +744,11 @@ int image_open(struct image *image, const char *url, const char *type_string)
 			return retval;
 		}
 
+		/* large binaries are served straight from the page cache */
+		if (fileio_map(&image_binary->fileio, &image_binary->map,
+				&image_binary->map_size) != ERROR_OK)
+			image_binary->map = NULL;
+
 		image->num_sections = 1;
 		image->sections = malloc(sizeof(struct imagesection));
 		image->sections[0].base_address = 0x0;
@@ -749,6 +784,10 @@ int image_open(struct image *image, const char *url, const char *type_string)
 			fileio_close(&image_elf->fileio);
 			return retval;
 		}
+
+		if (fileio_map(&image_elf->fileio, &image_elf->map,
+				&image_elf->map_size) != ERROR_OK)
+			image_elf->map = NULL;
 	} else if (image->type == IMAGE_MEMORY) {
 		struct target *target = get_target(url);
 
@@ -833,6 +872,12 @@ int image_read_section(struct image *image,
 		if (section != 0)
 			return ERROR_COMMAND_SYNTAX_ERROR;
 
+		if (image_binary->map) {
+			memcpy(buffer, image_binary->map + offset, size);
+			*size_read = size;
+			return ERROR_OK;
+		}
+
 		/* seek to offset */
 		retval = fileio_seek(&image_binary->fileio, offset);
 		if (retval != ERROR_OK)
@@ -902,6 +947,34 @@ int image_read_section(struct image *image,
 	return ERROR_OK;
 }
 
+int image_section_view(struct image *image, int section, uint32_t offset,
+	uint32_t size, const uint8_t **data)
+{
+	*data = NULL;
+
+	/* don't read past the end of a section */
+	if (offset + size > image->sections[section].size)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (image->type == IMAGE_BINARY) {
+		struct image_binary *image_binary = image->type_private;
+
+		if (section != 0)
+			return ERROR_COMMAND_SYNTAX_ERROR;
+		if (image_binary->map)
+			*data = image_binary->map + offset;
+	} else if (image->type == IMAGE_ELF) {
+		struct image_elf *elf = image->type_private;
+		Elf32_Phdr *segment = image->sections[section].private;
+
+		*data = image_elf_view(elf, segment, offset, size);
+	} else if (image->type == IMAGE_IHEX || image->type == IMAGE_SRECORD ||
+			image->type == IMAGE_BUILDER)
+		*data = (uint8_t *)image->sections[section].private + offset;
+
+	return ERROR_OK;
+}
+
 int image_add_section(struct image *image, uint32_t base, uint32_t size, int flags, uint8_t *data)
 {
 	struct imagesection *section;
@@ -1006,40 +1079,300 @@ void image_close(struct image *image)
 
 int image_calculate_checksum(uint8_t *buffer, uint32_t nbytes, uint32_t *checksum)
 {
-	uint32_t crc = 0xffffffff;
 	LOG_DEBUG("Calculating checksum");
 
-	static uint32_t crc32_table[256];
+	*checksum = 0xffffffff;
+	image_update_checksum(buffer, nbytes, checksum);
+
+	LOG_DEBUG("Calculating checksum done");
+
+	return ERROR_OK;
+}
+
+/* crc32_table[0] is the usual byte at a time table, crc32_table[k] holds
+ * the crc of a byte followed by k zero bytes, used to process eight bytes
+ * per step (slicing-by-8) */
+static uint32_t crc32_table[8][256];
+
+static uint32_t image_crc32_bytewise(uint32_t crc, const uint8_t *buffer, size_t nbytes)
+{
+	while (nbytes--) {
+		/* as per gdb */
+		crc = (crc << 8) ^ crc32_table[0][((crc >> 24) ^ *buffer++) & 255];
+	}
+	return crc;
+}
+
+static uint32_t image_crc32_slice8(uint32_t crc, const uint8_t *buffer, size_t nbytes)
+{
+	for (; nbytes >= 8; nbytes -= 8) {
+		crc ^= be_to_h_u32(buffer);
+		crc = crc32_table[7][crc >> 24] ^
+			crc32_table[6][(crc >> 16) & 255] ^
+			crc32_table[5][(crc >> 8) & 255] ^
+			crc32_table[4][crc & 255] ^
+			crc32_table[3][buffer[4]] ^
+			crc32_table[2][buffer[5]] ^
+			crc32_table[1][buffer[6]] ^
+			crc32_table[0][buffer[7]];
+		buffer += 8;
+	}
+	return image_crc32_bytewise(crc, buffer, nbytes);
+}
+
+#if (defined(__x86_64__) || defined(__i386__)) && \
+	(defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#include <cpuid.h>
+#include <immintrin.h>
+#define IMAGE_CRC32_PCLMUL
 
+/* x^n mod P for the CRC polynomial */
+static uint32_t image_crc32_xpow(unsigned n)
+{
+	uint64_t v = 1;
+
+	while (n--) {
+		v <<= 1;
+		if (v & (1ull << 32))
+			v ^= 0x104c11db7ull;
+	}
+	return v;
+}
+
+/* folding constants, x^(d + 64) mod P in the high and x^d mod P in the
+ * low half for a fold distance of d = 512 and d = 128 bits */
+static uint64_t crc32_fold512[2], crc32_fold128[2];
+
+/*
+ * Carry-less multiply folding as in Intel's "Fast CRC Computation for
+ * Generic Polynomials Using PCLMULQDQ Instruction". The data is read as
+ * big endian 128 bit numbers, which for this MSB first CRC makes bit i
+ * of a register the coefficient of x^i. Four accumulators are folded
+ * 512 bits forward per step and then into each other. The 128 bit
+ * remainder is stored back as bytes and finished with the table, as a
+ * CRC over a zero initial value of those bytes is exactly its reduction.
+ */
+__attribute__((target("pclmul,ssse3")))
+static inline __m128i image_crc32_fold(__m128i x, __m128i k)
+{
+	return _mm_xor_si128(_mm_clmulepi64_si128(x, k, 0x11),
+			_mm_clmulepi64_si128(x, k, 0x00));
+}
+
+__attribute__((target("pclmul,ssse3")))
+static uint32_t image_crc32_pclmul(uint32_t crc, const uint8_t *buffer, size_t nbytes)
+{
+	const __m128i bswap = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7,
+			8, 9, 10, 11, 12, 13, 14, 15);
+	const __m128i k512 = _mm_set_epi64x(crc32_fold512[1], crc32_fold512[0]);
+	const __m128i k128 = _mm_set_epi64x(crc32_fold128[1], crc32_fold128[0]);
+	__m128i x0, x1, x2, x3;
+	uint8_t rem[16];
+
+	if (nbytes < 64)
+		return image_crc32_slice8(crc, buffer, nbytes);
+
+#define LOAD(i) _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(buffer + 16 * (i))), bswap)
+	x0 = _mm_xor_si128(LOAD(0), _mm_set_epi32(crc, 0, 0, 0));
+	x1 = LOAD(1);
+	x2 = LOAD(2);
+	x3 = LOAD(3);
+	buffer += 64;
+	nbytes -= 64;
+
+	for (; nbytes >= 64; nbytes -= 64) {
+		x0 = _mm_xor_si128(image_crc32_fold(x0, k512), LOAD(0));
+		x1 = _mm_xor_si128(image_crc32_fold(x1, k512), LOAD(1));
+		x2 = _mm_xor_si128(image_crc32_fold(x2, k512), LOAD(2));
+		x3 = _mm_xor_si128(image_crc32_fold(x3, k512), LOAD(3));
+		buffer += 64;
+	}
+
+	x1 = _mm_xor_si128(image_crc32_fold(x0, k128), x1);
+	x2 = _mm_xor_si128(image_crc32_fold(x1, k128), x2);
+	x3 = _mm_xor_si128(image_crc32_fold(x2, k128), x3);
+
+	for (; nbytes >= 16; nbytes -= 16) {
+		x3 = _mm_xor_si128(image_crc32_fold(x3, k128), LOAD(0));
+		buffer += 16;
+	}
+#undef LOAD
+
+	_mm_storeu_si128((__m128i *)rem, _mm_shuffle_epi8(x3, bswap));
+	crc = image_crc32_slice8(0, rem, sizeof(rem));
+	return image_crc32_slice8(crc, buffer, nbytes);
+}
+#endif
+
+static uint32_t (*image_crc32)(uint32_t crc, const uint8_t *buffer, size_t nbytes);
+
+static void image_crc32_init(void)
+{
 	static bool first_init;
-	if (!first_init) {
-		/* Initialize the CRC table and the decoding table.  */
-		int i, j;
-		unsigned int c;
-		for (i = 0; i < 256; i++) {
-			/* as per gdb */
-			for (c = i << 24, j = 8; j > 0; --j)
-				c = c & 0x80000000 ? (c << 1) ^ 0x04c11db7 : (c << 1);
-			crc32_table[i] = c;
+	int i, j, k;
+	unsigned int c;
+
+	if (first_init)
+		return;
+
+	/* Initialize the CRC table and the decoding table.  */
+	for (i = 0; i < 256; i++) {
+		/* as per gdb */
+		for (c = i << 24, j = 8; j > 0; --j)
+			c = c & 0x80000000 ? (c << 1) ^ 0x04c11db7 : (c << 1);
+		crc32_table[0][i] = c;
+	}
+	for (i = 0; i < 256; i++) {
+		c = crc32_table[0][i];
+		for (k = 1; k < 8; k++) {
+			c = (c << 8) ^ crc32_table[0][c >> 24];
+			crc32_table[k][i] = c;
 		}
+	}
 
-		first_init = true;
+	image_crc32 = image_crc32_slice8;
+
+#ifdef IMAGE_CRC32_PCLMUL
+	crc32_fold512[1] = image_crc32_xpow(512 + 64);
+	crc32_fold512[0] = image_crc32_xpow(512);
+	crc32_fold128[1] = image_crc32_xpow(128 + 64);
+	crc32_fold128[0] = image_crc32_xpow(128);
+
+	/* GCC only knows "pclmul" for __builtin_cpu_supports() in recent
+	 * releases, so ask CPUID directly */
+	unsigned eax, ebx, ecx, edx;
+	if (__get_cpuid(1, &eax, &ebx, &ecx, &edx) &&
+			(ecx & bit_PCLMUL) && (ecx & bit_SSSE3)) {
+		/* self-check on an odd length before trusting it */
+		uint8_t test[1031];
+		for (i = 0; i < (int)sizeof(test); i++)
+			test[i] = i * 167 + 13;
+		if (image_crc32_pclmul(0xffffffff, test, sizeof(test)) ==
+				image_crc32_bytewise(0xffffffff, test, sizeof(test)))
+			image_crc32 = image_crc32_pclmul;
+		else
+			LOG_ERROR("BUG: PCLMULQDQ CRC32 self-check failed, using tables");
 	}
+#endif
+	LOG_DEBUG("using %s CRC32", image_crc32 == image_crc32_slice8 ?
+			"slicing-by-8" : "PCLMULQDQ");
+
+	first_init = true;
+}
+
+int image_update_checksum(const uint8_t *buffer, uint32_t nbytes, uint32_t *checksum)
+{
+	uint32_t crc = *checksum;
+
+	image_crc32_init();
 
 	while (nbytes > 0) {
-		int run = nbytes;
+		uint32_t run = nbytes;
 		if (run > 32768)
 			run = 32768;
+		crc = image_crc32(crc, buffer, run);
+		buffer += run;
 		nbytes -= run;
-		while (run--) {
-			/* as per gdb */
-			crc = (crc << 8) ^ crc32_table[((crc >> 24) ^ *buffer++) & 255];
-		}
 		keep_alive();
 	}
 
-	LOG_DEBUG("Calculating checksum done");
-
 	*checksum = crc;
 	return ERROR_OK;
 }
+
+static const struct {
+	const char *name;
+	uint32_t (*crc32)(uint32_t crc, const uint8_t *buffer, size_t nbytes);
+} image_crc32_variants[] = {
+	{ "bytewise", image_crc32_bytewise },
+	{ "slice8", image_crc32_slice8 },
+#ifdef IMAGE_CRC32_PCLMUL
+	{ "pclmul", image_crc32_pclmul },
+#endif
+};
+
+COMMAND_HANDLER(handle_crc_benchmark_command)
+{
+	const size_t max_size = 64 << 20;
+	uint32_t seed = 0x2545f491;
+	int retval = ERROR_OK;
+
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	image_crc32_init();
+
+	/* one spare byte to also check an unaligned start */
+	uint8_t *buffer = malloc(max_size + 1);
+	if (!buffer) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	for (size_t i = 0; i < max_size + 1; i++) {
+		seed ^= seed << 13;
+		seed ^= seed >> 17;
+		seed ^= seed << 5;
+		buffer[i] = seed;
+	}
+
+	/* bit identical results on every length up to a few folds and on
+	 * unaligned starts */
+	for (size_t len = 0; len <= 300; len++) {
+		uint32_t expect = image_crc32_bytewise(0xffffffff, buffer + 1, len);
+		for (unsigned v = 1; v < ARRAY_SIZE(image_crc32_variants); v++) {
+			if (image_crc32_variants[v].crc32(0xffffffff, buffer + 1, len) != expect) {
+				command_print(CMD_CTX, "%s: CRC differs from the byte at a time table "
+					"for %zu bytes", image_crc32_variants[v].name, len);
+				retval = ERROR_FAIL;
+				goto out;
+			}
+		}
+	}
+
+	for (size_t size = 1 << 10; size <= max_size; size *= 4) {
+		/* roughly 64 MiB per variant */
+		unsigned iterations = (64 << 20) / size;
+		uint32_t expect = 0;
+
+		for (unsigned v = 0; v < ARRAY_SIZE(image_crc32_variants); v++) {
+			struct duration bench;
+			uint32_t crc = 0;
+
+			duration_start(&bench);
+			for (unsigned i = 0; i < iterations; i++)
+				crc = image_crc32_variants[v].crc32(0xffffffff, buffer, size);
+			duration_measure(&bench);
+			keep_alive();
+
+			if (v == 0)
+				expect = crc;
+			else if (crc != expect) {
+				command_print(CMD_CTX, "%s: CRC differs from the byte at a time table "
+					"for %zu bytes", image_crc32_variants[v].name, size);
+				retval = ERROR_FAIL;
+				goto out;
+			}
+
+			command_print(CMD_CTX, "%8zu KiB %-8s crc 0x%08" PRIx32 " %12.3f KiB/s",
+				size >> 10, image_crc32_variants[v].name, crc,
+				duration_kbps(&bench, (size_t)iterations * size));
+		}
+	}
+
+out:
+	free(buffer);
+	return retval;
+}
+
+const struct command_registration image_command_handlers[] = {
+	{
+		.name = "crc_benchmark",
+		.handler = handle_crc_benchmark_command,
+		.mode = COMMAND_ANY,
+		.help = "Check that the CRC32 implementations used for image "
+			"checksums agree and report their throughput for "
+			"1 KiB to 64 MiB buffers.",
+		.usage = "",
+	},
+	COMMAND_REGISTRATION_DONE
+};
@@ -27,6 +27,7 @@
 #ifndef IMAGE_H
 #define IMAGE_H
 
+#include <helper/command.h>
 #include <helper/fileio.h>
 
 #ifdef HAVE_ELF_H
@@ -67,6 +68,8 @@ struct image {
 
 struct image_binary {
 	struct fileio fileio;
+	const uint8_t *map;		/* file contents when mapped, or NULL */
+	size_t map_size;
 };
 
 struct image_ihex {
@@ -86,6 +89,8 @@ struct image_elf {
 	Elf32_Phdr *segments;
 	uint32_t segment_count;
 	uint8_t endianness;
+	const uint8_t *map;		/* file contents when mapped, or NULL */
+	size_t map_size;
 };
 
 struct image_mot {
@@ -96,6 +101,11 @@ struct image_mot {
 int image_open(struct image *image, const char *url, const char *type_string);
 int image_read_section(struct image *image, int section, uint32_t offset,
 		uint32_t size, uint8_t *buffer, size_t *size_read);
+/* Points *data at section contents held in memory (mapped file or parsed
+ * buffer), valid until image_close(). *data is NULL when the image type
+ * has no such view, image_read_section() must be used then. */
+int image_section_view(struct image *image, int section, uint32_t offset,
+		uint32_t size, const uint8_t **data);
 void image_close(struct image *image);
 
 int image_add_section(struct image *image, uint32_t base, uint32_t size,
@@ -103,10 +113,15 @@ int image_add_section(struct image *image, uint32_t base, uint32_t size,
 
 int image_calculate_checksum(uint8_t *buffer, uint32_t nbytes,
 		uint32_t *checksum);
+/* continue a checksum, *checksum must start out as 0xffffffff */
+int image_update_checksum(const uint8_t *buffer, uint32_t nbytes,
+		uint32_t *checksum);
 
 #define ERROR_IMAGE_FORMAT_ERROR	(-1400)
 #define ERROR_IMAGE_TYPE_UNKNOWN	(-1401)
 #define ERROR_IMAGE_TEMPORARILY_UNAVAILABLE		(-1402)
 #define ERROR_IMAGE_CHECKSUM		(-1403)
 
+extern const struct command_registration image_command_handlers[];
+
 #endif /* IMAGE_H */
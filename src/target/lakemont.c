@@ -54,8 +54,9 @@ static int exit_probemode(struct target *t);
 static int halt_prep(struct target *t);
 static int do_halt(struct target *t);
 static int do_resume(struct target *t);
-static int read_all_core_hw_regs(struct target *t);
-static int write_all_core_hw_regs(struct target *t);
+static bool is_pm_clobbered_reg(int reg);
+static int read_eager_core_hw_regs(struct target *t);
+static int write_dirty_core_hw_regs(struct target *t);
 static int read_hw_reg(struct target *t,
 			int reg, uint32_t *regval, uint8_t cache);
 static int write_hw_reg(struct target *t,
@@ -65,6 +66,9 @@ static struct reg_cache *lakemont_build_reg_cache
 static int submit_reg_pir(struct target *t, int num);
 static int submit_instruction_pir(struct target *t, int num);
 static int submit_pir(struct target *t, uint64_t op);
+static int queue_read_hw_reg(struct target *t, int reg, uint8_t *regval);
+static int queue_write_hw_reg(struct target *t, int reg, uint32_t regval);
+static int queue_instruction(struct target *t, int num);
 static int lakemont_get_core_reg(struct reg *reg);
 static int lakemont_set_core_reg(struct reg *reg, uint8_t *buf);
 
@@ -304,8 +308,8 @@ static int drscan(struct target *t, uint8_t *out, uint8_t *in, uint8_t len)
 static int save_context(struct target *t)
 {
 	int err;
-	/* read core registers from lakemont sram */
-	err = read_all_core_hw_regs(t);
+	/* read core registers from lakemont sram, the rest are read on demand */
+	err = read_eager_core_hw_regs(t);
 	if (err != ERROR_OK) {
 		LOG_ERROR("%s error reading regs", __func__);
 		return err;
@@ -320,7 +324,7 @@ static int restore_context(struct target *t)
 	struct x86_32_common *x86_32 = target_to_x86_32(t);
 
 	/* write core regs into the core PM SRAM from the reg_cache */
-	err = write_all_core_hw_regs(t);
+	err = write_dirty_core_hw_regs(t);
 	if (err != ERROR_OK) {
 		LOG_ERROR("%s error writing regs", __func__);
 		return err;
@@ -337,17 +341,28 @@ static int restore_context(struct target *t)
  * we keep reg_cache in sync with hardware at halt/resume time, we avoid
  * writing to real hardware here bacause pm_regs reflects the hardware
  * while we are halted then reg_cache syncs with hw on resume
- * TODO - in order for "reg eip force" to work it assume get/set reads
- * and writes from hardware, may be other reasons also because generally
- * other openocd targets read/write from hardware in get/set - watch this!
+ * only the eager regs are read at halt time, any other reg is read from
+ * the core shadow ram the first time it is asked for. regs clobbered by
+ * probemode are never re-read as hardware no longer holds their values.
  */
 static int lakemont_get_core_reg(struct reg *reg)
 {
 	int retval = ERROR_OK;
+	uint32_t regval;
 	struct lakemont_core_reg *lakemont_reg = reg->arch_info;
 	struct target *t = lakemont_reg->target;
+	struct x86_32_common *x86_32 = lakemont_reg->x86_32_common;
 	if (check_not_halted(t))
 		return ERROR_TARGET_NOT_HALTED;
+	if (!reg->valid && !is_pm_clobbered_reg(reg->number)) {
+		retval = read_hw_reg(t, reg->number, &regval, 1);
+		if (retval != ERROR_OK) {
+			LOG_ERROR("%s error reading reg %s", __func__, reg->name);
+			return retval;
+		}
+		x86_32->reg_stats.lazy_fetched++;
+		x86_32->reg_stats.last_fetched++;
+	}
 	LOG_DEBUG("reg=%s, value=0x%08" PRIx32, reg->name,
 			buf_get_u32(reg->value, 0, 32));
 	return retval;
@@ -620,42 +635,67 @@ static int do_resume(struct target *t)
 	return target_call_event_callbacks(t, TARGET_EVENT_RESUMED);
 }
 
-static int read_all_core_hw_regs(struct target *t)
+/*
+ * probemode overwrites these regs in hardware (halt_prep, memory and io
+ * access, msr and cpuid) so they have to be saved on every entry and
+ * written back on every exit regardless of the dirty flag; other regs an
+ * instruction overwrites are handled by save_instruction_clobbered_regs()
+ */
+static bool is_pm_clobbered_reg(int reg)
+{
+	if (NOT_AVAIL_REG == regs[reg].pm_idx)
+		return false;
+	return NOT_PMREG != regs[reg].pm_idx || reg == CSB || reg == CSL;
+}
+
+static int read_eager_core_hw_regs(struct target *t)
 {
 	int err;
 	uint32_t regval;
-	unsigned i;
+	unsigned i, count = 0;
 	struct x86_32_common *x86_32 = target_to_x86_32(t);
 	for (i = 0; i < (x86_32->cache->num_regs); i++) {
 		if (NOT_AVAIL_REG == regs[i].pm_idx)
 			continue;
+		if (!is_pm_clobbered_reg(i) &&
+				!(i < X86_32_NUM_REGS && x86_32->eager_regs[i]))
+			continue;
 		err = read_hw_reg(t, regs[i].id, &regval, 1);
 		if (err != ERROR_OK) {
 			LOG_ERROR("%s error saving reg %s",
 					__func__, x86_32->cache->reg_list[i].name);
 			return err;
 		}
+		count++;
 	}
-	LOG_DEBUG("read_all_core_hw_regs read %u registers ok", i);
+	x86_32->reg_stats.halts++;
+	x86_32->reg_stats.eager_fetched += count;
+	x86_32->reg_stats.last_fetched = count;
+	LOG_DEBUG("%s read %u registers ok", __func__, count);
 	return ERROR_OK;
 }
 
-static int write_all_core_hw_regs(struct target *t)
+static int write_dirty_core_hw_regs(struct target *t)
 {
 	int err;
-	unsigned i;
+	unsigned i, count = 0;
 	struct x86_32_common *x86_32 = target_to_x86_32(t);
 	for (i = 0; i < (x86_32->cache->num_regs); i++) {
 		if (NOT_AVAIL_REG == regs[i].pm_idx)
 			continue;
+		if (!is_pm_clobbered_reg(i) && !x86_32->cache->reg_list[i].dirty)
+			continue;
 		err = write_hw_reg(t, i, 0, 1);
 		if (err != ERROR_OK) {
 			LOG_ERROR("%s error restoring reg %s",
 					__func__, x86_32->cache->reg_list[i].name);
 			return err;
 		}
+		count++;
 	}
-	LOG_DEBUG("write_all_core_hw_regs wrote %u registers ok", i);
+	x86_32->reg_stats.written += count;
+	x86_32->reg_stats.last_written = count;
+	LOG_DEBUG("%s wrote %u registers ok", __func__, count);
 	return ERROR_OK;
 }
 
@@ -729,6 +769,59 @@ static int write_hw_reg(struct target *t, int reg, uint32_t regval, uint8_t cach
 	return ERROR_OK;
 }
 
+/*
+ * queue read of lakemont core shadow ram reg without flushing, regval is
+ * filled in when the jtag queue gets executed and must stay valid until then,
+ * reg cache is not updated
+ */
+static int queue_read_hw_reg(struct target *t, int reg, uint8_t *regval)
+{
+	struct x86_32_common *x86_32 = target_to_x86_32(t);
+	x86_32->flush = 0;
+	if (submit_reg_pir(t, reg) != ERROR_OK)
+		return ERROR_FAIL;
+	if (submit_instruction_pir(t, SRAMACCESS) != ERROR_OK)
+		return ERROR_FAIL;
+	if (submit_instruction_pir(t, SRAM2PDR) != ERROR_OK)
+		return ERROR_FAIL;
+	scan.out[0] = RDWRPDR;
+	if (irscan(t, scan.out, NULL, LMT_IRLEN) != ERROR_OK)
+		return ERROR_FAIL;
+	if (drscan(t, NULL, regval, PDR_SIZE) != ERROR_OK)
+		return ERROR_FAIL;
+	return ERROR_OK;
+}
+
+/* queue write of lakemont core shadow ram reg without flushing */
+static int queue_write_hw_reg(struct target *t, int reg, uint32_t regval)
+{
+	struct x86_32_common *x86_32 = target_to_x86_32(t);
+	uint8_t reg_buf[4];
+	buf_set_u32(reg_buf, 0, 32, regval);
+
+	x86_32->flush = 0;
+	if (submit_reg_pir(t, reg) != ERROR_OK)
+		return ERROR_FAIL;
+	if (submit_instruction_pir(t, SRAMACCESS) != ERROR_OK)
+		return ERROR_FAIL;
+	scan.out[0] = RDWRPDR;
+	if (irscan(t, scan.out, NULL, LMT_IRLEN) != ERROR_OK)
+		return ERROR_FAIL;
+	if (drscan(t, reg_buf, scan.in, PDR_SIZE) != ERROR_OK)
+		return ERROR_FAIL;
+	if (submit_instruction_pir(t, PDR2SRAM) != ERROR_OK)
+		return ERROR_FAIL;
+	return ERROR_OK;
+}
+
+/* queue instruction submission without flushing */
+static int queue_instruction(struct target *t, int num)
+{
+	struct x86_32_common *x86_32 = target_to_x86_32(t);
+	x86_32->flush = 0;
+	return submit_instruction_pir(t, num);
+}
+
 static bool is_paging_enabled(struct target *t)
 {
 	struct x86_32_common *x86_32 = target_to_x86_32(t);
@@ -808,9 +901,45 @@ static int transaction_status(struct target *t)
 
 }
 
+/*
+ * instructions run in probemode that overwrite registers outside the
+ * is_pm_clobbered_reg() set: the old value is fetched into the cache and
+ * marked dirty, so that it is written back on resume
+ */
+static int save_instruction_clobbered_regs(struct target *t, int num)
+{
+	struct x86_32_common *x86_32 = target_to_x86_32(t);
+	struct reg *reg;
+	uint32_t regval;
+
+	if (num != CPUID)
+		return ERROR_OK;
+
+	/* cpuid returns its results in eax, ebx, ecx and edx */
+	reg = &x86_32->cache->reg_list[EBX];
+	if (!reg->valid) {
+		/* read_hw_reg() flushes its own scans, keep the caller's batching */
+		int flush = x86_32->flush;
+		int err = read_hw_reg(t, EBX, &regval, 1);
+		x86_32->flush = flush;
+		if (err != ERROR_OK) {
+			LOG_ERROR("%s error saving reg %s", __func__, reg->name);
+			return err;
+		}
+		x86_32->reg_stats.lazy_fetched++;
+		x86_32->reg_stats.last_fetched++;
+	}
+	reg->dirty = 1;
+	return ERROR_OK;
+}
+
 static int submit_instruction(struct target *t, int num)
 {
-	int err = submit_instruction_pir(t, num);
+	int err = save_instruction_clobbered_regs(t, num);
+	if (err != ERROR_OK)
+		return err;
+
+	err = submit_instruction_pir(t, num);
 	if (err != ERROR_OK) {
 		LOG_ERROR("%s error submitting pir", __func__);
 		return err;
@@ -918,6 +1047,9 @@ int lakemont_init_arch_info(struct target *t, struct x86_32_common *x86_32)
 	x86_32->is_paging_enabled = is_paging_enabled;
 	x86_32->disable_paging = disable_paging;
 	x86_32->enable_paging = enable_paging;
+	x86_32->queue_read_hw_reg = queue_read_hw_reg;
+	x86_32->queue_write_hw_reg = queue_write_hw_reg;
+	x86_32->queue_instruction = queue_instruction;
 	return ERROR_OK;
 }
 
@@ -986,21 +1118,10 @@ int lakemont_poll(struct target *t)
 					LOG_USER("hit hardware breakpoint (hwreg=%" PRIu32 ") at 0x%08" PRIx32, hwbreakpoint, eip);
 				} else {
 					uint32_t address = 0;
-					switch (hwbreakpoint) {
-					default:
-					case 0:
-						address = buf_get_u32(x86_32->cache->reg_list[DR0].value, 0, 32);
-					break;
-					case 1:
-						address = buf_get_u32(x86_32->cache->reg_list[DR1].value, 0, 32);
-					break;
-					case 2:
-						address = buf_get_u32(x86_32->cache->reg_list[DR2].value, 0, 32);
-					break;
-					case 3:
-						address = buf_get_u32(x86_32->cache->reg_list[DR3].value, 0, 32);
-					break;
-					}
+					struct reg *dr = &x86_32->cache->reg_list[DR0 + hwbreakpoint];
+					/* debug address regs are not part of the eager set */
+					if (lakemont_get_core_reg(dr) == ERROR_OK)
+						address = buf_get_u32(dr->value, 0, 32);
 					LOG_USER("hit '%s' watchpoint for 0x%08" PRIx32 " (hwreg=%" PRIu32 ") at 0x%08" PRIx32,
 								type == DR7_BP_WRITE ? "write" : "access", address,
 								hwbreakpoint, eip);
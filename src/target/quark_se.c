@@ -68,6 +68,7 @@ int quark_se_target_create(struct target *t, Jim_Interp *interp)
 
 int quark_se_init_target(struct command_context *cmd_ctx, struct target *t)
 {
+	quark_se_flash_init_config(cmd_ctx->interp);
 	return lakemont_init_target(cmd_ctx, t);
 }
 
@@ -170,6 +171,45 @@ static int quark_se_target_reset(struct target *t)
 	return ERROR_OK;
 }
 
+/* Flash programming tunables, read from Tcl variables once at init */
+static struct {
+	bool init;
+	/* OTP-ROM bit protection */
+	/* by default we don't enable writing to the OTP bit */
+	long otp_write_enabled;
+	/* Wait for FLASH_STTS for every word write */
+	/* by default we don't need to wait, JTAG mem writes take long enough */
+	long flash_word_write_wait;
+	/* Avoid to erase page by page and wait FLASH_STTS for page delete */
+	/* by default we erase page by page */
+	long flash_page_erase_disabled;
+} flash_config;
+
+static void quark_se_get_tunable(Jim_Interp *interp, const char *name, long *value)
+{
+	Jim_Obj *obj = Jim_GetGlobalVariableStr(interp, name, JIM_NONE);
+	if (obj != NULL) {
+		int result = Jim_GetLong(interp, obj, value);
+		LOG_DEBUG("%s - result %d, val %ld", name, result, *value);
+	}
+}
+
+/*
+ * Read flash programming tunables. Called at target init, after configuration
+ * scripts have set the variables, so that flash writes don't have to look
+ * them up on every call.
+ */
+void quark_se_flash_init_config(Jim_Interp *interp)
+{
+	quark_se_get_tunable(interp, "QUARK_SE_OTP_WRITE_ENABLED",
+			&flash_config.otp_write_enabled);
+	quark_se_get_tunable(interp, "QUARK_SE_FLASH_WORD_WRITE_WAIT",
+			&flash_config.flash_word_write_wait);
+	quark_se_get_tunable(interp, "QUARK_SE_FLASH_PAGE_ERASE_DISABLED",
+			&flash_config.flash_page_erase_disabled);
+	flash_config.init = true;
+}
+
 static int quark_se_wait_flash_mask(struct target *t, uint32_t addr, uint32_t bit_mask)
 {
 	int cnt = 100;
@@ -210,37 +250,8 @@ int quark_se_flash_write(struct target *t, uint32_t addr,
 	uint32_t FC_WR_DATA;      /* 32bit register of data to be write */
 	uint32_t FC_STTS;         /* Notifies when write/erase is done */
 
-	/* OTP-ROM bit protection */
-	/* by default we don't enable writing to the OTP bit */
-	Jim_Obj *otp_write_enabled_obj;
-	long otp_write_enabled = 0;
-
-	/* Wait for FLASH_STTS for every word write */
-	/* by default we don't need to wait, JTAG mem writes take long enough */
-	Jim_Obj *flash_word_write_wait_obj;
-	long flash_word_write_wait = 0;
-
-	/* Avoid to erase page by page and wait FLASH_STTS for page delete */
-	/* by default we erase page by page */
-	Jim_Obj *flash_page_erase_disabled_obj;
-	long flash_page_erase_disabled = 0;
-
-	/* TODO: check if the TCL calls below are expensive, in case move the code to a better place */
-	otp_write_enabled_obj = Jim_GetGlobalVariableStr(global_cmd_ctx->interp, "QUARK_SE_OTP_WRITE_ENABLED", JIM_NONE);
-	if (otp_write_enabled_obj != NULL) {
-		int result = Jim_GetLong(global_cmd_ctx->interp, otp_write_enabled_obj, &otp_write_enabled);
-		LOG_DEBUG("otp_write_enabled - result %d, val %ld", result, otp_write_enabled);
-	}
-	flash_word_write_wait_obj = Jim_GetGlobalVariableStr(global_cmd_ctx->interp, "QUARK_SE_FLASH_WORD_WRITE_WAIT", JIM_NONE);
-	if (flash_word_write_wait_obj != NULL) {
-		int result = Jim_GetLong(global_cmd_ctx->interp, flash_word_write_wait_obj, &flash_word_write_wait);
-		LOG_DEBUG("flash_word_write_wait - result %d, val %ld", result, flash_word_write_wait);
-	}
-	flash_page_erase_disabled_obj = Jim_GetGlobalVariableStr(global_cmd_ctx->interp, "QUARK_SE_FLASH_PAGE_ERASE_DISABLED", JIM_NONE);
-	if (flash_page_erase_disabled_obj != NULL) {
-		int result = Jim_GetLong(global_cmd_ctx->interp, flash_page_erase_disabled_obj, &flash_page_erase_disabled);
-	    LOG_DEBUG("flash_page_erase_disabled - result %d, val %ld", result, flash_page_erase_disabled);
-	}
+	if (!flash_config.init)
+		quark_se_flash_init_config(global_cmd_ctx->interp);
 
 	/* Select control registers based on the desired flashing region */
 	if ((addr >= FLASH1_BASE_ADDR) && (addr <= FLASH1_LIMT)) {
@@ -274,6 +285,11 @@ int quark_se_flash_write(struct target *t, uint32_t addr,
 		if ((addr == ROM_BASE_ADDR) && ((buf[0] & 0x1) == 0)) {
 			LOG_USER("Trying to clear the OTP bit at address 0xFFFFE000, "
 					"this will lock further writes to the flash ROM after reset.");
+			/* Variable is checked right away, this path is too rare to
+			 * require setting it before init. */
+			long otp_write_enabled = flash_config.otp_write_enabled;
+			quark_se_get_tunable(global_cmd_ctx->interp,
+					"QUARK_SE_OTP_WRITE_ENABLED", &otp_write_enabled);
 			if (otp_write_enabled != 1) {
 				LOG_ERROR("The QUARK_SE_OTP_WRITE_ENABLED variable isn't set to 1 "
 						"so the operation wasn't performed.");
@@ -355,13 +371,15 @@ int quark_se_flash_write(struct target *t, uint32_t addr,
 			rest_count = 0;
 		}
 
-		/* Save Page */
-		if (target_read_memory(t, flash_page_start, 4, 512, &data_buff[0]) != ERROR_OK) {
-			LOG_ERROR("%s: Couldn't save content of page #%d. Request failed!", __func__, flash_page_num);
-			return ERROR_FAIL;
+		/* Save Page, unless it is going to be overwritten completely */
+		if (page_count < FC_BYTE_PAGE_SIZE) {
+			if (target_read_memory(t, flash_page_start, 4, 512, &data_buff[0]) != ERROR_OK) {
+				LOG_ERROR("%s: Couldn't save content of page #%d. Request failed!", __func__, flash_page_num);
+				return ERROR_FAIL;
+			}
 		}
 
-		if (!flash_page_erase_disabled) {
+		if (!flash_config.flash_page_erase_disabled) {
 			/* Erase Page */
 			buf_set_u32(ctl_buff, 0, 32, ((flash_addr << FC_WR_CTL_ADDR) | FC_WR_CTR_DREQ));
 			if (target_write_memory(t, FC_WR_CTL, 4, 1, ctl_buff) != ERROR_OK) {
@@ -380,6 +398,13 @@ int quark_se_flash_write(struct target *t, uint32_t addr,
 		memcpy(&data_buff[0] + flash_page_offset, buf, page_count);
 		for (uint32_t i = 0; i < 512; i++) {
 
+			/* Erased flash reads as all ones, no need to program such words */
+			if (!flash_config.flash_page_erase_disabled &&
+					buf_get_u32(&data_buff[i*4], 0, 32) == 0xFFFFFFFF) {
+				copy_addr += 4;
+				continue;
+			}
+
 			/* Write word data */
 			if (target_write_memory(t, FC_WR_DATA, 4, 1, &data_buff[i*4]) != ERROR_OK) {
 				LOG_ERROR("%s: Couldn't write WR_DATA register in SRAM", __func__);
@@ -394,7 +419,7 @@ int quark_se_flash_write(struct target *t, uint32_t addr,
 			}
 
 			/* Check for FLASH_STTS */
-			if (flash_word_write_wait) {
+			if (flash_config.flash_word_write_wait) {
 				if (quark_se_wait_flash_mask(t, FC_STTS, FC_STTS_WR_DONE) != ERROR_OK) {
 					LOG_ERROR("%s: Bit WR_DONE in FLASH_STTS Timeout!", __func__);
 					return ERROR_FAIL;
@@ -64,6 +64,7 @@
 #define FC_BYTE_PAGE_SIZE (4*512)
 
 /* public interface */
+void quark_se_flash_init_config(Jim_Interp *interp);
 int quark_se_flash_write(struct target *t, uint32_t addr,
 			uint32_t size, uint32_t count, const uint8_t *buf);
 
@@ -68,6 +68,7 @@ static int target_array2mem(Jim_Interp *interp, struct target *target,
 static int target_mem2array(Jim_Interp *interp, struct target *target,
 		int argc, Jim_Obj * const *argv);
 static int target_register_user_commands(struct command_context *cmd_ctx);
+static void target_mem_cache_invalidate_all(struct target *target);
 static int target_get_gdb_fileio_info_default(struct target *target,
 		struct gdb_fileio_info *fileio_info);
 static int target_gdb_fileio_end_default(struct target *target, int retcode,
@@ -764,6 +765,7 @@ int target_run_algorithm(struct target *target,
 		goto done;
 	}
 
+	target_mem_cache_invalidate_all(target);
 	target->running_alg = true;
 	retval = target->type->run_algorithm(target,
 			num_mem_params, mem_params,
@@ -804,6 +806,7 @@ int target_start_algorithm(struct target *target,
 		goto done;
 	}
 
+	target_mem_cache_invalidate_all(target);
 	target->running_alg = true;
 	retval = target->type->start_algorithm(target,
 			num_mem_params, mem_params,
@@ -1019,6 +1022,7 @@ int target_write_memory(struct target *target,
 		LOG_ERROR("Target not examined yet");
 		return ERROR_FAIL;
 	}
+	target_mem_cache_invalidate(target, address, size * count);
 	return target->type->write_memory(target, address, size, count, buffer);
 }
 
@@ -1029,6 +1033,8 @@ int target_write_phys_memory(struct target *target,
 		LOG_ERROR("Target not examined yet");
 		return ERROR_FAIL;
 	}
+	/* the cache is indexed by virtual address, don't guess the mapping */
+	target_mem_cache_invalidate_all(target);
 	return target->type->write_phys_memory(target, address, size, count, buffer);
 }
 
@@ -1039,6 +1045,7 @@ int target_add_breakpoint(struct target *target,
 		LOG_WARNING("target %s is not halted", target_name(target));
 		return ERROR_TARGET_NOT_HALTED;
 	}
+	target_mem_cache_invalidate(target, breakpoint->address, breakpoint->length);
 	return target->type->add_breakpoint(target, breakpoint);
 }
 
@@ -1065,6 +1072,7 @@ int target_add_hybrid_breakpoint(struct target *target,
 int target_remove_breakpoint(struct target *target,
 		struct breakpoint *breakpoint)
 {
+	target_mem_cache_invalidate(target, breakpoint->address, breakpoint->length);
 	return target->type->remove_breakpoint(target, breakpoint);
 }
 
@@ -1109,6 +1117,7 @@ int target_get_gdb_reg_list(struct target *target,
 int target_step(struct target *target,
 		int current, uint32_t address, int handle_breakpoints)
 {
+	target_mem_cache_invalidate_all(target);
 	return target->type->step(target, current, address, handle_breakpoints);
 }
 
@@ -1394,6 +1403,9 @@ int target_call_event_callbacks(struct target *target, enum target_event event)
 	struct target_event_callback *callback = target_event_callbacks;
 	struct target_event_callback *next_callback;
 
+	/* resume, reset, halt and flash events all may change memory */
+	target_mem_cache_invalidate_all(target);
+
 	if (event == TARGET_EVENT_HALTED) {
 		/* execute early halted first */
 		target_call_event_callbacks(target, TARGET_EVENT_GDB_HALT);
@@ -1479,6 +1491,24 @@ int target_call_timer_callbacks_now(void)
 	return target_call_timer_callbacks_check_time(0);
 }
 
+int target_timer_next_callback(struct timeval *when)
+{
+	struct target_timer_callback *callback;
+	bool found = false;
+
+	for (callback = target_timer_callbacks; callback; callback = callback->next) {
+		if (!callback->callback)
+			continue;
+		if (!found || callback->when.tv_sec < when->tv_sec ||
+				(callback->when.tv_sec == when->tv_sec &&
+				 callback->when.tv_usec < when->tv_usec))
+			*when = callback->when;
+		found = true;
+	}
+
+	return found ? ERROR_OK : ERROR_FAIL;
+}
+
 /* Prints the working area layout for debug purposes */
 static void print_wa_layout(struct target *target)
 {
@@ -1872,6 +1902,7 @@ int target_write_buffer(struct target *target, uint32_t address, uint32_t size,
 		return ERROR_FAIL;
 	}
 
+	target_mem_cache_invalidate(target, address, size);
 	return target->type->write_buffer(target, address, size, buffer);
 }
 
@@ -1969,39 +2000,215 @@ static int target_read_buffer_default(struct target *target, uint32_t address, u
 	return ERROR_OK;
 }
 
-int target_checksum_memory(struct target *target, uint32_t address, uint32_t size, uint32_t* crc)
+/* Host side read cache, filled on demand while the target is halted.
+ * Direct mapped, indexed by line number. */
+#define MEM_CACHE_LINE_SIZE		256
+#define MEM_CACHE_LINES			256
+/* lines read ahead of a miss */
+#define MEM_CACHE_PREFETCH		1
+/* upper bound for the lines filled by a single link transaction */
+#define MEM_CACHE_MAX_FILL		16
+
+struct target_mem_cache_line {
+	bool valid;
+	uint32_t address;
+	uint8_t data[MEM_CACHE_LINE_SIZE];
+};
+
+struct target_mem_cache {
+	struct target_mem_cache_line lines[MEM_CACHE_LINES];
+	uint32_t hits;
+	uint32_t misses;
+	uint32_t prefetched;
+	uint32_t invalidations;
+};
+
+static struct target_mem_cache_line *target_mem_cache_line(
+		struct target_mem_cache *cache, uint32_t line_addr)
+{
+	return &cache->lines[(line_addr / MEM_CACHE_LINE_SIZE) % MEM_CACHE_LINES];
+}
+
+static bool target_mem_cache_hit(struct target_mem_cache *cache, uint32_t line_addr)
+{
+	struct target_mem_cache_line *line = target_mem_cache_line(cache, line_addr);
+	return line->valid && line->address == line_addr;
+}
+
+static void target_mem_cache_invalidate_all(struct target *target)
+{
+	struct target_mem_cache *cache = target->mem_cache;
+	if (!cache)
+		return;
+
+	bool dropped = false;
+	for (int i = 0; i < MEM_CACHE_LINES; i++) {
+		dropped |= cache->lines[i].valid;
+		cache->lines[i].valid = false;
+	}
+	if (dropped)
+		cache->invalidations++;
+}
+
+void target_mem_cache_invalidate(struct target *target, uint32_t address, uint32_t size)
+{
+	struct target_mem_cache *cache = target->mem_cache;
+	if (!cache || size == 0)
+		return;
+
+	uint64_t first = address / MEM_CACHE_LINE_SIZE;
+	uint64_t last = ((uint64_t)address + size - 1) / MEM_CACHE_LINE_SIZE;
+	if (last - first + 1 >= MEM_CACHE_LINES) {
+		target_mem_cache_invalidate_all(target);
+		return;
+	}
+
+	bool dropped = false;
+	for (uint64_t n = first; n <= last; n++) {
+		uint32_t line_addr = n * MEM_CACHE_LINE_SIZE;
+		struct target_mem_cache_line *line = target_mem_cache_line(cache, line_addr);
+		if (line->valid && line->address == line_addr) {
+			line->valid = false;
+			dropped = true;
+		}
+	}
+	if (dropped)
+		cache->invalidations++;
+}
+
+/* Read 'count' lines starting at line_addr into the cache. Only the first
+ * 'needed' lines are required by the caller, the rest are read ahead and
+ * dropped from the request if the combined read fails. */
+static int target_mem_cache_fill(struct target *target, uint32_t line_addr,
+		unsigned count, unsigned needed)
+{
+	struct target_mem_cache *cache = target->mem_cache;
+	uint8_t buffer[MEM_CACHE_LINE_SIZE * (MEM_CACHE_MAX_FILL + MEM_CACHE_PREFETCH)];
+
+	int retval = target_read_buffer(target, line_addr, count * MEM_CACHE_LINE_SIZE, buffer);
+	if (retval != ERROR_OK && count > needed) {
+		count = needed;
+		retval = target_read_buffer(target, line_addr, count * MEM_CACHE_LINE_SIZE, buffer);
+	}
+	if (retval != ERROR_OK)
+		return retval;
+
+	for (unsigned i = 0; i < count; i++) {
+		struct target_mem_cache_line *line = target_mem_cache_line(cache, line_addr);
+		line->valid = true;
+		line->address = line_addr;
+		memcpy(line->data, buffer + i * MEM_CACHE_LINE_SIZE, MEM_CACHE_LINE_SIZE);
+		if (i >= needed)
+			cache->prefetched++;
+		line_addr += MEM_CACHE_LINE_SIZE;
+	}
+
+	return ERROR_OK;
+}
+
+int target_read_buffer_cached(struct target *target, uint32_t address, uint32_t size, uint8_t *buffer)
+{
+	struct target_mem_cache *cache = target->mem_cache;
+
+	if (!cache || target->state != TARGET_HALTED || size == 0 ||
+			(address + size - 1) < address)
+		return target_read_buffer(target, address, size, buffer);
+
+	while (size > 0) {
+		uint32_t line_addr = address & ~(uint32_t)(MEM_CACHE_LINE_SIZE - 1);
+		uint32_t offset = address - line_addr;
+		uint32_t n = MIN(MEM_CACHE_LINE_SIZE - offset, size);
+
+		if (target_mem_cache_hit(cache, line_addr)) {
+			cache->hits++;
+		} else {
+			/* gather the run of missing lines covered by this request,
+			 * then append the read-ahead lines that are not cached yet */
+			uint32_t end = address + size - 1;
+			unsigned needed = 1;
+			while (needed < MEM_CACHE_MAX_FILL) {
+				uint32_t next = line_addr + needed * MEM_CACHE_LINE_SIZE;
+				if (next < line_addr || next > end || target_mem_cache_hit(cache, next))
+					break;
+				needed++;
+			}
+			unsigned count = needed;
+			while (count < needed + MEM_CACHE_PREFETCH) {
+				uint32_t next = line_addr + count * MEM_CACHE_LINE_SIZE;
+				if (next < line_addr || target_mem_cache_hit(cache, next))
+					break;
+				count++;
+			}
+
+			cache->misses += needed;
+			int retval = target_mem_cache_fill(target, line_addr, count, needed);
+			if (retval != ERROR_OK) {
+				LOG_DEBUG("memory cache fill at 0x%8.8" PRIx32 " failed, reading uncached",
+						line_addr);
+				return target_read_buffer(target, address, size, buffer);
+			}
+		}
+
+		memcpy(buffer, target_mem_cache_line(cache, line_addr)->data + offset, n);
+		address += n;
+		buffer += n;
+		size -= n;
+	}
+
+	return ERROR_OK;
+}
+
+/* size of the chunks read back when the checksum is computed on the host */
+#define TARGET_CHECKSUM_CHUNK	(64 * 1024)
+
+static int target_checksum_memory_host(struct target *target, uint32_t address,
+		uint32_t size, uint32_t *crc)
 {
 	uint8_t *buffer;
+	uint32_t chunk;
+	int retval = ERROR_OK;
+
+	buffer = malloc(MIN(size, TARGET_CHECKSUM_CHUNK));
+	if (buffer == NULL && size) {
+		LOG_ERROR("error allocating buffer for section (%d bytes)", (int)size);
+		return ERROR_FAIL;
+	}
+
+	/* read and checksum a chunk at a time so memory use doesn't
+	 * depend on the size of the section */
+	*crc = 0xffffffff;
+	while (size > 0) {
+		chunk = MIN(size, TARGET_CHECKSUM_CHUNK);
+		retval = target_read_buffer(target, address, chunk, buffer);
+		if (retval != ERROR_OK)
+			break;
+		image_update_checksum(buffer, chunk, crc);
+		address += chunk;
+		size -= chunk;
+	}
+
+	free(buffer);
+	return retval;
+}
+
+int target_checksum_memory(struct target *target, uint32_t address, uint32_t size, uint32_t* crc)
+{
 	int retval;
-	uint32_t i;
 	uint32_t checksum = 0;
 	if (!target_was_examined(target)) {
 		LOG_ERROR("Target not examined yet");
 		return ERROR_FAIL;
 	}
 
-	retval = target->type->checksum_memory(target, address, size, &checksum);
+	/* the target computes the checksum itself if it can, usually with an
+	 * algorithm in a working area, otherwise it's done on the host */
+	if (target->type->checksum_memory)
+		retval = target->type->checksum_memory(target, address, size, &checksum);
+	else
+		retval = ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
 	if (retval != ERROR_OK) {
-		buffer = malloc(size);
-		if (buffer == NULL) {
-			LOG_ERROR("error allocating buffer for section (%d bytes)", (int)size);
-			return ERROR_COMMAND_SYNTAX_ERROR;
-		}
-		retval = target_read_buffer(target, address, size, buffer);
-		if (retval != ERROR_OK) {
-			free(buffer);
-			return retval;
-		}
-
-		/* convert to target endianness */
-		for (i = 0; i < (size/sizeof(uint32_t)); i++) {
-			uint32_t target_data;
-			target_data = target_buffer_get_u32(target, &buffer[i*sizeof(uint32_t)]);
-			target_buffer_set_u32(target, &buffer[i*sizeof(uint32_t)], target_data);
-		}
-
-		retval = image_calculate_checksum(buffer, size, &checksum);
-		free(buffer);
+		LOG_DEBUG("checksumming 0x%08" PRIx32 "+0x%" PRIx32 " on the host", address, size);
+		retval = target_checksum_memory_host(target, address, size, &checksum);
 	}
 
 	*crc = checksum;
@@ -2963,15 +3170,77 @@ static COMMAND_HELPER(parse_load_image_command_CMD_ARGV, struct image *image,
 	return ERROR_OK;
 }
 
+/* load_image moves sections in pieces of this size, so that the target
+ * transfer starts after the first piece is read and the host buffer
+ * stays small for large images */
+#define LOAD_IMAGE_CHUNK	(64 * 1024)
+
+struct load_image_stats {
+	float file_time;		/* seconds spent reading the image */
+	float target_time;		/* seconds spent writing to the target */
+};
+
+static int load_image_section(struct target *target, struct image *image,
+		int section, uint32_t offset, uint32_t length, uint8_t **buffer,
+		struct load_image_stats *stats)
+{
+	uint32_t address = image->sections[section].base_address + offset;
+	struct duration bench;
+	int retval = ERROR_OK;
+
+	while (length > 0) {
+		uint32_t chunk = MIN(length, LOAD_IMAGE_CHUNK);
+		const uint8_t *data;
+		size_t buf_cnt;
+
+		duration_start(&bench);
+		/* use the section in place when the image holds it in memory */
+		retval = image_section_view(image, section, offset, chunk, &data);
+		if (retval == ERROR_OK && data == NULL) {
+			if (*buffer == NULL) {
+				*buffer = malloc(LOAD_IMAGE_CHUNK);
+				if (*buffer == NULL) {
+					LOG_ERROR("error allocating buffer for section (%d bytes)",
+							LOAD_IMAGE_CHUNK);
+					return ERROR_FAIL;
+				}
+			}
+			retval = image_read_section(image, section, offset, chunk, *buffer, &buf_cnt);
+			if (retval == ERROR_OK && buf_cnt != chunk) {
+				LOG_ERROR("short read from image section %d", section);
+				retval = ERROR_FAIL;
+			}
+			data = *buffer;
+		}
+		if (retval != ERROR_OK)
+			return retval;
+		if (duration_measure(&bench) == ERROR_OK)
+			stats->file_time += duration_elapsed(&bench);
+
+		duration_start(&bench);
+		retval = target_write_buffer(target, address, chunk, data);
+		if (retval != ERROR_OK)
+			return retval;
+		if (duration_measure(&bench) == ERROR_OK)
+			stats->target_time += duration_elapsed(&bench);
+
+		address += chunk;
+		offset += chunk;
+		length -= chunk;
+	}
+
+	return retval;
+}
+
 COMMAND_HANDLER(handle_load_image_command)
 {
-	uint8_t *buffer;
-	size_t buf_cnt;
+	uint8_t *buffer = NULL;
 	uint32_t image_size;
 	uint32_t min_address = 0;
 	uint32_t max_address = 0xffffffff;
 	int i;
 	struct image image;
+	struct load_image_stats stats = { 0, 0 };
 
 	int retval = CALL_COMMAND_HANDLER(parse_load_image_command_CMD_ARGV,
 			&image, &min_address, &max_address);
@@ -2989,22 +3258,8 @@ COMMAND_HANDLER(handle_load_image_command)
 	image_size = 0x0;
 	retval = ERROR_OK;
 	for (i = 0; i < image.num_sections; i++) {
-		buffer = malloc(image.sections[i].size);
-		if (buffer == NULL) {
-			command_print(CMD_CTX,
-						  "error allocating buffer for section (%d bytes)",
-						  (int)(image.sections[i].size));
-			break;
-		}
-
-		retval = image_read_section(&image, i, 0x0, image.sections[i].size, buffer, &buf_cnt);
-		if (retval != ERROR_OK) {
-			free(buffer);
-			break;
-		}
-
 		uint32_t offset = 0;
-		uint32_t length = buf_cnt;
+		uint32_t length = image.sections[i].size;
 
 		/* DANGER!!! beware of unsigned comparision here!!! */
 
@@ -3020,25 +3275,26 @@ COMMAND_HANDLER(handle_load_image_command)
 				length -= offset;
 			}
 
-			retval = target_write_buffer(target,
-					image.sections[i].base_address + offset, length, buffer + offset);
-			if (retval != ERROR_OK) {
-				free(buffer);
+			retval = load_image_section(target, &image, i, offset, length,
+					&buffer, &stats);
+			if (retval != ERROR_OK)
 				break;
-			}
 			image_size += length;
 			command_print(CMD_CTX, "%u bytes written at address 0x%8.8" PRIx32 "",
 					(unsigned int)length,
 					image.sections[i].base_address + offset);
 		}
-
-		free(buffer);
 	}
 
+	free(buffer);
+
 	if ((ERROR_OK == retval) && (duration_measure(&bench) == ERROR_OK)) {
 		command_print(CMD_CTX, "downloaded %" PRIu32 " bytes "
 				"in %fs (%0.3f KiB/s)", image_size,
 				duration_elapsed(&bench), duration_kbps(&bench, image_size));
+		command_print(CMD_CTX, "image reads %fs, target writes %fs (%0.3f KiB/s)",
+				stats.file_time, stats.target_time,
+				stats.target_time > 0 ? image_size / 1024.0 / stats.target_time : 0);
 	}
 
 	image_close(&image);
@@ -5450,17 +5706,265 @@ struct FastLoad {
 static int fastload_num;
 static struct FastLoad *fastload;
 
+/* directory holding prepared fast load images, NULL when disabled */
+static char *fastload_cache_dir;
+/* cache file the current fast load image is mapped from */
+static struct fileio fastload_cache_file;
+static bool fastload_mapped;
+
 static void free_fastload(void)
 {
 	if (fastload != NULL) {
 		int i;
 		for (i = 0; i < fastload_num; i++) {
-			if (fastload[i].data)
+			if (fastload[i].data && !fastload_mapped)
 				free(fastload[i].data);
 		}
 		free(fastload);
 		fastload = NULL;
 	}
+	if (fastload_mapped) {
+		fileio_close(&fastload_cache_file);
+		fastload_mapped = false;
+	}
+}
+
+/* Cache file layout, all words big endian:
+ *   magic, version, 64 bit key, 64 bit image file size,
+ *   length of the argument string, number of sections,
+ *   the arguments (NUL terminated strings back to back),
+ *   address and length of each section,
+ *   section data back to back.
+ * The key only picks the file name, the size and the arguments are
+ * compared as well before a cache file is used. */
+#define FASTLOAD_CACHE_MAGIC	0x4f43464c	/* "OCFL" */
+#define FASTLOAD_CACHE_VERSION	2
+#define FASTLOAD_CACHE_HEADER	32
+
+/* read size for hashing images which can't be mapped */
+#define FASTLOAD_HASH_CHUNK		(64 * 1024)
+
+struct fast_load_cache_id {
+	uint64_t key;		/* hash of the image file and the arguments */
+	uint64_t file_size;
+	char *args;			/* fast_load_image arguments after the file name */
+	size_t args_len;
+};
+
+/* 64 bit FNV-1a */
+#define FASTLOAD_FNV_OFFSET		0xcbf29ce484222325ull
+#define FASTLOAD_FNV_PRIME		0x100000001b3ull
+
+static uint64_t fast_load_hash(uint64_t hash, const uint8_t *data, size_t size)
+{
+	while (size--) {
+		hash ^= *data++;
+		hash *= FASTLOAD_FNV_PRIME;
+	}
+	return hash;
+}
+
+static void fast_load_cache_id_free(struct fast_load_cache_id *id)
+{
+	free(id->args);
+	id->args = NULL;
+}
+
+/* The cache key covers the contents of the image file and all the other
+ * fast_load_image arguments (load offset, type, address window). */
+static int fast_load_cache_key(unsigned argc, const char **argv,
+		struct fast_load_cache_id *id)
+{
+	struct fileio fileio;
+	const uint8_t *data;
+	size_t size;
+	int retval;
+
+	/* only images read from files can be cached */
+	if (argc >= 3 && (strcmp(argv[2], "mem") == 0 || strcmp(argv[2], "build") == 0))
+		return ERROR_FAIL;
+
+	retval = fileio_open(&fileio, argv[0], FILEIO_READ, FILEIO_BINARY);
+	if (retval != ERROR_OK)
+		return retval;
+
+	id->key = FASTLOAD_FNV_OFFSET;
+	id->file_size = 0;
+	retval = fileio_map(&fileio, &data, &size);
+	if (retval == ERROR_OK) {
+		id->key = fast_load_hash(id->key, data, size);
+		id->file_size = size;
+	} else {
+		uint8_t *buffer = malloc(FASTLOAD_HASH_CHUNK);
+		if (buffer == NULL) {
+			fileio_close(&fileio);
+			return ERROR_FAIL;
+		}
+		do {
+			retval = fileio_read(&fileio, FASTLOAD_HASH_CHUNK, buffer, &size);
+			if (retval != ERROR_OK)
+				break;
+			id->key = fast_load_hash(id->key, buffer, size);
+			id->file_size += size;
+			keep_alive();
+		} while (size == FASTLOAD_HASH_CHUNK);
+		free(buffer);
+	}
+	fileio_close(&fileio);
+	if (retval != ERROR_OK)
+		return retval;
+
+	id->args_len = 0;
+	for (unsigned i = 1; i < argc; i++)
+		id->args_len += strlen(argv[i]) + 1;
+	id->args = malloc(id->args_len + 1);
+	if (id->args == NULL)
+		return ERROR_FAIL;
+	char *p = id->args;
+	for (unsigned i = 1; i < argc; i++) {
+		size_t len = strlen(argv[i]) + 1;
+		memcpy(p, argv[i], len);
+		p += len;
+	}
+
+	/* the size is hashed too, so that it and the contents are both
+	 * needed to collide */
+	uint8_t file_size[8];
+	h_u64_to_be(file_size, id->file_size);
+	id->key = fast_load_hash(id->key, file_size, sizeof(file_size));
+	id->key = fast_load_hash(id->key, (const uint8_t *)id->args, id->args_len);
+
+	return ERROR_OK;
+}
+
+/* map a cache file and point the fast load sections into it */
+static int fast_load_cache_open(const char *path, const struct fast_load_cache_id *id)
+{
+	const uint8_t *data;
+	size_t size;
+
+	if (access(path, R_OK) != 0)
+		return ERROR_FILEIO_NOT_FOUND;
+
+	int retval = fileio_open(&fastload_cache_file, path, FILEIO_READ, FILEIO_BINARY);
+	if (retval != ERROR_OK)
+		return retval;
+
+	retval = fileio_map(&fastload_cache_file, &data, &size);
+	if (retval != ERROR_OK) {
+		fileio_close(&fastload_cache_file);
+		return retval;
+	}
+
+	retval = ERROR_FAIL;
+	if (size < FASTLOAD_CACHE_HEADER ||
+			be_to_h_u32(data) != FASTLOAD_CACHE_MAGIC ||
+			be_to_h_u32(data + 4) != FASTLOAD_CACHE_VERSION)
+		goto error;
+
+	/* a file for another image that happens to share the key */
+	if (be_to_h_u64(data + 8) != id->key ||
+			be_to_h_u64(data + 16) != id->file_size ||
+			be_to_h_u32(data + 24) != id->args_len ||
+			size - FASTLOAD_CACHE_HEADER < id->args_len ||
+			memcmp(data + FASTLOAD_CACHE_HEADER, id->args, id->args_len) != 0) {
+		LOG_DEBUG("fast load cache file %s is for another image", path);
+		fileio_close(&fastload_cache_file);
+		return ERROR_FAIL;
+	}
+
+	size_t table = FASTLOAD_CACHE_HEADER + id->args_len;
+	uint32_t num = be_to_h_u32(data + 28);
+	if (num > (size - table) / 8)
+		goto error;
+
+	fastload = calloc(num, sizeof(struct FastLoad));
+	if (fastload == NULL)
+		goto error;
+	fastload_num = num;
+	fastload_mapped = true;
+
+	size_t offset = table + 8 * num;
+	for (uint32_t i = 0; i < num; i++) {
+		const uint8_t *entry = data + table + 8 * i;
+		uint32_t length = be_to_h_u32(entry + 4);
+		if (length > size - offset) {
+			free_fastload();
+			return ERROR_FAIL;
+		}
+		fastload[i].address = be_to_h_u32(entry);
+		fastload[i].length = length;
+		fastload[i].data = length ? (uint8_t *)data + offset : NULL;
+		offset += length;
+	}
+
+	return ERROR_OK;
+
+error:
+	LOG_WARNING("ignoring invalid fast load cache file %s", path);
+	fileio_close(&fastload_cache_file);
+	return retval;
+}
+
+static int fast_load_cache_write(const char *path, const struct fast_load_cache_id *id)
+{
+	struct fileio fileio;
+	size_t written;
+	int retval;
+
+	/* write to a temporary name so that a partial file is never used */
+	char *tmp_path = alloc_printf("%s.tmp", path);
+	if (tmp_path == NULL)
+		return ERROR_FAIL;
+
+	retval = fileio_open(&fileio, tmp_path, FILEIO_WRITE, FILEIO_BINARY);
+	if (retval != ERROR_OK) {
+		free(tmp_path);
+		return retval;
+	}
+
+	retval = fileio_write_u32(&fileio, FASTLOAD_CACHE_MAGIC);
+	if (retval == ERROR_OK)
+		retval = fileio_write_u32(&fileio, FASTLOAD_CACHE_VERSION);
+	if (retval == ERROR_OK)
+		retval = fileio_write_u32(&fileio, id->key >> 32);
+	if (retval == ERROR_OK)
+		retval = fileio_write_u32(&fileio, id->key);
+	if (retval == ERROR_OK)
+		retval = fileio_write_u32(&fileio, id->file_size >> 32);
+	if (retval == ERROR_OK)
+		retval = fileio_write_u32(&fileio, id->file_size);
+	if (retval == ERROR_OK)
+		retval = fileio_write_u32(&fileio, id->args_len);
+	if (retval == ERROR_OK)
+		retval = fileio_write_u32(&fileio, fastload_num);
+	if (retval == ERROR_OK && id->args_len) {
+		retval = fileio_write(&fileio, id->args_len, id->args, &written);
+		if (retval == ERROR_OK && written != id->args_len)
+			retval = ERROR_FILEIO_OPERATION_FAILED;
+	}
+	for (int i = 0; i < fastload_num && retval == ERROR_OK; i++) {
+		retval = fileio_write_u32(&fileio, fastload[i].address);
+		if (retval == ERROR_OK)
+			retval = fileio_write_u32(&fileio, fastload[i].length);
+	}
+	for (int i = 0; i < fastload_num && retval == ERROR_OK; i++) {
+		if (fastload[i].length == 0)
+			continue;
+		retval = fileio_write(&fileio, fastload[i].length, fastload[i].data, &written);
+		if (retval == ERROR_OK && written != (size_t)fastload[i].length)
+			retval = ERROR_FILEIO_OPERATION_FAILED;
+	}
+
+	if (fileio_close(&fileio) != ERROR_OK && retval == ERROR_OK)
+		retval = ERROR_FILEIO_OPERATION_FAILED;
+	if (retval == ERROR_OK && rename(tmp_path, path) != 0)
+		retval = ERROR_FILEIO_OPERATION_FAILED;
+	if (retval != ERROR_OK)
+		unlink(tmp_path);
+
+	free(tmp_path);
+	return retval;
 }
 
 COMMAND_HANDLER(handle_fast_load_image_command)
@@ -5482,9 +5986,27 @@ COMMAND_HANDLER(handle_fast_load_image_command)
 	struct duration bench;
 	duration_start(&bench);
 
+	free_fastload();
+
+	struct fast_load_cache_id cache_id = { .args = NULL };
+	char *cache_path = NULL;
+	if (fastload_cache_dir && fast_load_cache_key(CMD_ARGC, CMD_ARGV, &cache_id) == ERROR_OK) {
+		cache_path = alloc_printf("%s/fastload-%016" PRIx64 ".bin",
+				fastload_cache_dir, cache_id.key);
+		if (cache_path && fast_load_cache_open(cache_path, &cache_id) == ERROR_OK) {
+			command_print(CMD_CTX, "Using cached fast load image %s", cache_path);
+			free(cache_path);
+			fast_load_cache_id_free(&cache_id);
+			return ERROR_OK;
+		}
+	}
+
 	retval = image_open(&image, CMD_ARGV[0], (CMD_ARGC >= 3) ? CMD_ARGV[2] : NULL);
-	if (retval != ERROR_OK)
+	if (retval != ERROR_OK) {
+		free(cache_path);
+		fast_load_cache_id_free(&cache_id);
 		return retval;
+	}
 
 	image_size = 0x0;
 	retval = ERROR_OK;
@@ -5493,6 +6015,8 @@ COMMAND_HANDLER(handle_fast_load_image_command)
 	if (fastload == NULL) {
 		command_print(CMD_CTX, "out of memory");
 		image_close(&image);
+		free(cache_path);
+		fast_load_cache_id_free(&cache_id);
 		return ERROR_FAIL;
 	}
 	memset(fastload, 0, sizeof(struct FastLoad)*image.num_sections);
@@ -5562,10 +6086,34 @@ COMMAND_HANDLER(handle_fast_load_image_command)
 
 	if (retval != ERROR_OK)
 		free_fastload();
+	else if (cache_path && fast_load_cache_write(cache_path, &cache_id) != ERROR_OK)
+		LOG_WARNING("couldn't write fast load cache file %s", cache_path);
+
+	free(cache_path);
+	fast_load_cache_id_free(&cache_id);
 
 	return retval;
 }
 
+COMMAND_HANDLER(handle_fast_load_cache_command)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		free(fastload_cache_dir);
+		fastload_cache_dir = NULL;
+		if (strcmp(CMD_ARGV[0], "disable") != 0)
+			fastload_cache_dir = strdup(CMD_ARGV[0]);
+	}
+
+	if (fastload_cache_dir)
+		command_print(CMD_CTX, "fast load cache directory: %s", fastload_cache_dir);
+	else
+		command_print(CMD_CTX, "fast load cache disabled");
+	return ERROR_OK;
+}
+
 COMMAND_HANDLER(handle_fast_load_command)
 {
 	if (CMD_ARGC > 0)
@@ -5595,6 +6143,51 @@ COMMAND_HANDLER(handle_fast_load_command)
 	return retval;
 }
 
+COMMAND_HANDLER(handle_mem_cache_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		if (strcmp(CMD_ARGV[0], "enable") == 0) {
+			if (!target->mem_cache) {
+				target->mem_cache = calloc(1, sizeof(*target->mem_cache));
+				if (!target->mem_cache) {
+					LOG_ERROR("Out of memory");
+					return ERROR_FAIL;
+				}
+			}
+		} else if (strcmp(CMD_ARGV[0], "disable") == 0) {
+			free(target->mem_cache);
+			target->mem_cache = NULL;
+		} else if (strcmp(CMD_ARGV[0], "flush") == 0) {
+			target_mem_cache_invalidate_all(target);
+		} else if (strcmp(CMD_ARGV[0], "stats") == 0) {
+			struct target_mem_cache *cache = target->mem_cache;
+			if (!cache) {
+				command_print(CMD_CTX, "memory cache disabled");
+				return ERROR_OK;
+			}
+			unsigned valid = 0;
+			for (int i = 0; i < MEM_CACHE_LINES; i++)
+				valid += cache->lines[i].valid;
+			command_print(CMD_CTX, "hits %" PRIu32 ", misses %" PRIu32
+					", prefetched %" PRIu32 ", invalidations %" PRIu32
+					", valid lines %u/%u",
+					cache->hits, cache->misses, cache->prefetched,
+					cache->invalidations, valid, MEM_CACHE_LINES);
+			return ERROR_OK;
+		} else
+			return ERROR_COMMAND_SYNTAX_ERROR;
+	}
+
+	command_print(CMD_CTX, "memory cache %s",
+			target->mem_cache ? "enabled" : "disabled");
+	return ERROR_OK;
+}
+
 static const struct command_registration target_command_handlers[] = {
 	{
 		.name = "targets",
@@ -5611,6 +6204,9 @@ static const struct command_registration target_command_handlers[] = {
 
 		.chain = target_subcommand_handlers,
 	},
+	{
+		.chain = image_command_handlers,
+	},
 	COMMAND_REGISTRATION_DONE
 };
 
@@ -5856,6 +6452,14 @@ static const struct command_registration target_exec_command_handlers[] = {
 		.usage = "filename address ['bin'|'ihex'|'elf'|'s19'] "
 			"[min_address [max_length]]",
 	},
+	{
+		.name = "fast_load_cache",
+		.handler = handle_fast_load_cache_command,
+		.mode = COMMAND_ANY,
+		.help = "directory where fast_load_image keeps prepared "
+			"images for reuse by later sessions",
+		.usage = "[directory|'disable']",
+	},
 	{
 		.name = "fast_load",
 		.handler = handle_fast_load_command,
@@ -5864,6 +6468,14 @@ static const struct command_registration target_exec_command_handlers[] = {
 			"- mainly for profiling purposes",
 		.usage = "",
 	},
+	{
+		.name = "mem_cache",
+		.handler = handle_mem_cache_command,
+		.mode = COMMAND_EXEC,
+		.help = "control the host side cache of target memory used "
+			"for GDB reads while the current target is halted",
+		.usage = "['enable'|'disable'|'flush'|'stats']",
+	},
 	{
 		.name = "profile",
 		.handler = handle_profile_command,
@@ -196,6 +196,9 @@ struct target {
 
 	/* file-I/O information for host to do syscall */
 	struct gdb_fileio_info *fileio_info;
+
+	/* host side read cache used while halted, NULL when disabled */
+	struct target_mem_cache *mem_cache;
 };
 
 struct target_list {
@@ -335,6 +338,11 @@ int target_call_timer_callbacks(void);
  * a synchronous command completes.
  */
 int target_call_timer_callbacks_now(void);
+/**
+ * Find the earliest time a timer callback is due, used by the server loop
+ * to sleep until then. Returns ERROR_FAIL if no callback is registered.
+ */
+int target_timer_next_callback(struct timeval *when);
 
 struct target *get_current_target(struct command_context *cmd_ctx);
 struct target *get_target(const char *id);
@@ -541,6 +549,16 @@ int target_write_buffer(struct target *target,
 		uint32_t address, uint32_t size, const uint8_t *buffer);
 int target_read_buffer(struct target *target,
 		uint32_t address, uint32_t size, uint8_t *buffer);
+/**
+ * Same as target_read_buffer(), but served from the host side memory
+ * cache when it is enabled with the "mem_cache" command and the target
+ * is halted. Misses fill whole cache lines and prefetch the next one.
+ */
+int target_read_buffer_cached(struct target *target,
+		uint32_t address, uint32_t size, uint8_t *buffer);
+/** Drop any cached memory contents overlapping the given range. */
+void target_mem_cache_invalidate(struct target *target,
+		uint32_t address, uint32_t size);
 int target_checksum_memory(struct target *target,
 		uint32_t address, uint32_t size, uint32_t *crc);
 int target_blank_check_memory(struct target *target,
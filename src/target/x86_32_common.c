@@ -50,6 +50,10 @@ static int read_mem(struct target *t, uint32_t size,
 			uint32_t addr, uint8_t *buf);
 static int write_mem(struct target *t, uint32_t size,
 			uint32_t addr, const uint8_t *buf);
+static int read_mem_bulk(struct target *t, uint32_t size,
+			uint32_t addr, uint32_t count, uint8_t *buf);
+static int write_mem_bulk(struct target *t, uint32_t size,
+			uint32_t addr, uint32_t count, const uint8_t *buf);
 static int calcaddr_pyhsfromlin(struct target *t, uint32_t addr,
 			uint32_t *physaddr);
 static int read_phys_mem(struct target *t, uint32_t phys_address,
@@ -104,6 +108,9 @@ int x86_32_common_init_arch_info(struct target *t, struct x86_32_common *x86_32)
 	x86_32->curr_tap = t->tap;
 	x86_32->fast_data_area = NULL;
 	x86_32->flush = 1;
+	x86_32->eager_regs[EIP] = true;
+	x86_32->eager_regs[EFLAGS] = true;
+	x86_32->eager_regs[CS] = true;
 	x86_32->read_hw_reg_to_cache = read_hw_reg_to_cache;
 	x86_32->write_hw_reg_from_cache = write_hw_reg_from_cache;
 	return ERROR_OK;
@@ -198,20 +205,24 @@ static int read_phys_mem(struct target *t, uint32_t phys_address,
 		pg_disabled = true;
 	}
 
-	for (uint32_t i = 0; i < count; i++) {
-		switch (size) {
-		case BYTE:
-			retval = read_mem(t, size, phys_address + i, buffer + i);
-			break;
-		case WORD:
-			retval = read_mem(t, size, phys_address + i * 2, buffer + i * 2);
-			break;
-		case DWORD:
-			retval = read_mem(t, size, phys_address + i * 4, buffer + i * 4);
-			break;
-		default:
-			LOG_ERROR("%s invalid read size", __func__);
-			break;
+	if (count > 1 && x86_32->queue_instruction != NULL) {
+		retval = read_mem_bulk(t, size, phys_address, count, buffer);
+	} else {
+		for (uint32_t i = 0; i < count; i++) {
+			switch (size) {
+			case BYTE:
+				retval = read_mem(t, size, phys_address + i, buffer + i);
+				break;
+			case WORD:
+				retval = read_mem(t, size, phys_address + i * 2, buffer + i * 2);
+				break;
+			case DWORD:
+				retval = read_mem(t, size, phys_address + i * 4, buffer + i * 4);
+				break;
+			default:
+				LOG_ERROR("%s invalid read size", __func__);
+				break;
+			}
 		}
 	}
 	/* restore CR0.PG bit if needed (regardless of retval) */
@@ -304,20 +315,24 @@ static int write_phys_mem(struct target *t, uint32_t phys_address,
 		}
 		pg_disabled = true;
 	}
-	for (uint32_t i = 0; i < count; i++) {
-		switch (size) {
-		case BYTE:
-			retval = write_mem(t, size, phys_address + i, buffer + i);
-			break;
-		case WORD:
-			retval = write_mem(t, size, phys_address + i * 2, buffer + i * 2);
-			break;
-		case DWORD:
-			retval = write_mem(t, size, phys_address + i * 4, buffer + i * 4);
-			break;
-		default:
-			LOG_DEBUG("invalid read size");
-			break;
+	if (count > 1 && x86_32->queue_instruction != NULL) {
+		retval = write_mem_bulk(t, size, phys_address, count, buffer);
+	} else {
+		for (uint32_t i = 0; i < count; i++) {
+			switch (size) {
+			case BYTE:
+				retval = write_mem(t, size, phys_address + i, buffer + i);
+				break;
+			case WORD:
+				retval = write_mem(t, size, phys_address + i * 2, buffer + i * 2);
+				break;
+			case DWORD:
+				retval = write_mem(t, size, phys_address + i * 4, buffer + i * 4);
+				break;
+			default:
+				LOG_DEBUG("invalid read size");
+				break;
+			}
 		}
 	}
 	/* restore CR0.PG bit if needed (regardless of retval) */
@@ -450,6 +465,148 @@ static int write_mem(struct target *t, uint32_t size,
 	return retval;
 }
 
+static int mem_instruction(struct target *t, uint32_t size, bool write)
+{
+	struct x86_32_common *x86_32 = target_to_x86_32(t);
+	/* if CS.D bit=1 then its a 32 bit code segment, else 16 */
+	bool use32 = (buf_get_u32(x86_32->cache->reg_list[CSAR].value, 0, 32)) & CSAR_D;
+
+	switch (size) {
+		case BYTE:
+			if (write)
+				return use32 ? MEMWRB32 : MEMWRB16;
+			return use32 ? MEMRDB32 : MEMRDB16;
+		case WORD:
+			if (write)
+				return use32 ? MEMWRH32 : MEMWRH16;
+			return use32 ? MEMRDH32 : MEMRDH16;
+		case DWORD:
+			if (write)
+				return use32 ? MEMWRW32 : MEMWRW16;
+			return use32 ? MEMRDW32 : MEMRDW16;
+		default:
+			return -1;
+	}
+}
+
+/*
+ * Bulk memory read. PIR submissions for up to X86_32_BULK_BATCH elements are
+ * queued without intermediate flushes and the transaction status is checked
+ * once per batch. If a batch fails, it is retried element by element with
+ * read_mem() so that the failing address gets reported.
+ */
+static int read_mem_bulk(struct target *t, uint32_t size,
+			uint32_t addr, uint32_t count, uint8_t *buf)
+{
+	struct x86_32_common *x86_32 = target_to_x86_32(t);
+	int retval = ERROR_OK;
+	int instr = mem_instruction(t, size, false);
+	if (instr < 0) {
+		LOG_ERROR("%s invalid read mem size", __func__);
+		return ERROR_FAIL;
+	}
+
+	uint8_t *edx = malloc(X86_32_BULK_BATCH * 4);
+	if (edx == NULL) {
+		LOG_ERROR("%s out of memory", __func__);
+		return ERROR_FAIL;
+	}
+
+	while (count > 0) {
+		uint32_t batch = count > X86_32_BULK_BATCH ? X86_32_BULK_BATCH : count;
+		uint32_t i;
+
+		for (i = 0; i < batch && retval == ERROR_OK; i++) {
+			retval = x86_32->queue_write_hw_reg(t, EAX, addr + i * size);
+			if (retval == ERROR_OK)
+				retval = x86_32->queue_instruction(t, instr);
+			if (retval == ERROR_OK)
+				retval = x86_32->queue_read_hw_reg(t, EDX, edx + i * 4);
+		}
+		x86_32->flush = 1;
+		if (retval == ERROR_OK)
+			retval = jtag_execute_queue();
+		if (retval == ERROR_OK)
+			retval = x86_32->transaction_status(t);
+
+		if (retval == ERROR_OK) {
+			for (i = 0; i < batch; i++)
+				memcpy(buf + i * size, edx + i * 4, size);
+		} else {
+			LOG_DEBUG("%s batch at 0x%08" PRIx32 " failed, retrying per element",
+					__func__, addr);
+			for (i = 0; i < batch; i++) {
+				retval = read_mem(t, size, addr + i * size, buf + i * size);
+				if (retval != ERROR_OK)
+					break;
+			}
+			if (retval != ERROR_OK)
+				break;
+		}
+
+		addr += batch * size;
+		buf += batch * size;
+		count -= batch;
+	}
+
+	free(edx);
+	return retval;
+}
+
+/* Bulk memory write, see read_mem_bulk() */
+static int write_mem_bulk(struct target *t, uint32_t size,
+			uint32_t addr, uint32_t count, const uint8_t *buf)
+{
+	struct x86_32_common *x86_32 = target_to_x86_32(t);
+	int retval = ERROR_OK;
+	int instr = mem_instruction(t, size, true);
+	if (instr < 0) {
+		LOG_ERROR("%s invalid write mem size", __func__);
+		return ERROR_FAIL;
+	}
+
+	while (count > 0) {
+		uint32_t batch = count > X86_32_BULK_BATCH ? X86_32_BULK_BATCH : count;
+		uint32_t i;
+
+		for (i = 0; i < batch && retval == ERROR_OK; i++) {
+			uint32_t buf4bytes = 0;
+			for (uint32_t j = 0; j < size; j++)
+				buf4bytes |= (uint32_t)buf[i * size + j] << (j * 8);
+
+			retval = x86_32->queue_write_hw_reg(t, EAX, addr + i * size);
+			if (retval == ERROR_OK)
+				retval = x86_32->queue_write_hw_reg(t, EDX, buf4bytes);
+			if (retval == ERROR_OK)
+				retval = x86_32->queue_instruction(t, instr);
+		}
+		x86_32->flush = 1;
+		if (retval == ERROR_OK)
+			retval = jtag_execute_queue();
+		if (retval == ERROR_OK)
+			retval = x86_32->transaction_status(t);
+
+		if (retval != ERROR_OK) {
+			/* writes are idempotent, so the whole batch can be redone */
+			LOG_DEBUG("%s batch at 0x%08" PRIx32 " failed, retrying per element",
+					__func__, addr);
+			for (i = 0; i < batch; i++) {
+				retval = write_mem(t, size, addr + i * size, buf + i * size);
+				if (retval != ERROR_OK)
+					break;
+			}
+			if (retval != ERROR_OK)
+				break;
+		}
+
+		addr += batch * size;
+		buf += batch * size;
+		count -= batch;
+	}
+
+	return retval;
+}
+
 int calcaddr_pyhsfromlin(struct target *t, uint32_t addr, uint32_t *physaddr)
 {
 	uint8_t entry_buffer[8];
@@ -1826,6 +1983,74 @@ COMMAND_HANDLER(handle_cpuid_command)
 	}
 }
 
+COMMAND_HANDLER(handle_eager_regs_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	struct x86_32_common *x86_32 = target_to_x86_32(target);
+	unsigned i, j;
+
+	/* TODO: Find a better way to find supported targets */
+	if ((strncmp(target_type_name(target), "quark", 5) != 0)) {
+		LOG_ERROR("Invalid target type - please select a x86_32 target");
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+	if (x86_32->cache == NULL)
+		return ERROR_FAIL;
+
+	if (CMD_ARGC > 0) {
+		bool eager[X86_32_NUM_REGS] = { false };
+		for (i = 0; i < CMD_ARGC; i++) {
+			for (j = 0; j < x86_32->cache->num_regs && j < X86_32_NUM_REGS; j++) {
+				if (strcmp(CMD_ARGV[i], x86_32->cache->reg_list[j].name) == 0)
+					break;
+			}
+			if (j == x86_32->cache->num_regs || j == X86_32_NUM_REGS) {
+				command_print(CMD_CTX, "unknown register '%s'", CMD_ARGV[i]);
+				return ERROR_COMMAND_ARGUMENT_INVALID;
+			}
+			eager[j] = true;
+		}
+		memcpy(x86_32->eager_regs, eager, sizeof(eager));
+	}
+
+	for (j = 0; j < x86_32->cache->num_regs && j < X86_32_NUM_REGS; j++) {
+		if (x86_32->eager_regs[j])
+			command_print(CMD_CTX, "%s", x86_32->cache->reg_list[j].name);
+	}
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_reg_stats_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	struct x86_32_common *x86_32 = target_to_x86_32(target);
+	struct x86_32_reg_stats *stats;
+
+	/* TODO: Find a better way to find supported targets */
+	if ((strncmp(target_type_name(target), "quark", 5) != 0)) {
+		LOG_ERROR("Invalid target type - please select a x86_32 target");
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+	stats = &x86_32->reg_stats;
+
+	if (CMD_ARGC == 1 && strcmp(CMD_ARGV[0], "reset") == 0) {
+		memset(stats, 0, sizeof(*stats));
+		return ERROR_OK;
+	} else if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	command_print(CMD_CTX, "halts: %" PRIu32, stats->halts);
+	command_print(CMD_CTX, "regs fetched on entry: %" PRIu32 ", on demand: %" PRIu32,
+			stats->eager_fetched, stats->lazy_fetched);
+	command_print(CMD_CTX, "regs written on exit: %" PRIu32, stats->written);
+	command_print(CMD_CTX, "last halt: %" PRIu32 " fetched, %" PRIu32 " written",
+			stats->last_fetched, stats->last_written);
+	if (stats->halts)
+		command_print(CMD_CTX, "average fetched per halt: %" PRIu32,
+				(stats->eager_fetched + stats->lazy_fetched) / stats->halts);
+	return ERROR_OK;
+}
+
 static const struct command_registration x86_32_exec_command_handlers[] = {
 	{
 		.name = "iww",
@@ -1883,6 +2108,21 @@ static const struct command_registration x86_32_exec_command_handlers[] = {
 		.help = "display cpuid information",
 		.usage = "eax_leaf [ecx_subleaf]",
 	},
+	{
+		.name = "eager_regs",
+		.mode = COMMAND_EXEC,
+		.handler = handle_eager_regs_command,
+		.help = "display or set the registers read on every halt, "
+			"the others are read on demand",
+		.usage = "[reg ...]",
+	},
+	{
+		.name = "reg_stats",
+		.mode = COMMAND_EXEC,
+		.handler = handle_reg_stats_command,
+		.help = "display or reset register cache statistics",
+		.usage = "[reset]",
+	},
 
 	COMMAND_REGISTRATION_DONE
 };
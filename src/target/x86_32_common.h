@@ -161,6 +161,8 @@ enum {
 	PMCR,
 };
 
+#define X86_32_NUM_REGS		(PMCR + 1)
+
 #define X86_32_COMMON_MAGIC 0x86328632
 
 enum {
@@ -213,9 +215,22 @@ struct swbp_mem_patch {
 	struct swbp_mem_patch *next;
 };
 
+/* max number of memory elements queued before the jtag queue is flushed */
+#define X86_32_BULK_BATCH	256
+
 /* TODO - probemode specific - consider removing */
 #define NUM_PM_REGS		18 /* regs used in save/restore */
 
+/* register cache traffic, reported by "x86_32 reg_stats" */
+struct x86_32_reg_stats {
+	uint32_t halts;
+	uint32_t eager_fetched;		/* regs read on probemode entry */
+	uint32_t lazy_fetched;		/* regs read on demand while halted */
+	uint32_t written;		/* regs written back on probemode exit */
+	uint32_t last_fetched;		/* regs read since the last halt */
+	uint32_t last_written;
+};
+
 struct x86_32_common {
 	uint32_t common_magic;
 	void *arch_info;
@@ -228,6 +243,11 @@ struct x86_32_common {
 	/* pm_regs are for probemode save/restore state */
 	uint32_t pm_regs[NUM_PM_REGS];
 
+	/* regs read from hardware on every probemode entry in addition to
+	 * those the core itself needs, the rest are fetched on demand */
+	bool eager_regs[X86_32_NUM_REGS];
+	struct x86_32_reg_stats reg_stats;
+
 	/* working area for fastdata access */
 	struct working_area *fast_data_area;
 
@@ -248,6 +268,12 @@ struct x86_32_common {
 	int (*write_hw_reg)(struct target *t, int reg,
 				uint32_t regval, uint8_t cache);
 
+	/* queue operations without flushing, used for bulk memory access,
+	 * caller executes the queue and restores flush */
+	int (*queue_read_hw_reg)(struct target *t, int reg, uint8_t *regval);
+	int (*queue_write_hw_reg)(struct target *t, int reg, uint32_t regval);
+	int (*queue_instruction)(struct target *t, int num);
+
 	/* register cache to processor synchronization */
 	int (*read_hw_reg_to_cache)(struct target *target, int num);
 	int (*write_hw_reg_from_cache)(struct target *target, int num);